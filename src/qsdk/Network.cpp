@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 
 #ifdef _WIN32
 #include <iphlpapi.h>
@@ -30,6 +31,11 @@
 #include <arpa/inet.h>     /*  inet_addr */
 #include <errno.h>         /*  socket error codes */
 #include <ifaddrs.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#endif
 
 
 #define SOCKET_ERROR            (-1)
@@ -51,8 +57,12 @@ CNetwork::CNetwork()
     mUDPBroadcastSocket = INVALID_SOCKET;
     mLastError          = 0;
     mErrorStr[0]        = 0;
+    mnLastReceiveTimeNs = 0;
 
     InitWinsock();
+#ifdef __linux__
+    InitEventLoop();
+#endif
 }
 
 
@@ -66,6 +76,16 @@ CNetwork::~CNetwork()
 #ifdef _WIN32
     WSACleanup();
 #endif
+#ifdef __linux__
+    if (mWakeFd >= 0)
+    {
+        close(mWakeFd);
+    }
+    if (mEpollFd >= 0)
+    {
+        close(mEpollFd);
+    }
+#endif
 }
 
 
@@ -157,6 +177,11 @@ bool CNetwork::Connect(const char* serverAddr, unsigned short nPort)
         return false;
     }
 
+#ifdef __linux__
+    WatchSocket(mSocket);
+    EnableReceiveTimestamps(mSocket);
+#endif
+
     return true;
 } // Connect
 
@@ -172,6 +197,12 @@ void CNetwork::Disconnect()
     mSocket             = INVALID_SOCKET;
     mUDPSocket          = INVALID_SOCKET;
     mUDPBroadcastSocket = INVALID_SOCKET;
+#ifdef __linux__
+    // Closing the sockets removes them from the epoll set.
+    mbTcpReadable          = false;
+    mbUdpReadable          = false;
+    mbUdpBroadcastReadable = false;
+#endif
 } // Disconnect
 
 
@@ -212,6 +243,9 @@ bool CNetwork::CreateUDPSocket(unsigned short &nUDPPort, bool bBroadcast)
                         if (setsockopt(tempSocket, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof(broadcast)) == 0)
                         {
                             mUDPBroadcastSocket = tempSocket;
+#ifdef __linux__
+                            WatchSocket(mUDPBroadcastSocket);
+#endif
                             return true;
                         }
                         else
@@ -222,6 +256,10 @@ bool CNetwork::CreateUDPSocket(unsigned short &nUDPPort, bool bBroadcast)
                     else
                     {
                         mUDPSocket = tempSocket;
+#ifdef __linux__
+                        WatchSocket(mUDPSocket);
+                        EnableReceiveTimestamps(mUDPSocket);
+#endif
                         return true;
                     }
                 }
@@ -269,8 +307,317 @@ unsigned short CNetwork::GetUdpBroadcastServerPort()
 }
 
 
-// Receive a data packet. Data is stored in a local static buffer
-CNetwork::Response CNetwork::Receive(SOCKET socket, SOCKET udpSocket, char* rtDataBuff, int dataBufSize, bool header, int timeoutMicroseconds, unsigned int *ipAddr)
+long long CNetwork::GetLastReceiveTime() const
+{
+    return mnLastReceiveTimeNs;
+}
+
+
+long long CNetwork::CurrentTimeNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+
+#ifdef __linux__
+// Have the kernel stamp every packet when it arrives, so the time a frame spent waiting in the socket
+// buffer isn't counted as network latency. Without it the time of the read is used instead.
+void CNetwork::EnableReceiveTimestamps(SOCKET socket)
+{
+    int enable = 1;
+    if (setsockopt(socket, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) != 0)
+    {
+        SetErrorString();
+    }
+}
+
+
+// Non-blocking read that also picks up the arrival time of the data.
+int CNetwork::ReceiveMessage(SOCKET socket, char* dataBuff, int dataBufSize, sockaddr_in* sourceAddr)
+{
+    char control[CMSG_SPACE(sizeof(timespec))];
+    iovec iov;
+    iov.iov_base = dataBuff;
+    iov.iov_len  = dataBufSize;
+
+    msghdr msg = {};
+    msg.msg_name       = sourceAddr;
+    msg.msg_namelen    = sourceAddr ? sizeof(sockaddr_in) : 0;
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control;
+    msg.msg_controllen = sizeof(control);
+
+    int received = recvmsg(socket, &msg, MSG_DONTWAIT);
+    if (received > 0)
+    {
+        mnLastReceiveTimeNs = ReceiveTimestamp(msg);
+    }
+    return received;
+}
+
+
+// For TCP the kernel reports the time of the last segment that was read.
+long long CNetwork::ReceiveTimestamp(msghdr& msg)
+{
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            timespec stamp;
+            memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+            return stamp.tv_sec * 1000000000LL + stamp.tv_nsec;
+        }
+    }
+    return CurrentTimeNs();
+}
+
+
+bool CNetwork::InitEventLoop()
+{
+    mbTcpReadable          = false;
+    mbUdpReadable          = false;
+    mbUdpBroadcastReadable = false;
+
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    mWakeFd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mEpollFd < 0 || mWakeFd < 0)
+    {
+        SetErrorString();
+        return false;
+    }
+
+    epoll_event event = {};
+    event.events  = EPOLLIN;
+    event.data.fd = mWakeFd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &event) != 0)
+    {
+        SetErrorString();
+        return false;
+    }
+    return true;
+}
+
+
+void CNetwork::WatchSocket(SOCKET socket)
+{
+    epoll_event event = {};
+    event.events  = EPOLLIN | EPOLLET;
+    event.data.fd = socket;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, socket, &event) != 0)
+    {
+        SetErrorString();
+    }
+
+    // Data may have arrived before the socket was registered, so the first read decides.
+    bool* readable = ReadableFlag(socket);
+    if (readable)
+    {
+        *readable = true;
+    }
+}
+
+
+bool* CNetwork::ReadableFlag(SOCKET socket)
+{
+    if (socket == INVALID_SOCKET)
+    {
+        return nullptr;
+    }
+    if (socket == mSocket)
+    {
+        return &mbTcpReadable;
+    }
+    if (socket == mUDPSocket)
+    {
+        return &mbUdpReadable;
+    }
+    if (socket == mUDPBroadcastSocket)
+    {
+        return &mbUdpBroadcastReadable;
+    }
+    return nullptr;
+}
+
+
+// Wait until socket or udpSocket is readable. Returns a mask of cReadyTcp (socket), cReadyUdp (udpSocket)
+// and cReadyWake, 0 on timeout and -1 on error.
+// A readable flag is only a hint until a read hits EAGAIN. Callers that don't read right away (bProbe)
+// get each flagged socket peeked first, so a stale flag doesn't report data that isn't there.
+int CNetwork::WaitForEvents(SOCKET socket, SOCKET udpSocket, int timeoutMicroseconds, bool bProbe)
+{
+    timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec  += timeoutMicroseconds / 1000000;
+    deadline.tv_nsec += (timeoutMicroseconds % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    bool* tcpReadable = ReadableFlag(socket);
+    bool* udpReadable = ReadableFlag(udpSocket);
+
+    while (true)
+    {
+        if (bProbe)
+        {
+            char peek;
+            if (tcpReadable && *tcpReadable && recv(socket, &peek, 1, MSG_PEEK | MSG_DONTWAIT) == SOCKET_ERROR &&
+                (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                *tcpReadable = false;
+            }
+            if (udpReadable && *udpReadable && recv(udpSocket, &peek, 1, MSG_PEEK | MSG_DONTWAIT) == SOCKET_ERROR &&
+                (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                *udpReadable = false;
+            }
+        }
+
+        int ready = 0;
+        if (tcpReadable && *tcpReadable)
+        {
+            ready |= cReadyTcp;
+        }
+        if (udpReadable && *udpReadable)
+        {
+            ready |= cReadyUdp;
+        }
+        if (ready)
+        {
+            return ready;
+        }
+
+        int timeoutMs = -1;
+        if (timeoutMicroseconds >= 0)
+        {
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long long remainingUs = (deadline.tv_sec - now.tv_sec) * 1000000LL + (deadline.tv_nsec - now.tv_nsec) / 1000;
+            if (remainingUs <= 0)
+            {
+                return 0;
+            }
+            // epoll only has millisecond resolution, never round a short wait down to a busy loop.
+            timeoutMs = (int)((remainingUs + 999) / 1000);
+        }
+
+        epoll_event events[4];
+        int eventCount = epoll_wait(mEpollFd, events, 4, timeoutMs);
+        if (eventCount == SOCKET_ERROR)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            SetErrorString();
+            return -1;
+        }
+
+        bool woken = false;
+        for (int i = 0; i < eventCount; i++)
+        {
+            if (events[i].data.fd == mWakeFd)
+            {
+                uint64_t count;
+                while (read(mWakeFd, &count, sizeof(count)) == sizeof(count))
+                {
+                }
+                woken = true;
+                continue;
+            }
+            // Errors and hang-ups are reported by the next read.
+            bool* readable = ReadableFlag(events[i].data.fd);
+            if (readable)
+            {
+                *readable = true;
+            }
+        }
+        if (woken)
+        {
+            return cReadyWake;
+        }
+    }
+}
+
+
+// Receive from whichever socket is ready first. Bytes from the TCP socket go to tcpDataBuff (at most
+// tcpDataBufSize), a datagram from udpSocket to udpDataBuff. pbFromTcp tells which one it was.
+CNetwork::Response CNetwork::Receive(SOCKET socket, SOCKET udpSocket, char* tcpDataBuff, int tcpDataBufSize, char* udpDataBuff, int udpDataBufSize,
+                                     int timeoutMicroseconds, unsigned int *ipAddr, bool* pbFromTcp)
+{
+    sockaddr_in source_addr;
+
+    while (true)
+    {
+        int ready = WaitForEvents(socket, udpSocket, timeoutMicroseconds);
+
+        if (ready < 0)
+        {
+            return Response(CNetwork::ResponseType::error, 0);
+        }
+        if (ready == 0)
+        {
+            return Response(CNetwork::ResponseType::timeout, 0);
+        }
+        if (ready & cReadyWake)
+        {
+            strcpy(mErrorStr, "Receive interrupted.");
+            return Response(CNetwork::ResponseType::timeout, 0);
+        }
+
+        int received;
+        bool* readable;
+        const bool fromTcp = (ready & cReadyTcp) != 0;
+        if (fromTcp)
+        {
+            readable = &mbTcpReadable;
+            received = ReceiveMessage(socket, tcpDataBuff, tcpDataBufSize, nullptr);
+            if (received > 0 && received < tcpDataBufSize)
+            {
+                // A short read empties the socket buffer, new data raises a new edge.
+                *readable = false;
+            }
+        }
+        else
+        {
+            readable = ReadableFlag(udpSocket);
+            received = ReceiveMessage(udpSocket, udpDataBuff, udpDataBufSize, &source_addr);
+            if (received > 0 && ipAddr)
+            {
+                *ipAddr = source_addr.sin_addr.s_addr;
+            }
+        }
+        if (pbFromTcp)
+        {
+            *pbFromTcp = fromTcp;
+        }
+
+        if (received == SOCKET_ERROR)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                // Drained, wait for the next edge.
+                *readable = false;
+                continue;
+            }
+            SetErrorString();
+            return Response(CNetwork::ResponseType::error, 0);
+        }
+        if (received == 0)
+        {
+            return Response(CNetwork::ResponseType::disconnect, 0);
+        }
+        return Response(CNetwork::ResponseType::success, received);
+    }
+}
+#else
+// Receive from whichever socket is ready first. Bytes from the TCP socket go to tcpDataBuff (at most
+// tcpDataBufSize), a datagram from udpSocket to udpDataBuff. pbFromTcp tells which one it was.
+CNetwork::Response CNetwork::Receive(SOCKET socket, SOCKET udpSocket, char* tcpDataBuff, int tcpDataBufSize, char* udpDataBuff, int udpDataBufSize,
+                                     int timeoutMicroseconds, unsigned int *ipAddr, bool* pbFromTcp)
 {
     int received = 0;
     sockaddr_in source_addr;
@@ -280,12 +627,15 @@ CNetwork::Response CNetwork::Receive(SOCKET socket, SOCKET udpSocket, char* rtDa
     FD_ZERO(&readFDs);
     FD_ZERO(&exceptFDs);
 
-    if (socket != INVALID_SOCKET)
+    const bool hasTcp = socket != INVALID_SOCKET;
+    const bool hasUdp = udpSocket != INVALID_SOCKET;
+
+    if (hasTcp)
     {
         FD_SET(socket, &readFDs);
         FD_SET(socket, &exceptFDs);
     }
-    if (udpSocket != INVALID_SOCKET)
+    if (hasUdp)
     {
         FD_SET(udpSocket, &readFDs);
         FD_SET(udpSocket, &exceptFDs);
@@ -324,17 +674,22 @@ CNetwork::Response CNetwork::Receive(SOCKET socket, SOCKET udpSocket, char* rtDa
         return Response(CNetwork::ResponseType::timeout, 0);
     }
 
-    if (FD_ISSET(socket, &exceptFDs))
+    if (hasTcp && FD_ISSET(socket, &exceptFDs))
     {
         // General socket error
         FD_CLR(socket, &exceptFDs);
         SetErrorString();
         return Response(CNetwork::ResponseType::error, 0);
     }
-    else if (FD_ISSET(socket, &readFDs))
+    else if (hasTcp && FD_ISSET(socket, &readFDs))
     {
-        received = recv(socket, rtDataBuff, header ? 8 : dataBufSize, 0);
+        received = recv(socket, tcpDataBuff, tcpDataBufSize, 0);
+        mnLastReceiveTimeNs = CurrentTimeNs();
         FD_CLR(socket, &readFDs);
+        if (pbFromTcp)
+        {
+            *pbFromTcp = true;
+        }
         if (selectRes == SOCKET_ERROR)
         {
             SetErrorString();
@@ -346,17 +701,22 @@ CNetwork::Response CNetwork::Receive(SOCKET socket, SOCKET udpSocket, char* rtDa
         }
         return Response(CNetwork::ResponseType::success, received);
     }
-    else if (FD_ISSET(udpSocket, &exceptFDs))
+    else if (hasUdp && FD_ISSET(udpSocket, &exceptFDs))
     {
         // General socket error
         FD_CLR(udpSocket, &exceptFDs);
         SetErrorString();
         return Response(CNetwork::ResponseType::error, 0);
     }
-    else if (FD_ISSET(udpSocket, &readFDs))
+    else if (hasUdp && FD_ISSET(udpSocket, &readFDs))
     {
-        received = recvfrom(udpSocket, rtDataBuff, dataBufSize, 0, (sockaddr*)&source_addr, &fromlen);
+        received = recvfrom(udpSocket, udpDataBuff, udpDataBufSize, 0, (sockaddr*)&source_addr, &fromlen);
+        mnLastReceiveTimeNs = CurrentTimeNs();
         FD_CLR(udpSocket, &readFDs);
+        if (pbFromTcp)
+        {
+            *pbFromTcp = false;
+        }
         if (ipAddr)
         {
             *ipAddr = source_addr.sin_addr.s_addr;
@@ -374,17 +734,209 @@ CNetwork::Response CNetwork::Receive(SOCKET socket, SOCKET udpSocket, char* rtDa
     }
     return Response(CNetwork::ResponseType::error, 0);
 }
+#endif
 
 
 CNetwork::Response CNetwork::Receive(char* rtDataBuff, int dataBufSize, bool header, int timeoutMicroseconds, unsigned int *ipAddr)
 {
-    return Receive(mSocket, mUDPSocket, rtDataBuff, dataBufSize, header, timeoutMicroseconds, ipAddr);
+    return Receive(mSocket, mUDPSocket, rtDataBuff, header ? 8 : dataBufSize, rtDataBuff, dataBufSize, timeoutMicroseconds, ipAddr);
 }
 
 
 CNetwork::Response CNetwork::ReceiveUdpBroadcast(char* rtDataBuff, int dataBufSize, int timeoutMicroseconds, unsigned int *ipAddr)
 {
-    return Receive(static_cast<SOCKET>(SOCKET_ERROR), mUDPBroadcastSocket, rtDataBuff, dataBufSize, false, timeoutMicroseconds, ipAddr);
+    return Receive(static_cast<SOCKET>(SOCKET_ERROR), mUDPBroadcastSocket, nullptr, 0, rtDataBuff, dataBufSize, timeoutMicroseconds, ipAddr);
+}
+
+
+// Read as much of the TCP stream as fits in tcpDataBuff, or one UDP datagram into udpDataBuff.
+CNetwork::Response CNetwork::ReceiveStream(char* tcpDataBuff, int tcpDataBufSize, char* udpDataBuff, int udpDataBufSize, int timeoutMicroseconds, bool& bFromTcp)
+{
+    return Receive(mSocket, mUDPSocket, tcpDataBuff, tcpDataBufSize, udpDataBuff, udpDataBufSize, timeoutMicroseconds, nullptr, &bFromTcp);
+}
+
+
+// Read from the TCP socket only, UDP datagrams stay queued.
+CNetwork::Response CNetwork::ReceiveTcp(char* rtDataBuff, int dataBufSize, int timeoutMicroseconds)
+{
+    return Receive(mSocket, static_cast<SOCKET>(INVALID_SOCKET), rtDataBuff, dataBufSize, nullptr, 0, timeoutMicroseconds);
+}
+
+
+bool CNetwork::HasUdpSocket() const
+{
+    return mUDPSocket != INVALID_SOCKET;
+}
+
+
+// Wait for activity on the TCP and UDP sockets without reading anything.
+// On success, received is a mask of cReadyTcp / cReadyUdp.
+CNetwork::Response CNetwork::WaitForData(int timeoutMicroseconds)
+{
+#ifdef __linux__
+    int ready = WaitForEvents(mSocket, mUDPSocket, timeoutMicroseconds, true);
+    if (ready < 0)
+    {
+        return Response(CNetwork::ResponseType::error, 0);
+    }
+    if (ready == 0 || ready == cReadyWake)
+    {
+        return Response(CNetwork::ResponseType::timeout, 0);
+    }
+    return Response(CNetwork::ResponseType::success, ready);
+#else
+    fd_set readFDs;
+    FD_ZERO(&readFDs);
+
+    if (mSocket != INVALID_SOCKET)
+    {
+        FD_SET(mSocket, &readFDs);
+    }
+    if (mUDPSocket != INVALID_SOCKET)
+    {
+        FD_SET(mUDPSocket, &readFDs);
+    }
+
+    TIMEVAL* pTimeval;
+    TIMEVAL  sTimeval;
+
+    if (timeoutMicroseconds < 0)
+    {
+        pTimeval = nullptr;
+    }
+    else
+    {
+        sTimeval.tv_sec  = timeoutMicroseconds / 1000000;
+        sTimeval.tv_usec = timeoutMicroseconds % 1000000;
+        pTimeval = &sTimeval;
+    }
+
+#ifdef _WIN32
+    const int nfds = 0;
+#else
+    const int nfds = std::max(mSocket, mUDPSocket) + 1;
+#endif
+
+    int selectRes = select(nfds, &readFDs, nullptr, nullptr, pTimeval);
+
+    if (selectRes == SOCKET_ERROR)
+    {
+        SetErrorString();
+        return Response(CNetwork::ResponseType::error, 0);
+    }
+    if (selectRes == 0)
+    {
+        return Response(CNetwork::ResponseType::timeout, 0);
+    }
+
+    int ready = 0;
+    if (mSocket != INVALID_SOCKET && FD_ISSET(mSocket, &readFDs))
+    {
+        ready |= cReadyTcp;
+    }
+    if (mUDPSocket != INVALID_SOCKET && FD_ISSET(mUDPSocket, &readFDs))
+    {
+        ready |= cReadyUdp;
+    }
+    return Response(CNetwork::ResponseType::success, ready);
+#endif
+}
+
+
+// Interrupt a Receive or WaitForData that is blocked in another thread. It returns as a timeout.
+void CNetwork::Wake()
+{
+#ifdef __linux__
+    uint64_t one = 1;
+    if (write(mWakeFd, &one, sizeof(one)) != sizeof(one))
+    {
+        SetErrorString();
+    }
+#endif
+}
+
+
+// Drain up to nBuffCount datagrams that are already queued on the UDP socket, one per buffer,
+// without blocking. pnReceived gets the size of each datagram and received the number of datagrams.
+// pnReceiveTimesNs (optional) gets the arrival time of each datagram.
+CNetwork::Response CNetwork::ReceiveUdpBatch(char* const* rtDataBuffs, int dataBufSize, int buffCount, int* pnReceived, long long* pnReceiveTimesNs)
+{
+    if (mUDPSocket == INVALID_SOCKET || buffCount <= 0)
+    {
+        return Response(CNetwork::ResponseType::error, 0);
+    }
+
+#ifdef __linux__
+    const size_t controlSize = CMSG_SPACE(sizeof(timespec));
+    if ((int)mUdpBatchMsgs.size() < buffCount)
+    {
+        mUdpBatchMsgs.resize(buffCount);
+        mUdpBatchIovecs.resize(buffCount);
+        mUdpBatchControl.resize(buffCount * controlSize);
+    }
+    for (int i = 0; i < buffCount; i++)
+    {
+        mUdpBatchIovecs[i].iov_base = rtDataBuffs[i];
+        mUdpBatchIovecs[i].iov_len  = dataBufSize;
+        memset(&mUdpBatchMsgs[i], 0, sizeof(mmsghdr));
+        mUdpBatchMsgs[i].msg_hdr.msg_iov        = &mUdpBatchIovecs[i];
+        mUdpBatchMsgs[i].msg_hdr.msg_iovlen     = 1;
+        mUdpBatchMsgs[i].msg_hdr.msg_control    = &mUdpBatchControl[i * controlSize];
+        mUdpBatchMsgs[i].msg_hdr.msg_controllen = controlSize;
+    }
+
+    // One syscall for everything that is waiting.
+    int count = recvmmsg(mUDPSocket, mUdpBatchMsgs.data(), buffCount, MSG_DONTWAIT, nullptr);
+    if (count == SOCKET_ERROR)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            mbUdpReadable = false;
+            return Response(CNetwork::ResponseType::timeout, 0);
+        }
+        SetErrorString();
+        return Response(CNetwork::ResponseType::error, 0);
+    }
+    if (count < buffCount)
+    {
+        // Everything queued has been read, the next datagram raises a new edge.
+        mbUdpReadable = false;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        pnReceived[i] = (int)mUdpBatchMsgs[i].msg_len;
+        if (pnReceiveTimesNs)
+        {
+            pnReceiveTimesNs[i] = ReceiveTimestamp(mUdpBatchMsgs[i].msg_hdr);
+        }
+    }
+    if (count > 0)
+    {
+        mnLastReceiveTimeNs = ReceiveTimestamp(mUdpBatchMsgs[count - 1].msg_hdr);
+    }
+#else
+    // No recvmmsg, read the (unblocking) socket until it is empty.
+    int count = 0;
+    while (count < buffCount)
+    {
+        int received = recvfrom(mUDPSocket, rtDataBuffs[count], dataBufSize, 0, nullptr, nullptr);
+        if (received == SOCKET_ERROR)
+        {
+            break;
+        }
+        mnLastReceiveTimeNs = CurrentTimeNs();
+        if (pnReceiveTimesNs)
+        {
+            pnReceiveTimesNs[count] = mnLastReceiveTimeNs;
+        }
+        pnReceived[count++] = received;
+    }
+#endif
+    if (count == 0)
+    {
+        return Response(CNetwork::ResponseType::timeout, 0);
+    }
+    return Response(CNetwork::ResponseType::success, count);
 }
 
 
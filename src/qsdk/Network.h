@@ -14,9 +14,20 @@
 
 #include <vector>
 
+#ifdef __linux__
+    #include <sys/socket.h> // mmsghdr
+    #include <sys/uio.h>    // iovec
+    #include <netinet/in.h> // sockaddr_in
+#endif
+
 class CNetwork
 {
 public:
+    // Bit mask returned by WaitForData in Response::received.
+    static const int cReadyTcp  = 0x1;
+    static const int cReadyUdp  = 0x2;
+    static const int cReadyWake = 0x4;
+
     enum class ResponseType
     {
         success,
@@ -44,6 +55,13 @@ public:
 
     Response Receive(char* rtDataBuff, int nDataBufSize, bool bHeader, int timeoutMicroseconds, unsigned int *ipAddr = nullptr);
     Response ReceiveUdpBroadcast(char* rtDataBuff, int nDataBufSize, int timeoutMicroseconds, unsigned int *ipAddr = nullptr);
+    Response ReceiveStream(char* tcpDataBuff, int nTcpDataBufSize, char* udpDataBuff, int nUdpDataBufSize, int timeoutMicroseconds, bool& bFromTcp);
+    Response ReceiveTcp(char* rtDataBuff, int nDataBufSize, int timeoutMicroseconds);
+    Response WaitForData(int timeoutMicroseconds);
+    Response ReceiveUdpBatch(char* const* rtDataBuffs, int nDataBufSize, int nBuffCount, int* pnReceived, long long* pnReceiveTimesNs = nullptr);
+    long long GetLastReceiveTime() const; // Arrival time of the last received data in ns (CLOCK_REALTIME)
+    bool  HasUdpSocket() const;
+    void  Wake();
     bool  Send(const char* pSendBuf, int nSize);
     bool  SendUDPBroadcast(const char* pSendBuf, int nSize, short nPort, unsigned int nFilterAddr = 0);
     char* GetErrorString();
@@ -53,10 +71,21 @@ public:
     unsigned short GetUdpBroadcastServerPort();
 
 private:
-    Response Receive(SOCKET socket, SOCKET udpSocket, char* rtDataBuff, int nDataBufSize, bool bHeader, int timeoutMicroseconds, unsigned int *ipAddr = nullptr);
+    Response Receive(SOCKET socket, SOCKET udpSocket, char* tcpDataBuff, int nTcpDataBufSize, char* udpDataBuff, int nUdpDataBufSize,
+                     int timeoutMicroseconds, unsigned int *ipAddr = nullptr, bool* pbFromTcp = nullptr);
     bool InitWinsock();
     void SetErrorString();
     unsigned short GetUdpServerPort(SOCKET nSocket);
+    static long long CurrentTimeNs();
+#ifdef __linux__
+    void EnableReceiveTimestamps(SOCKET socket);
+    int  ReceiveMessage(SOCKET socket, char* dataBuff, int dataBufSize, sockaddr_in* sourceAddr);
+    static long long ReceiveTimestamp(msghdr& msg);
+    bool InitEventLoop();
+    void WatchSocket(SOCKET socket);
+    bool* ReadableFlag(SOCKET socket);
+    int  WaitForEvents(SOCKET socket, SOCKET udpSocket, int timeoutMicroseconds, bool bProbe = false);
+#endif
 
 private:
     SOCKET     mSocket;
@@ -64,6 +93,19 @@ private:
     SOCKET     mUDPBroadcastSocket;
     char       mErrorStr[256];
     unsigned long mLastError;
+    long long  mnLastReceiveTimeNs;
+#ifdef __linux__
+    // The sockets are registered once with an edge-triggered epoll instance. Since an edge is only
+    // reported once, each socket keeps a readable flag that stays set until a read hits EAGAIN.
+    int        mEpollFd;
+    int        mWakeFd;
+    bool       mbTcpReadable;
+    bool       mbUdpReadable;
+    bool       mbUdpBroadcastReadable;
+    std::vector<mmsghdr> mUdpBatchMsgs;
+    std::vector<iovec>   mUdpBatchIovecs;
+    std::vector<char>    mUdpBatchControl; // SCM_TIMESTAMPNS of each datagram
+#endif
 };
 
 
@@ -12,14 +12,177 @@
 #include <arpa/inet.h>
 #endif
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RTPACKET_NEON
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RTPACKET_SSE2
+#endif
+
 #include "RTPacket.h"
+#include "RTPacketDecoder.h"
+
+namespace
+{
+    // NaN by its bits, x != x folds to false under -ffast-math. QTM sends missing markers as NaN.
+    inline bool IsNaN(float fValue)
+    {
+        uint32_t nBits;
+        memcpy(&nBits, &fValue, sizeof(nBits));
+        return (nBits & 0x7fffffffu) > 0x7f800000u;
+    }
+
+    inline void StoreMarker(unsigned int nIndex, float fX, float fY, float fZ, float* pXYZ, float* pX, float* pY, float* pZ, unsigned char* pValid)
+    {
+        if (pXYZ != nullptr)
+        {
+            pXYZ[nIndex * 3]     = fX;
+            pXYZ[nIndex * 3 + 1] = fY;
+            pXYZ[nIndex * 3 + 2] = fZ;
+        }
+        else
+        {
+            pX[nIndex] = fX;
+            pY[nIndex] = fY;
+            pZ[nIndex] = fZ;
+        }
+        if (pValid != nullptr)
+        {
+            pValid[nIndex] = IsNaN(fX) ? 0 : 1;
+        }
+    }
+
+#if defined(RTPACKET_SSE2)
+    inline __m128 ByteSwap(__m128 v)
+    {
+        __m128i n = _mm_castps_si128(v);
+        n = _mm_or_si128(_mm_slli_epi16(n, 8), _mm_srli_epi16(n, 8));
+        n = _mm_shufflelo_epi16(n, _MM_SHUFFLE(2, 3, 0, 1));
+        n = _mm_shufflehi_epi16(n, _MM_SHUFFLE(2, 3, 0, 1));
+        return _mm_castsi128_ps(n);
+    }
+#endif
+
+    // The first nCount markers of a 3D component. With the float wire format four markers at a time in vector
+    // registers when NEON or SSE2 is available, the x lane of each marker gives the NaN mask.
+    template <typename TDecoder>
+    void Decode3DMarkerRange(const char* pMarkers, unsigned int nCount, float* pXYZ, float* pX, float* pY, float* pZ, unsigned char* pValid)
+    {
+        const bool bBigEndian = TDecoder::cBigEndian;
+        const unsigned int nVectorCount = TDecoder::cFloats ? nCount : 0;
+        unsigned int i = 0;
+#if defined(RTPACKET_NEON)
+        for (; i + 4 <= nVectorCount; i += 4)
+        {
+            float32x4x3_t v = vld3q_f32((const float*)(pMarkers + i * 12));
+            if (bBigEndian)
+            {
+                v.val[0] = vreinterpretq_f32_u8(vrev32q_u8(vreinterpretq_u8_f32(v.val[0])));
+                v.val[1] = vreinterpretq_f32_u8(vrev32q_u8(vreinterpretq_u8_f32(v.val[1])));
+                v.val[2] = vreinterpretq_f32_u8(vrev32q_u8(vreinterpretq_u8_f32(v.val[2])));
+            }
+            if (pXYZ != nullptr)
+            {
+                vst3q_f32(pXYZ + i * 3, v);
+            }
+            else
+            {
+                vst1q_f32(pX + i, v.val[0]);
+                vst1q_f32(pY + i, v.val[1]);
+                vst1q_f32(pZ + i, v.val[2]);
+            }
+            if (pValid != nullptr)
+            {
+                // not NaN by the bits, like IsNaN
+                const uint32x4_t nAbs = vandq_u32(vreinterpretq_u32_f32(v.val[0]), vdupq_n_u32(0x7fffffffu));
+                const uint16x4_t nMask = vmovn_u32(vcleq_u32(nAbs, vdupq_n_u32(0x7f800000u)));
+                // 0xffff per valid marker, down to 1
+                const uint16x4_t nValid = vshr_n_u16(nMask, 15);
+                uint8_t anMask[8];
+                vst1_u8(anMask, vmovn_u16(vcombine_u16(nValid, nValid)));
+                memcpy(pValid + i, anMask, 4);
+            }
+        }
+#elif defined(RTPACKET_SSE2)
+        for (; i + 4 <= nVectorCount; i += 4)
+        {
+            // x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+            __m128 a = _mm_loadu_ps((const float*)(pMarkers + i * 12));
+            __m128 b = _mm_loadu_ps((const float*)(pMarkers + i * 12 + 16));
+            __m128 c = _mm_loadu_ps((const float*)(pMarkers + i * 12 + 32));
+            if (bBigEndian)
+            {
+                a = ByteSwap(a);
+                b = ByteSwap(b);
+                c = ByteSwap(c);
+            }
+            const __m128 x = _mm_shuffle_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 0, 0)),
+                                            _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+            if (pXYZ != nullptr)
+            {
+                _mm_storeu_ps(pXYZ + i * 3, a);
+                _mm_storeu_ps(pXYZ + i * 3 + 4, b);
+                _mm_storeu_ps(pXYZ + i * 3 + 8, c);
+            }
+            else
+            {
+                const __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                                                _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+                const __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                                                _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+                _mm_storeu_ps(pX + i, x);
+                _mm_storeu_ps(pY + i, y);
+                _mm_storeu_ps(pZ + i, z);
+            }
+            if (pValid != nullptr)
+            {
+                // not NaN by the bits, like IsNaN: the magnitude bits compare as positive ints
+                const __m128i nAbs = _mm_and_si128(_mm_castps_si128(x), _mm_set1_epi32(0x7fffffff));
+                const int nMask = ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(nAbs, _mm_set1_epi32(0x7f800000))));
+                pValid[i]     = nMask & 1;
+                pValid[i + 1] = (nMask >> 1) & 1;
+                pValid[i + 2] = (nMask >> 2) & 1;
+                pValid[i + 3] = (nMask >> 3) & 1;
+            }
+        }
+#endif
+        for (; i < nCount; i++)
+        {
+            float fX, fY, fZ;
+            TDecoder::Get3DMarker(pMarkers, i, fX, fY, fZ);
+            StoreMarker(i, fX, fY, fZ, pXYZ, pX, pY, pZ, pValid);
+        }
+    }
+
+    // Selected markers of a 3D component, out of range indices come back as NaN.
+    template <typename TDecoder>
+    void Decode3DMarkerList(const char* pMarkers, unsigned int nMarkerCount, const unsigned int* pIndices, unsigned int nIndexCount, float* pXYZ, float* pX, float* pY, float* pZ, unsigned char* pValid)
+    {
+        for (unsigned int i = 0; i < nIndexCount; i++)
+        {
+            if (pIndices[i] < nMarkerCount)
+            {
+                float fX, fY, fZ;
+                TDecoder::Get3DMarker(pMarkers, pIndices[i], fX, fY, fZ);
+                StoreMarker(i, fX, fY, fZ, pXYZ, pX, pY, pZ, pValid);
+            }
+            else
+            {
+                StoreMarker(i, NAN, NAN, NAN, pXYZ, pX, pY, pZ, pValid);
+            }
+        }
+    }
+}
 
 CRTPacket::CRTPacket(int nMajorVersion, int nMinorVersion, bool bBigEndian)
 {
-    mnMajorVersion = nMajorVersion;
-    mnMinorVersion = nMinorVersion;
-    mbBigEndian    = bBigEndian;
+    mnMajorVersion       = nMajorVersion;
+    mnMinorVersion       = nMinorVersion;
+    mbBigEndian          = bBigEndian;
+    mnConsumedComponents = 0;
 
+    SelectDecoder();
     ClearData();
 }
 
@@ -33,6 +196,7 @@ void CRTPacket::SetVersion(unsigned int nMajorVersion, unsigned int nMinorVersio
 {
     mnMajorVersion = nMajorVersion;
     mnMinorVersion = nMinorVersion;
+    SelectDecoder();
 }
 
 bool CRTPacket::GetEndianness()
@@ -43,6 +207,41 @@ bool CRTPacket::GetEndianness()
 void CRTPacket::SetEndianness(bool bBigEndian)
 {
     mbBigEndian = bBigEndian;
+    SelectDecoder();
+}
+
+void CRTPacket::SelectDecoder()
+{
+    if (mnMajorVersion > 1 || mnMinorVersion > 7)
+    {
+        meDecoder = mbBigEndian ? DecoderBigEndian : DecoderLittleEndian;
+    }
+    else
+    {
+        meDecoder = mbBigEndian ? DecoderBigEndianDoubles : DecoderLittleEndianDoubles;
+    }
+}
+
+// Calls func with a decoder instance for the stream's byte order and wire format. The only
+// runtime branch, func is a generic lambda that gets compiled for each decoder.
+template <typename TFunc>
+void CRTPacket::Decode(TFunc&& func) const
+{
+    switch (meDecoder)
+    {
+    case DecoderLittleEndian:
+        func(TRTPacketDecoder<false, true>());
+        break;
+    case DecoderBigEndian:
+        func(TRTPacketDecoder<true, true>());
+        break;
+    case DecoderLittleEndianDoubles:
+        func(TRTPacketDecoder<false, false>());
+        break;
+    case DecoderBigEndianDoubles:
+        func(TRTPacketDecoder<true, false>());
+        break;
+    }
 }
 
 void CRTPacket::ClearData()
@@ -60,13 +259,13 @@ void CRTPacket::ClearData()
     mnEyeTrackerCount         = 0;
     mnTimecodeCount           = 0;
     mSkeletonCount            = 0;
-    mpComponentData.resize(ComponentNone);
+    mnIndexedComponents       = cAllComponents;
+    mpComponentData.assign(ComponentNone, nullptr);
 }
 
 void CRTPacket::SetData(char* ptr)
 {
     unsigned int nComponent;
-    unsigned int nCamera, nDevice;
 
     mpData = ptr;
 
@@ -82,18 +281,20 @@ void CRTPacket::SetData(char* ptr)
     mnEyeTrackerCount         = 0;
     mnTimecodeCount           = 0;
     mSkeletonCount           = 0;
+    mnIndexedComponents       = cAllComponents;
+
+    // Reset all component data pointers
+    for (nComponent = 1; nComponent < ComponentNone; nComponent++)
+    {
+        mpComponentData[nComponent - 1] = nullptr;
+    }
 
     // Check if it's a data packet
     if (GetType() == PacketData)
     {
-        // Reset all component data pointers
-        for (nComponent = 1; nComponent < ComponentNone; nComponent++)
-        {
-            mpComponentData[nComponent - 1] = nullptr;
-        }
-
         char*        pCurrentComponent = mpData + 24;
         unsigned int nComponentType    = SetByteOrder((unsigned int*)(pCurrentComponent + 4));
+        unsigned int nFoundComponents  = 0;
 
         mnComponentCount = SetByteOrder((unsigned int*)(mpData + 20));
 
@@ -101,229 +302,283 @@ void CRTPacket::SetData(char* ptr)
         {
             mpComponentData[nComponentType - 1] = pCurrentComponent;
 
-            if (nComponentType == Component2d)
+            if (mnConsumedComponents == 0)
             {
-                mn2DCameraCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
-                mp2DData.resize(mn2DCameraCount);
-
-                if (!mp2DData.empty())
-                {
-                    mp2DData[0] = pCurrentComponent + 16;
-                    for (nCamera = 1; nCamera < mn2DCameraCount; nCamera++)
-                    {
-                        if (mnMajorVersion > 1 || mnMinorVersion > 7)
-                        {
-                            mp2DData[nCamera] = mp2DData[nCamera - 1] + 5 + Get2DMarkerCount(nCamera - 1) * 12;
-                        }
-                        else
-                        {
-                            mp2DData[nCamera] = mp2DData[nCamera - 1] + 4 + Get2DMarkerCount(nCamera - 1) * 12;
-                        }
-                    }
-                }
+                IndexComponent((EComponentType)nComponentType);
             }
-            if (nComponentType == Component2dLin)
+            else
             {
-                mn2DLinCameraCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
-                mp2DLinData.resize(mn2DLinCameraCount);
-
-                if (!mp2DLinData.empty())
+                // Everything the caller reads has been found, skip the rest of the packet.
+                nFoundComponents |= ComponentBit((EComponentType)nComponentType);
+                if ((nFoundComponents & mnConsumedComponents) == mnConsumedComponents)
                 {
-                    mp2DLinData[0] = pCurrentComponent + 16;
-                    for (nCamera = 1; nCamera < mn2DLinCameraCount; nCamera++)
-                    {
-                        if (mnMajorVersion > 1 || mnMinorVersion > 7)
-                        {
-                            mp2DLinData[nCamera] = mp2DLinData[nCamera - 1] + 5 + Get2DLinMarkerCount(nCamera - 1) * 12;
-                        }
-                        else
-                        {
-                            mp2DLinData[nCamera] = mp2DLinData[nCamera - 1] + 4 + Get2DLinMarkerCount(nCamera - 1) * 12;
-                        }
-                    }
+                    break;
                 }
             }
-            if (nComponentType == ComponentImage)
-            {
-                mnImageCameraCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
-                mpImageData.resize(mnImageCameraCount);
+            pCurrentComponent += SetByteOrder((int*)pCurrentComponent);
+            nComponentType     = SetByteOrder((unsigned int*)(pCurrentComponent + 4));
+        }
 
-                if (!mpImageData.empty())
-                {
-                    mpImageData[0] = pCurrentComponent + 12;
-                    for (nCamera = 1; nCamera < mnImageCameraCount; nCamera++)
-                    {
-                        mpImageData[nCamera] = mpImageData[nCamera - 1] + 36 + SetByteOrder((unsigned int*)(mpImageData[nCamera - 1] + 32));
-                    }
-                }
-            }
-            if (nComponentType == ComponentAnalog)
+        if (mnConsumedComponents != 0)
+        {
+            // Tables are built on first access.
+            mnIndexedComponents = 0;
+        }
+    }
+} // SetData
+
+void CRTPacket::SetConsumedComponents(unsigned int nComponentMask)
+{
+    mnConsumedComponents = nComponentMask & cAllComponents;
+}
+
+unsigned int CRTPacket::GetConsumedComponents() const
+{
+    return mnConsumedComponents;
+}
+
+void CRTPacket::EnsureIndexed(EComponentType eComponent)
+{
+    if ((mnIndexedComponents & ComponentBit(eComponent)) == 0)
+    {
+        IndexComponent(eComponent);
+    }
+}
+
+// Builds the per camera / per device pointer table and count of a component from the offset
+// recorded by SetData.
+void CRTPacket::IndexComponent(EComponentType eComponent)
+{
+    unsigned int nCamera, nDevice;
+    char*        pCurrentComponent = mpComponentData[eComponent - 1];
+
+    // Set first, the marker and sample count getters used below check it.
+    mnIndexedComponents |= ComponentBit(eComponent);
+
+    if (pCurrentComponent == nullptr)
+    {
+        return;
+    }
+
+    if (eComponent == Component2d)
+    {
+        mn2DCameraCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
+        mp2DData.resize(mn2DCameraCount);
+
+        if (!mp2DData.empty())
+        {
+            mp2DData[0] = pCurrentComponent + 16;
+            for (nCamera = 1; nCamera < mn2DCameraCount; nCamera++)
             {
-                if ((mnMajorVersion == 1) && (mnMinorVersion == 0))
+                if (mnMajorVersion > 1 || mnMinorVersion > 7)
                 {
-                    mnAnalogDeviceCount = 1;
+                    mp2DData[nCamera] = mp2DData[nCamera - 1] + 5 + Get2DMarkerCount(nCamera - 1) * 12;
                 }
                 else
                 {
-                    mnAnalogDeviceCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
+                    mp2DData[nCamera] = mp2DData[nCamera - 1] + 4 + Get2DMarkerCount(nCamera - 1) * 12;
                 }
-                mpAnalogData.resize(mnAnalogDeviceCount);
+            }
+        }
+    }
+    if (eComponent == Component2dLin)
+    {
+        mn2DLinCameraCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
+        mp2DLinData.resize(mn2DLinCameraCount);
 
-                if (!mpAnalogData.empty())
+        if (!mp2DLinData.empty())
+        {
+            mp2DLinData[0] = pCurrentComponent + 16;
+            for (nCamera = 1; nCamera < mn2DLinCameraCount; nCamera++)
+            {
+                if (mnMajorVersion > 1 || mnMinorVersion > 7)
                 {
-                    if ((mnMajorVersion > 1) || (mnMinorVersion > 7))
-                    {
-                        mpAnalogData[0] = pCurrentComponent + 12;
-                    }
-                    else
-                    {
-                        mpAnalogData[0] = pCurrentComponent + 16;
-                    }
-                    for (nDevice = 1; nDevice < mnAnalogDeviceCount; nDevice++)
-                    {
-                        mpAnalogData[nDevice] = mpAnalogData[nDevice - 1] + 16 +
-                            (SetByteOrder((unsigned int*)(mpAnalogData[nDevice - 1] + 4)) *
-                                SetByteOrder((unsigned int*)(mpAnalogData[nDevice - 1] + 8)) * 4);
-                    }
+                    mp2DLinData[nCamera] = mp2DLinData[nCamera - 1] + 5 + Get2DLinMarkerCount(nCamera - 1) * 12;
+                }
+                else
+                {
+                    mp2DLinData[nCamera] = mp2DLinData[nCamera - 1] + 4 + Get2DLinMarkerCount(nCamera - 1) * 12;
                 }
             }
-            if (nComponentType == ComponentAnalogSingle)
-            {
-                mnAnalogSingleDeviceCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
-                mpAnalogSingleData.resize(mnAnalogSingleDeviceCount);
+        }
+    }
+    if (eComponent == ComponentImage)
+    {
+        mnImageCameraCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
+        mpImageData.resize(mnImageCameraCount);
 
-                if (!mpAnalogSingleData.empty())
-                {
-                    if (mnMajorVersion > 1 || mnMinorVersion > 7)
-                    {
-                        mpAnalogSingleData[0] = pCurrentComponent + 12;
-                    }
-                    else
-                    {
-                        mpAnalogSingleData[0] = pCurrentComponent + 16;
-                    }
+        if (!mpImageData.empty())
+        {
+            mpImageData[0] = pCurrentComponent + 12;
+            for (nCamera = 1; nCamera < mnImageCameraCount; nCamera++)
+            {
+                mpImageData[nCamera] = mpImageData[nCamera - 1] + 36 + SetByteOrder((unsigned int*)(mpImageData[nCamera - 1] + 32));
+            }
+        }
+    }
+    if (eComponent == ComponentAnalog)
+    {
+        if ((mnMajorVersion == 1) && (mnMinorVersion == 0))
+        {
+            mnAnalogDeviceCount = 1;
+        }
+        else
+        {
+            mnAnalogDeviceCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
+        }
+        mpAnalogData.resize(mnAnalogDeviceCount);
 
-                    for (nDevice = 1; nDevice < mnAnalogSingleDeviceCount; nDevice++)
-                    {
-                        mpAnalogSingleData[nDevice] = mpAnalogSingleData[nDevice - 1] + 8 +
-                            SetByteOrder((unsigned int*)(mpAnalogSingleData[nDevice - 1] + 4)) * 4;
-                    }
-                }
+        if (!mpAnalogData.empty())
+        {
+            if ((mnMajorVersion > 1) || (mnMinorVersion > 7))
+            {
+                mpAnalogData[0] = pCurrentComponent + 12;
+            }
+            else
+            {
+                mpAnalogData[0] = pCurrentComponent + 16;
             }
-            if (nComponentType == ComponentForce)
+            for (nDevice = 1; nDevice < mnAnalogDeviceCount; nDevice++)
             {
-                mnForcePlateCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
-                mpForceData.resize(mnForcePlateCount);
+                mpAnalogData[nDevice] = mpAnalogData[nDevice - 1] + 16 +
+                    (SetByteOrder((unsigned int*)(mpAnalogData[nDevice - 1] + 4)) *
+                        SetByteOrder((unsigned int*)(mpAnalogData[nDevice - 1] + 8)) * 4);
+            }
+        }
+    }
+    if (eComponent == ComponentAnalogSingle)
+    {
+        mnAnalogSingleDeviceCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
+        mpAnalogSingleData.resize(mnAnalogSingleDeviceCount);
 
-                if (!mpForceData.empty())
-                {
-                    if (mnMajorVersion > 1 || mnMinorVersion > 7)
-                    {
-                        mpForceData[0] = pCurrentComponent + 12;
-                    }
-                    else
-                    {
-                        mpForceData[0] = pCurrentComponent + 16;
-                    }
-                    for (nDevice = 1; nDevice < mnForcePlateCount; nDevice++)
-                    {
-                        if ((mnMajorVersion == 1) && (mnMinorVersion == 0))
-                        {
-                            mpForceData[nDevice] = mpForceData[nDevice - 1] + 72;
-                        }
-                        else
-                        {
-                            mpForceData[nDevice] = mpForceData[nDevice - 1] + 12 +
-                                SetByteOrder((unsigned int*)(mpForceData[nDevice - 1] + 4)) * 36;
-                        }
-                    }
-                }
+        if (!mpAnalogSingleData.empty())
+        {
+            if (mnMajorVersion > 1 || mnMinorVersion > 7)
+            {
+                mpAnalogSingleData[0] = pCurrentComponent + 12;
             }
-            if (nComponentType == ComponentForceSingle)
+            else
             {
-                mnForceSinglePlateCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
-                mpForceSingleData.resize(mnForceSinglePlateCount);
+                mpAnalogSingleData[0] = pCurrentComponent + 16;
+            }
 
-                if (!mpForceSingleData.empty())
-                {
-                    mpForceSingleData[0] = pCurrentComponent + 12;
+            for (nDevice = 1; nDevice < mnAnalogSingleDeviceCount; nDevice++)
+            {
+                mpAnalogSingleData[nDevice] = mpAnalogSingleData[nDevice - 1] + 8 +
+                    SetByteOrder((unsigned int*)(mpAnalogSingleData[nDevice - 1] + 4)) * 4;
+            }
+        }
+    }
+    if (eComponent == ComponentForce)
+    {
+        mnForcePlateCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
+        mpForceData.resize(mnForcePlateCount);
 
-                    for (nDevice = 1; nDevice < mnForceSinglePlateCount; nDevice++)
-                    {
-                        mpForceSingleData[nDevice] = mpForceSingleData[nDevice - 1] + 4 + 36;
-                    }
-                }
+        if (!mpForceData.empty())
+        {
+            if (mnMajorVersion > 1 || mnMinorVersion > 7)
+            {
+                mpForceData[0] = pCurrentComponent + 12;
             }
-            if (nComponentType == ComponentGazeVector)
+            else
             {
-                mnGazeVectorCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
-                mpGazeVectorData.resize(mnGazeVectorCount);
-
-                if (!mpGazeVectorData.empty())
+                mpForceData[0] = pCurrentComponent + 16;
+            }
+            for (nDevice = 1; nDevice < mnForcePlateCount; nDevice++)
+            {
+                if ((mnMajorVersion == 1) && (mnMinorVersion == 0))
                 {
-                    mpGazeVectorData[0] = pCurrentComponent + 12;
-
-                    for (nDevice = 1; nDevice < mnGazeVectorCount; nDevice++)
-                    {
-                        unsigned int nPrevSampleCount = SetByteOrder((unsigned int*)(mpGazeVectorData[nDevice - 1]));
-                        mpGazeVectorData[nDevice] = mpGazeVectorData[nDevice - 1] + 4 + ((nPrevSampleCount == 0) ? 0 : 4) +
-                            nPrevSampleCount * 24;
-                    }
+                    mpForceData[nDevice] = mpForceData[nDevice - 1] + 72;
+                }
+                else
+                {
+                    mpForceData[nDevice] = mpForceData[nDevice - 1] + 12 +
+                        SetByteOrder((unsigned int*)(mpForceData[nDevice - 1] + 4)) * 36;
                 }
             }
-            if (nComponentType == ComponentEyeTracker)
-            {
-                mnEyeTrackerCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
-                mpEyeTrackerData.resize(mnEyeTrackerCount);
+        }
+    }
+    if (eComponent == ComponentForceSingle)
+    {
+        mnForceSinglePlateCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
+        mpForceSingleData.resize(mnForceSinglePlateCount);
 
-                if (!mpEyeTrackerData.empty())
-                {
-                    mpEyeTrackerData[0] = pCurrentComponent + 12;
+        if (!mpForceSingleData.empty())
+        {
+            mpForceSingleData[0] = pCurrentComponent + 12;
 
-                    for (nDevice = 1; nDevice < mnEyeTrackerCount; nDevice++)
-                    {
-                        unsigned int nPrevSampleCount = SetByteOrder((unsigned int*)(mpEyeTrackerData[nDevice - 1]));
-                        mpEyeTrackerData[nDevice] = mpEyeTrackerData[nDevice - 1] + 4 + ((nPrevSampleCount == 0) ? 0 : 4) +
-                            nPrevSampleCount * 28;
-                    }
-                }
+            for (nDevice = 1; nDevice < mnForceSinglePlateCount; nDevice++)
+            {
+                mpForceSingleData[nDevice] = mpForceSingleData[nDevice - 1] + 4 + 36;
             }
-            if (nComponentType == ComponentTimecode)
+        }
+    }
+    if (eComponent == ComponentGazeVector)
+    {
+        mnGazeVectorCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
+        mpGazeVectorData.resize(mnGazeVectorCount);
+
+        if (!mpGazeVectorData.empty())
+        {
+            mpGazeVectorData[0] = pCurrentComponent + 12;
+
+            for (nDevice = 1; nDevice < mnGazeVectorCount; nDevice++)
             {
-                mnTimecodeCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
-                mpTimecodeData.resize(mnTimecodeCount);
+                unsigned int nPrevSampleCount = SetByteOrder((unsigned int*)(mpGazeVectorData[nDevice - 1]));
+                mpGazeVectorData[nDevice] = mpGazeVectorData[nDevice - 1] + 4 + ((nPrevSampleCount == 0) ? 0 : 4) +
+                    nPrevSampleCount * 24;
+            }
+        }
+    }
+    if (eComponent == ComponentEyeTracker)
+    {
+        mnEyeTrackerCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
+        mpEyeTrackerData.resize(mnEyeTrackerCount);
 
-                if (!mpTimecodeData.empty())
-                {
-                    mpTimecodeData[0] = pCurrentComponent + 12;
+        if (!mpEyeTrackerData.empty())
+        {
+            mpEyeTrackerData[0] = pCurrentComponent + 12;
 
-                    for (nDevice = 1; nDevice < mnTimecodeCount; nDevice++)
-                    {
-                        mpTimecodeData[nDevice] = mpTimecodeData[nDevice - 1] + 12;
-                    }
-                }
+            for (nDevice = 1; nDevice < mnEyeTrackerCount; nDevice++)
+            {
+                unsigned int nPrevSampleCount = SetByteOrder((unsigned int*)(mpEyeTrackerData[nDevice - 1]));
+                mpEyeTrackerData[nDevice] = mpEyeTrackerData[nDevice - 1] + 4 + ((nPrevSampleCount == 0) ? 0 : 4) +
+                    nPrevSampleCount * 28;
             }
-            if (nComponentType == ComponentSkeleton)
+        }
+    }
+    if (eComponent == ComponentTimecode)
+    {
+        mnTimecodeCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
+        mpTimecodeData.resize(mnTimecodeCount);
+
+        if (!mpTimecodeData.empty())
+        {
+            mpTimecodeData[0] = pCurrentComponent + 12;
+
+            for (nDevice = 1; nDevice < mnTimecodeCount; nDevice++)
             {
-                mSkeletonCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
-                mpSkeletonData.resize(mSkeletonCount);
+                mpTimecodeData[nDevice] = mpTimecodeData[nDevice - 1] + 12;
+            }
+        }
+    }
+    if (eComponent == ComponentSkeleton)
+    {
+        mSkeletonCount = SetByteOrder((unsigned int*)(pCurrentComponent + 8));
+        mpSkeletonData.resize(mSkeletonCount);
 
-                if (!mpSkeletonData.empty())
-                {
-                    mpSkeletonData[0] = pCurrentComponent + 12;
+        if (!mpSkeletonData.empty())
+        {
+            mpSkeletonData[0] = pCurrentComponent + 12;
 
-                    for (nDevice = 1; nDevice < mSkeletonCount; nDevice++)
-                    {
-                        unsigned int prevSegmentCount = SetByteOrder((unsigned int*)(mpSkeletonData[nDevice - 1]));
-                        mpSkeletonData[nDevice] = mpSkeletonData[nDevice - 1] + 4 + prevSegmentCount * 32;
-                    }
-                }
+            for (nDevice = 1; nDevice < mSkeletonCount; nDevice++)
+            {
+                unsigned int prevSegmentCount = SetByteOrder((unsigned int*)(mpSkeletonData[nDevice - 1]));
+                mpSkeletonData[nDevice] = mpSkeletonData[nDevice - 1] + 4 + prevSegmentCount * 32;
             }
-            pCurrentComponent += SetByteOrder((int*)pCurrentComponent);
-            nComponentType     = SetByteOrder((unsigned int*)(pCurrentComponent + 4));
         }
     }
-} // SetData
+} // IndexComponent
 
 
 void CRTPacket::GetData(char* &ptr, unsigned int& nSize)
@@ -578,12 +833,13 @@ unsigned short CRTPacket::GetOutOfSyncRate()
 //-----------------------------------------------------------
 unsigned int CRTPacket::Get2DCameraCount()
 {
+    EnsureIndexed(Component2d);
     return mn2DCameraCount;
 }
 
 unsigned int CRTPacket::Get2DMarkerCount(unsigned int nCameraIndex)
 {
-    if (mn2DCameraCount <= nCameraIndex)
+    if (Get2DCameraCount() <= nCameraIndex)
     {
         return 0;
     }
@@ -592,7 +848,7 @@ unsigned int CRTPacket::Get2DMarkerCount(unsigned int nCameraIndex)
 
 unsigned char CRTPacket::Get2DStatusFlags(unsigned int nCameraIndex)
 {
-    if (mn2DCameraCount > nCameraIndex && ((mnMajorVersion > 1) || (mnMinorVersion > 7)))
+    if (Get2DCameraCount() > nCameraIndex && ((mnMajorVersion > 1) || (mnMinorVersion > 7)))
     {
         return *((unsigned char*)(mp2DData[nCameraIndex] + 4));
     }
@@ -604,7 +860,7 @@ bool CRTPacket::Get2DMarker(unsigned int nCameraIndex, unsigned int nMarkerIndex
 {
     int nOffset;
 
-    if (mn2DCameraCount <= nCameraIndex || Get2DMarkerCount(nCameraIndex) <= nMarkerIndex)
+    if (Get2DCameraCount() <= nCameraIndex || Get2DMarkerCount(nCameraIndex) <= nMarkerIndex)
     {
         return false;
     }
@@ -631,12 +887,13 @@ bool CRTPacket::Get2DMarker(unsigned int nCameraIndex, unsigned int nMarkerIndex
 //-----------------------------------------------------------
 unsigned int CRTPacket::Get2DLinCameraCount()
 {
+    EnsureIndexed(Component2dLin);
     return mn2DLinCameraCount;
 }
 
 unsigned int CRTPacket::Get2DLinMarkerCount(unsigned int nCameraIndex)
 {
-    if (mn2DLinCameraCount <= nCameraIndex)
+    if (Get2DLinCameraCount() <= nCameraIndex)
     {
         return 0;
     }
@@ -645,7 +902,7 @@ unsigned int CRTPacket::Get2DLinMarkerCount(unsigned int nCameraIndex)
 
 unsigned char CRTPacket::Get2DLinStatusFlags(unsigned int nCameraIndex)
 {
-    if (mn2DLinCameraCount > nCameraIndex && ((mnMajorVersion > 1) || (mnMinorVersion > 7)))
+    if (Get2DLinCameraCount() > nCameraIndex && ((mnMajorVersion > 1) || (mnMinorVersion > 7)))
     {
         return *((unsigned char*)(mp2DLinData[nCameraIndex] + 4));
     }
@@ -657,7 +914,7 @@ bool CRTPacket::Get2DLinMarker(unsigned int nCameraIndex, unsigned int nMarkerIn
 {
     int nOffset;
 
-    if (mn2DLinCameraCount <= nCameraIndex || Get2DLinMarkerCount(nCameraIndex) <= nMarkerIndex)
+    if (Get2DLinCameraCount() <= nCameraIndex || Get2DLinMarkerCount(nCameraIndex) <= nMarkerIndex)
     {
         return false;
     }
@@ -707,19 +964,82 @@ bool CRTPacket::Get3DMarker(unsigned int nMarkerIndex, float &fX, float &fY, flo
         return false;
     }
 
-    if (mnMajorVersion > 1 || mnMinorVersion > 7)
+    bool bValid = false;
+    Decode([&](auto decoder)
+    {
+        bValid = decltype(decoder)::Get3DMarker(pData + 16, nMarkerIndex, fX, fY, fZ);
+    });
+    return bValid;
+}
+
+
+unsigned int CRTPacket::Get3DMarkers(float* pXYZ, unsigned int nBufSize, unsigned char* pValid)
+{
+    if (pXYZ == nullptr)
     {
-        fX = SetByteOrder((float*)(pData + 16 + nMarkerIndex * 12));
-        fY = SetByteOrder((float*)(pData + 20 + nMarkerIndex * 12));
-        fZ = SetByteOrder((float*)(pData + 24 + nMarkerIndex * 12));
+        return 0;
     }
-    else
+    return Decode3DMarkers(nullptr, nBufSize, pXYZ, nullptr, nullptr, nullptr, pValid);
+}
+
+unsigned int CRTPacket::Get3DMarkers(float* pX, float* pY, float* pZ, unsigned int nBufSize, unsigned char* pValid)
+{
+    if (pX == nullptr || pY == nullptr || pZ == nullptr)
+    {
+        return 0;
+    }
+    return Decode3DMarkers(nullptr, nBufSize, nullptr, pX, pY, pZ, pValid);
+}
+
+unsigned int CRTPacket::Get3DMarkers(const unsigned int* pIndices, unsigned int nIndexCount, float* pXYZ, unsigned char* pValid)
+{
+    if (pIndices == nullptr || pXYZ == nullptr)
+    {
+        return 0;
+    }
+    return Decode3DMarkers(pIndices, nIndexCount, pXYZ, nullptr, nullptr, nullptr, pValid);
+}
+
+unsigned int CRTPacket::Get3DMarkers(const unsigned int* pIndices, unsigned int nIndexCount, float* pX, float* pY, float* pZ, unsigned char* pValid)
+{
+    if (pIndices == nullptr || pX == nullptr || pY == nullptr || pZ == nullptr)
     {
-        fX = (float)SetByteOrder((double*)(pData + 16 + nMarkerIndex * 24));
-        fY = (float)SetByteOrder((double*)(pData + 24 + nMarkerIndex * 24));
-        fZ = (float)SetByteOrder((double*)(pData + 32 + nMarkerIndex * 24));
+        return 0;
     }
-    return (isnan(fX) == 0);
+    return Decode3DMarkers(pIndices, nIndexCount, nullptr, pX, pY, pZ, pValid);
+}
+
+// Component header and byte order are read once for the whole frame. Without pIndices nCount is the buffer size,
+// with pIndices it is the number of indices.
+unsigned int CRTPacket::Decode3DMarkers(const unsigned int* pIndices, unsigned int nCount, float* pXYZ, float* pX, float* pY, float* pZ, unsigned char* pValid)
+{
+    char* pData = mpComponentData[Component3d - 1];
+
+    if (pData == nullptr)
+    {
+        return 0;
+    }
+    const unsigned int nMarkerCount = SetByteOrder((unsigned int*)(pData + 8));
+
+    if (pIndices == nullptr)
+    {
+        nCount = (nMarkerCount < nCount) ? nMarkerCount : nCount;
+    }
+
+    const char* pMarkers = pData + 16;
+    Decode([&](auto decoder)
+    {
+        using TDecoder = decltype(decoder);
+        if (pIndices != nullptr)
+        {
+            Decode3DMarkerList<TDecoder>(pMarkers, nMarkerCount, pIndices, nCount, pXYZ, pX, pY, pZ, pValid);
+        }
+        else
+        {
+            Decode3DMarkerRange<TDecoder>(pMarkers, nCount, pXYZ, pX, pY, pZ, pValid);
+        }
+    });
+    return nCount;
 }
 
 
@@ -746,21 +1066,12 @@ bool CRTPacket::Get3DResidualMarker(unsigned int nMarkerIndex, float &fX, float
         return false;
     }
 
-    if (mnMajorVersion > 1 || mnMinorVersion > 7)
+    bool bValid = false;
+    Decode([&](auto decoder)
     {
-        fX        = SetByteOrder((float*)(pData + 16 + nMarkerIndex * 16));
-        fY        = SetByteOrder((float*)(pData + 20 + nMarkerIndex * 16));
-        fZ        = SetByteOrder((float*)(pData + 24 + nMarkerIndex * 16));
-        fResidual = SetByteOrder((float*)(pData + 28 + nMarkerIndex * 16));
-    }
-    else
-    {
-        fX        = (float)SetByteOrder((double*)(pData + 16 + nMarkerIndex * 32));
-        fY        = (float)SetByteOrder((double*)(pData + 24 + nMarkerIndex * 32));
-        fZ        = (float)SetByteOrder((double*)(pData + 32 + nMarkerIndex * 32));
-        fResidual =        SetByteOrder((float*) (pData + 40 + nMarkerIndex * 32));
-    }
-    return (isnan(fX) == 0);
+        bValid = decltype(decoder)::Get3DResidualMarker(pData + 16, nMarkerIndex, fX, fY, fZ, fResidual);
+    });
+    return bValid;
 }
 
 
@@ -787,20 +1098,10 @@ bool CRTPacket::Get3DNoLabelsMarker(unsigned int nMarkerIndex, float &fX, float
         return false;
     }
 
-    if (mnMajorVersion > 1 || mnMinorVersion > 7)
-    {
-        fX  = SetByteOrder((float*)(pData + 16 + nMarkerIndex * 16));
-        fY  = SetByteOrder((float*)(pData + 20 + nMarkerIndex * 16));
-        fZ  = SetByteOrder((float*)(pData + 24 + nMarkerIndex * 16));
-        nId = SetByteOrder((unsigned int*)(pData + 28 + nMarkerIndex * 16));
-    }
-    else
+    Decode([&](auto decoder)
     {
-        fX  = (float)SetByteOrder((double*)(pData + 16 + nMarkerIndex * 32));
-        fY  = (float)SetByteOrder((double*)(pData + 24 + nMarkerIndex * 32));
-        fZ  = (float)SetByteOrder((double*)(pData + 32 + nMarkerIndex * 32));
-        nId =  SetByteOrder((unsigned int*)(pData + 40 + nMarkerIndex * 32));
-    }
+        decltype(decoder)::Get3DNoLabelsMarker(pData + 16, nMarkerIndex, fX, fY, fZ, nId);
+    });
     return true;
 }
 
@@ -829,22 +1130,10 @@ bool CRTPacket::Get3DNoLabelsResidualMarker(unsigned int nMarkerIndex, float &fX
         return false;
     }
 
-    if (mnMajorVersion > 1 || mnMinorVersion > 7)
+    Decode([&](auto decoder)
     {
-        fX        = SetByteOrder((float*)(pData + 16 + nMarkerIndex * 20));
-        fY        = SetByteOrder((float*)(pData + 20 + nMarkerIndex * 20));
-        fZ        = SetByteOrder((float*)(pData + 24 + nMarkerIndex * 20));
-        nId       = SetByteOrder((unsigned int*)(pData + 28 + nMarkerIndex * 20));
-        fResidual = SetByteOrder((float*)(pData + 32 + nMarkerIndex * 20));
-    }
-    else
-    {
-        fX        = (float)SetByteOrder((double*)(pData + 16 + nMarkerIndex * 32));
-        fY        = (float)SetByteOrder((double*)(pData + 24 + nMarkerIndex * 32));
-        fZ        = (float)SetByteOrder((double*)(pData + 32 + nMarkerIndex * 32));
-        nId       =  SetByteOrder((unsigned int*)(pData + 40 + nMarkerIndex * 32));
-        fResidual =        SetByteOrder((float*) (pData + 44 + nMarkerIndex * 32));
-    }
+        decltype(decoder)::Get3DNoLabelsResidualMarker(pData + 16, nMarkerIndex, fX, fY, fZ, nId, fResidual);
+    });
     return true;
 }
 
@@ -872,26 +1161,10 @@ bool CRTPacket::Get6DOFBody(unsigned int nBodyIndex, float &fX, float &fY, float
         return false;
     }
 
-    if (mnMajorVersion > 1 || mnMinorVersion > 7)
-    {
-        fX = SetByteOrder((float*)(pData + 16 + nBodyIndex * 48));
-        fY = SetByteOrder((float*)(pData + 20 + nBodyIndex * 48));
-        fZ = SetByteOrder((float*)(pData + 24 + nBodyIndex * 48));
-        for (int i = 0; i < 9; i++)
-        {
-            afRotMatrix[i] = SetByteOrder((float*)(pData + 28 + (i * 4) + nBodyIndex * 48));
-        }
-    }
-    else
+    Decode([&](auto decoder)
     {
-        fX = (float)SetByteOrder((double*)(pData + 16 + nBodyIndex * 96));
-        fY = (float)SetByteOrder((double*)(pData + 24 + nBodyIndex * 96));
-        fZ = (float)SetByteOrder((double*)(pData + 32 + nBodyIndex * 96));
-        for (int i = 0; i < 9; i++)
-        {
-            afRotMatrix[i] = (float)SetByteOrder((double*)(pData + 40 + (i * 8) + nBodyIndex * 96));
-        }
-    }
+        decltype(decoder)::Get6DOFBody(pData + 16, nBodyIndex, fX, fY, fZ, afRotMatrix);
+    });
     return true;
 }
 
@@ -920,28 +1193,10 @@ bool CRTPacket::Get6DOFResidualBody(unsigned int nBodyIndex, float &fX, float &f
         return false;
     }
 
-    if (mnMajorVersion > 1 || mnMinorVersion > 7)
-    {
-        fX = SetByteOrder((float*)(pData + 16 + nBodyIndex * 52));
-        fY = SetByteOrder((float*)(pData + 20 + nBodyIndex * 52));
-        fZ = SetByteOrder((float*)(pData + 24 + nBodyIndex * 52));
-        for (int i = 0; i < 9; i++)
-        {
-            afRotMatrix[i] = SetByteOrder((float*)(pData + 28 + (i * 4) + nBodyIndex * 52));
-        }
-        fResidual = SetByteOrder((float*)(pData + 64 + nBodyIndex * 52));
-    }
-    else
+    Decode([&](auto decoder)
     {
-        fX = (float)SetByteOrder((double*)(pData + 16 + nBodyIndex * 104));
-        fY = (float)SetByteOrder((double*)(pData + 24 + nBodyIndex * 104));
-        fZ = (float)SetByteOrder((double*)(pData + 32 + nBodyIndex * 104));
-        for (int i = 0; i < 9; i++)
-        {
-            afRotMatrix[i] = (float)SetByteOrder((double*)(pData + 40 + (i * 8) + nBodyIndex * 104));
-        }
-        fResidual = SetByteOrder((float*)(pData + 112 + nBodyIndex * 104));
-    }
+        decltype(decoder)::Get6DOFResidualBody(pData + 16, nBodyIndex, fX, fY, fZ, afRotMatrix, fResidual);
+    });
     return true;
 }
 
@@ -970,24 +1225,10 @@ bool CRTPacket::Get6DOFEulerBody(unsigned int nBodyIndex, float &fX, float &fY,
         return false;
     }
 
-    if (mnMajorVersion > 1 || mnMinorVersion > 7)
+    Decode([&](auto decoder)
     {
-        fX    = SetByteOrder((float*)(pData + 16 + nBodyIndex * 24));
-        fY    = SetByteOrder((float*)(pData + 20 + nBodyIndex * 24));
-        fZ    = SetByteOrder((float*)(pData + 24 + nBodyIndex * 24));
-        fAng1 = SetByteOrder((float*)(pData + 28 + nBodyIndex * 24));
-        fAng2 = SetByteOrder((float*)(pData + 32 + nBodyIndex * 24));
-        fAng3 = SetByteOrder((float*)(pData + 36 + nBodyIndex * 24));
-    }
-    else
-    {
-        fX    = (float)SetByteOrder((double*)(pData + 16 + nBodyIndex * 48));
-        fY    = (float)SetByteOrder((double*)(pData + 24 + nBodyIndex * 48));
-        fZ    = (float)SetByteOrder((double*)(pData + 32 + nBodyIndex * 48));
-        fAng1 = (float)SetByteOrder((double*)(pData + 40 + nBodyIndex * 48));
-        fAng2 = (float)SetByteOrder((double*)(pData + 48 + nBodyIndex * 48));
-        fAng3 = (float)SetByteOrder((double*)(pData + 56 + nBodyIndex * 48));
-    }
+        decltype(decoder)::Get6DOFEulerBody(pData + 16, nBodyIndex, fX, fY, fZ, fAng1, fAng2, fAng3);
+    });
     return true;
 }
 
@@ -1016,26 +1257,10 @@ bool CRTPacket::Get6DOFEulerResidualBody(unsigned int nBodyIndex, float &fX, flo
         return false;
     }
 
-    if (mnMajorVersion > 1 || mnMinorVersion > 7)
+    Decode([&](auto decoder)
     {
-        fX        = SetByteOrder((float*)(pData + 16 + nBodyIndex * 28));
-        fY        = SetByteOrder((float*)(pData + 20 + nBodyIndex * 28));
-        fZ        = SetByteOrder((float*)(pData + 24 + nBodyIndex * 28));
-        fAng1     = SetByteOrder((float*)(pData + 28 + nBodyIndex * 28));
-        fAng2     = SetByteOrder((float*)(pData + 32 + nBodyIndex * 28));
-        fAng3     = SetByteOrder((float*)(pData + 36 + nBodyIndex * 28));
-        fResidual = SetByteOrder((float*)(pData + 40 + nBodyIndex * 28));
-    }
-    else
-    {
-        fX        = (float)SetByteOrder((double*)(pData + 16 + nBodyIndex * 56));
-        fY        = (float)SetByteOrder((double*)(pData + 24 + nBodyIndex * 56));
-        fZ        = (float)SetByteOrder((double*)(pData + 32 + nBodyIndex * 56));
-        fAng1     = (float)SetByteOrder((double*)(pData + 40 + nBodyIndex * 56));
-        fAng2     = (float)SetByteOrder((double*)(pData + 48 + nBodyIndex * 56));
-        fAng3     = (float)SetByteOrder((double*)(pData + 56 + nBodyIndex * 56));
-        fResidual =        SetByteOrder( (float*)(pData + 64 + nBodyIndex * 56));
-    }
+        decltype(decoder)::Get6DOFEulerResidualBody(pData + 16, nBodyIndex, fX, fY, fZ, fAng1, fAng2, fAng3, fResidual);
+    });
     return true;
 }
 
@@ -1045,12 +1270,13 @@ bool CRTPacket::Get6DOFEulerResidualBody(unsigned int nBodyIndex, float &fX, flo
 //-----------------------------------------------------------
 unsigned int CRTPacket::GetGazeVectorCount()
 {
+    EnsureIndexed(ComponentGazeVector);
     return mnGazeVectorCount;
 }
 
 unsigned int CRTPacket::GetGazeVectorSampleCount(unsigned int nVectorIndex)
 {
-    if (mnGazeVectorCount <= nVectorIndex)
+    if (GetGazeVectorCount() <= nVectorIndex)
     {
         return 0;
     }
@@ -1113,12 +1339,13 @@ bool CRTPacket::GetGazeVector(unsigned int nVectorIndex, SGazeVector* pGazeVecto
 //-----------------------------------------------------------
 unsigned int CRTPacket::GetEyeTrackerCount()
 {
+    EnsureIndexed(ComponentEyeTracker);
     return mnEyeTrackerCount;
 }
 
 unsigned int CRTPacket::GetEyeTrackerSampleCount(unsigned int nVectorIndex)
 {
-    if (mnEyeTrackerCount <= nVectorIndex)
+    if (GetEyeTrackerCount() <= nVectorIndex)
     {
         return 0;
     }
@@ -1181,11 +1408,23 @@ bool CRTPacket::GetEyeTrackerData(unsigned int eyeTrackerIndex, SEyeTracker* pEy
 //-----------------------------------------------------------
 bool CRTPacket::IsTimeCodeAvailable() const
 {
-    return mnTimecodeCount > 0;
+    // Read from the component header, the timecode table may not have been built yet.
+    const char* pComponent = mpComponentData[ComponentTimecode - 1];
+    unsigned int nCount = 0;
+
+    if (pComponent != nullptr)
+    {
+        Decode([&](auto decoder)
+        {
+            nCount = decltype(decoder)::UInt(pComponent + 8);
+        });
+    }
+    return nCount > 0;
 }
 
 bool CRTPacket::GetTimecodeType(CRTPacket::ETimecodeType &timecodeType)
 {
+    EnsureIndexed(ComponentTimecode);
     if (mnTimecodeCount <= 0)
     {
         return false;
@@ -1196,6 +1435,7 @@ bool CRTPacket::GetTimecodeType(CRTPacket::ETimecodeType &timecodeType)
 
 bool CRTPacket::GetTimecodeSMPTE(int& hours, int& minutes, int& seconds, int& frames)
 {
+    EnsureIndexed(ComponentTimecode);
     if (mnTimecodeCount <= 0)
     {
         return false;
@@ -1217,6 +1457,7 @@ bool CRTPacket::GetTimecodeSMPTE(int& hours, int& minutes, int& seconds, int& fr
 
 bool CRTPacket::GetTimecodeIRIG(int& years, int& days, int& hours, int& minutes, int& seconds, int& tenths)
 {
+    EnsureIndexed(ComponentTimecode);
     if (mnTimecodeCount <= 0)
     {
         return false;
@@ -1240,6 +1481,7 @@ bool CRTPacket::GetTimecodeIRIG(int& years, int& days, int& hours, int& minutes,
 
 bool CRTPacket::GetTimecodeCameraTime(unsigned long long &cameraTime)
 {
+    EnsureIndexed(ComponentTimecode);
     if (mnTimecodeCount <= 0)
     {
         return false;
@@ -1263,12 +1505,13 @@ bool CRTPacket::GetTimecodeCameraTime(unsigned long long &cameraTime)
 //-----------------------------------------------------------
 unsigned int CRTPacket::GetImageCameraCount()
 {
+    EnsureIndexed(ComponentImage);
     return mnImageCameraCount;
 }
 
 unsigned int CRTPacket::GetImageCameraId(unsigned int nCameraIndex)
 {
-    if (mnImageCameraCount <= nCameraIndex)
+    if (GetImageCameraCount() <= nCameraIndex)
     {
         return 0;
     }
@@ -1277,7 +1520,7 @@ unsigned int CRTPacket::GetImageCameraId(unsigned int nCameraIndex)
 
 bool CRTPacket::GetImageFormat(unsigned int nCameraIndex, EImageFormat &eImageFormat)
 {
-    if (mnImageCameraCount <= nCameraIndex)
+    if (GetImageCameraCount() <= nCameraIndex)
     {
         return false;
     }
@@ -1288,7 +1531,7 @@ bool CRTPacket::GetImageFormat(unsigned int nCameraIndex, EImageFormat &eImageFo
 
 bool CRTPacket::GetImageSize(unsigned int nCameraIndex, unsigned int& nWidth, unsigned int& nHeight)
 {
-    if (mnImageCameraCount <= nCameraIndex)
+    if (GetImageCameraCount() <= nCameraIndex)
     {
         return false;
     }
@@ -1301,7 +1544,7 @@ bool CRTPacket::GetImageSize(unsigned int nCameraIndex, unsigned int& nWidth, un
 bool CRTPacket::GetImageCrop(unsigned int nCameraIndex, float &fCropLeft, float &fCropTop,
                              float &fCropRight, float &fCropBottom)
 {
-    if (mnImageCameraCount <= nCameraIndex)
+    if (GetImageCameraCount() <= nCameraIndex)
     {
         return false;
     }
@@ -1315,7 +1558,7 @@ bool CRTPacket::GetImageCrop(unsigned int nCameraIndex, float &fCropLeft, float
 
 unsigned int CRTPacket::GetImageSize(unsigned int nCameraIndex)
 {
-    if (((mnMajorVersion == 1) && (mnMinorVersion < 8)) || mnImageCameraCount <= nCameraIndex)
+    if (((mnMajorVersion == 1) && (mnMinorVersion < 8)) || GetImageCameraCount() <= nCameraIndex)
     {
         return 0;
     }
@@ -1325,7 +1568,7 @@ unsigned int CRTPacket::GetImageSize(unsigned int nCameraIndex)
 
 unsigned int CRTPacket::GetImage(unsigned int nCameraIndex, char* pDataBuf, unsigned int nBufSize)
 {
-    if (((mnMajorVersion == 1) && (mnMinorVersion < 8)) || mnImageCameraCount <= nCameraIndex)
+    if (((mnMajorVersion == 1) && (mnMinorVersion < 8)) || GetImageCameraCount() <= nCameraIndex)
     {
         return 0;
     }
@@ -1347,6 +1590,7 @@ unsigned int CRTPacket::GetImage(unsigned int nCameraIndex, char* pDataBuf, unsi
 //-----------------------------------------------------------
 unsigned int CRTPacket::GetAnalogDeviceCount()
 {
+    EnsureIndexed(ComponentAnalog);
     return mnAnalogDeviceCount;
 }
 
@@ -1356,7 +1600,7 @@ unsigned int CRTPacket::GetAnalogDeviceId(unsigned int nDeviceIndex)
     {
         return 1;
     }
-    if (mnAnalogDeviceCount <= nDeviceIndex)
+    if (GetAnalogDeviceCount() <= nDeviceIndex)
     {
         return 0;
     }
@@ -1371,7 +1615,7 @@ unsigned int CRTPacket::GetAnalogChannelCount(unsigned int nDeviceIndex)
     {
         return SetByteOrder((unsigned int*)(pData + 8));
     }
-    if (mnAnalogDeviceCount <= nDeviceIndex)
+    if (GetAnalogDeviceCount() <= nDeviceIndex)
     {
         return 0;
     }
@@ -1384,7 +1628,7 @@ unsigned int CRTPacket::GetAnalogSampleCount(unsigned int nDeviceIndex)
     {
         return 1;
     }
-    if (mnAnalogDeviceCount <= nDeviceIndex)
+    if (GetAnalogDeviceCount() <= nDeviceIndex)
     {
         return 0;
     }
@@ -1398,7 +1642,7 @@ unsigned int CRTPacket::GetAnalogSampleNumber(unsigned int nDeviceIndex)
         return GetFrameNumber();
     }
 
-    if (mnAnalogDeviceCount <= nDeviceIndex)
+    if (GetAnalogDeviceCount() <= nDeviceIndex)
     {
         return 0;
     }
@@ -1409,7 +1653,7 @@ unsigned int CRTPacket::GetAnalogData(unsigned int nDeviceIndex, float* pDataBuf
 {
     unsigned int nSize = 0;
 
-    if (nDeviceIndex < mnAnalogDeviceCount)
+    if (nDeviceIndex < GetAnalogDeviceCount())
     {
         unsigned int nChannelCount = GetAnalogChannelCount(nDeviceIndex);
 
@@ -1432,9 +1676,12 @@ unsigned int CRTPacket::GetAnalogData(unsigned int nDeviceIndex, float* pDataBuf
             {
                 nSize = 0;
             }
-            for (unsigned int i = 0; i < nSize; i++)
+            if (nSize > 0)
             {
-                pDataBuf[i] = (float)SetByteOrder((float*)(mpAnalogData[nDeviceIndex] + 16 + i * sizeof(float)));
+                Decode([&](auto decoder)
+                {
+                    decltype(decoder)::Floats(mpAnalogData[nDeviceIndex] + 16, nSize, pDataBuf);
+                });
             }
         }
     }
@@ -1447,7 +1694,7 @@ unsigned int CRTPacket::GetAnalogData(unsigned int nDeviceIndex, unsigned int nC
     unsigned int nSampleCount = 0;
     unsigned int nChannelCount = GetAnalogChannelCount(nDeviceIndex);
 
-    if (nDeviceIndex < mnAnalogDeviceCount && nChannelIndex < nChannelCount)
+    if (nDeviceIndex < GetAnalogDeviceCount() && nChannelIndex < nChannelCount)
     {
         if ((mnMajorVersion == 1) && (mnMinorVersion == 0))
         {
@@ -1468,10 +1715,13 @@ unsigned int CRTPacket::GetAnalogData(unsigned int nDeviceIndex, unsigned int nC
             {
                 nSampleCount = 0;
             }
-            for (unsigned int i = 0; i < nSampleCount; i++)
+            if (nSampleCount > 0)
             {
-                pDataBuf[i] = (float)SetByteOrder((float*)(mpAnalogData[nDeviceIndex] + 16 +
-                               nChannelIndex * nSampleCount * sizeof(float) + i * sizeof(float)));
+                Decode([&](auto decoder)
+                {
+                    decltype(decoder)::Floats(mpAnalogData[nDeviceIndex] + 16 + nChannelIndex * nSampleCount * sizeof(float),
+                                              nSampleCount, pDataBuf);
+                });
             }
         }
     }
@@ -1482,7 +1732,7 @@ unsigned int CRTPacket::GetAnalogData(unsigned int nDeviceIndex, unsigned int nC
 bool CRTPacket::GetAnalogData(unsigned int nDeviceIndex, unsigned int nChannelIndex, unsigned int nSampleIndex,
                               float &fAnalogValue)
 {
-    if (nDeviceIndex < mnAnalogDeviceCount)
+    if (nDeviceIndex < GetAnalogDeviceCount())
     {
         unsigned int nSampleCount = GetAnalogSampleCount(nDeviceIndex);
 
@@ -1513,12 +1763,13 @@ bool CRTPacket::GetAnalogData(unsigned int nDeviceIndex, unsigned int nChannelIn
 //-----------------------------------------------------------
 unsigned int CRTPacket::GetAnalogSingleDeviceCount()
 {
+    EnsureIndexed(ComponentAnalogSingle);
     return mnAnalogSingleDeviceCount;
 }
 
 unsigned int CRTPacket::GetAnalogSingleDeviceId(unsigned int nDeviceIndex)
 {
-    if (mnAnalogSingleDeviceCount <= nDeviceIndex)
+    if (GetAnalogSingleDeviceCount() <= nDeviceIndex)
     {
         return 0;
     }
@@ -1527,7 +1778,7 @@ unsigned int CRTPacket::GetAnalogSingleDeviceId(unsigned int nDeviceIndex)
 
 unsigned int CRTPacket::GetAnalogSingleChannelCount(unsigned int nDeviceIndex)
 {
-    if (mnAnalogSingleDeviceCount <= nDeviceIndex)
+    if (GetAnalogSingleDeviceCount() <= nDeviceIndex)
     {
         return 0;
     }
@@ -1538,16 +1789,19 @@ unsigned int CRTPacket::GetAnalogSingleData(unsigned int nDeviceIndex, float* pD
 {
     unsigned int nSize = 0;
 
-    if (nDeviceIndex < mnAnalogSingleDeviceCount)
+    if (nDeviceIndex < GetAnalogSingleDeviceCount())
     {
         nSize = GetAnalogSingleChannelCount(nDeviceIndex);
         if (nBufSize < nSize || pDataBuf == nullptr)
         {
             nSize = 0;
         }
-        for (unsigned int i = 0; i < nSize; i++)
+        if (nSize > 0)
         {
-            pDataBuf[i] = SetByteOrder((float*)(mpAnalogSingleData[nDeviceIndex] + 8 + i * sizeof(float)));
+            Decode([&](auto decoder)
+            {
+                decltype(decoder)::Floats(mpAnalogSingleData[nDeviceIndex] + 8, nSize, pDataBuf);
+            });
         }
     }
 
@@ -1556,7 +1810,7 @@ unsigned int CRTPacket::GetAnalogSingleData(unsigned int nDeviceIndex, float* pD
 
 bool CRTPacket::GetAnalogSingleData(unsigned int nDeviceIndex, unsigned int nChannelIndex, float &fValue)
 {
-    if (nDeviceIndex < mnAnalogSingleDeviceCount)
+    if (nDeviceIndex < GetAnalogSingleDeviceCount())
     {
         if (nChannelIndex < GetAnalogSingleChannelCount(nDeviceIndex))
         {
@@ -1573,12 +1827,13 @@ bool CRTPacket::GetAnalogSingleData(unsigned int nDeviceIndex, unsigned int nCha
 //-----------------------------------------------------------
 unsigned int CRTPacket::GetForcePlateCount()
 {
+    EnsureIndexed(ComponentForce);
     return mnForcePlateCount;
 }
 
 unsigned int CRTPacket::GetForcePlateId(unsigned int nPlateIndex)
 {
-    if ((mnMajorVersion == 1 && mnMinorVersion == 0) || mnForcePlateCount <= nPlateIndex)
+    if ((mnMajorVersion == 1 && mnMinorVersion == 0) || GetForcePlateCount() <= nPlateIndex)
     {
         return 0;
     }
@@ -1587,7 +1842,7 @@ unsigned int CRTPacket::GetForcePlateId(unsigned int nPlateIndex)
 
 unsigned int CRTPacket::GetForceCount(unsigned int nPlateIndex)
 {
-    if (mnForcePlateCount <= nPlateIndex)
+    if (GetForcePlateCount() <= nPlateIndex)
     {
         return 0;
     }
@@ -1600,7 +1855,7 @@ unsigned int CRTPacket::GetForceCount(unsigned int nPlateIndex)
 
 unsigned int CRTPacket::GetForceNumber(unsigned int nPlateIndex)
 {
-    if (mnForcePlateCount <= nPlateIndex)
+    if (GetForcePlateCount() <= nPlateIndex)
     {
         return 0;
     }
@@ -1615,7 +1870,7 @@ unsigned int CRTPacket::GetForceData(unsigned int nPlateIndex, SForce* pForceBuf
 {
     unsigned int nSize = 0;
 
-    if (nPlateIndex < mnForcePlateCount)
+    if (nPlateIndex < GetForcePlateCount())
     {
         if ((mnMajorVersion == 1) && (mnMinorVersion == 0))
         {
@@ -1651,7 +1906,7 @@ unsigned int CRTPacket::GetForceData(unsigned int nPlateIndex, SForce* pForceBuf
 
 bool CRTPacket::GetForceData(unsigned int nPlateIndex, unsigned int nForceIndex, SForce &sForce)
 {
-    if (nPlateIndex < mnForcePlateCount)
+    if (nPlateIndex < GetForcePlateCount())
     {
         if ((mnMajorVersion == 1) && (mnMinorVersion == 0))
         {
@@ -1699,12 +1954,13 @@ bool CRTPacket::GetForceData(unsigned int nPlateIndex, unsigned int nForceIndex,
 //-----------------------------------------------------------
 unsigned int CRTPacket::GetSkeletonCount()
 {
+    EnsureIndexed(ComponentSkeleton);
     return mSkeletonCount;
 }
 
 unsigned int CRTPacket::GetSkeletonSegmentCount(unsigned int nSkeletonIndex)
 {
-    if (mSkeletonCount <= nSkeletonIndex)
+    if (GetSkeletonCount() <= nSkeletonIndex)
     {
         return 0;
     }
@@ -1713,7 +1969,7 @@ unsigned int CRTPacket::GetSkeletonSegmentCount(unsigned int nSkeletonIndex)
 
 bool CRTPacket::GetSkeletonSegments(unsigned int nSkeletonIndex, SSkeletonSegment* segmentBuffer, unsigned int nBufSize)
 {
-    if (mSkeletonCount <= nSkeletonIndex)
+    if (GetSkeletonCount() <= nSkeletonIndex)
     {
         return false;
     }
@@ -1730,30 +1986,16 @@ bool CRTPacket::GetSkeletonSegments(unsigned int nSkeletonIndex, SSkeletonSegmen
         return false;
     }
 
-    if (mbBigEndian)
+    Decode([&](auto decoder)
     {
-        for (unsigned int i = 0; i < segmentCount; i++)
-        {
-            segmentBuffer[i].id = SetByteOrder((unsigned int*)(mpSkeletonData[nSkeletonIndex] + 4 + i * 32));
-            segmentBuffer[i].positionX = SetByteOrder((float*)(mpSkeletonData[nSkeletonIndex] + 8 + i * 32));
-            segmentBuffer[i].positionY = SetByteOrder((float*)(mpSkeletonData[nSkeletonIndex] + 12 + i * 32));
-            segmentBuffer[i].positionZ = SetByteOrder((float*)(mpSkeletonData[nSkeletonIndex] + 16 + i * 32));
-            segmentBuffer[i].rotationX = SetByteOrder((float*)(mpSkeletonData[nSkeletonIndex] + 20 + i * 32));
-            segmentBuffer[i].rotationY = SetByteOrder((float*)(mpSkeletonData[nSkeletonIndex] + 24 + i * 32));
-            segmentBuffer[i].rotationZ = SetByteOrder((float*)(mpSkeletonData[nSkeletonIndex] + 28 + i * 32));
-            segmentBuffer[i].rotationW = SetByteOrder((float*)(mpSkeletonData[nSkeletonIndex] + 32 + i * 32));
-        }
-    }
-    else
-    {
-        memcpy(segmentBuffer, mpSkeletonData[nSkeletonIndex] + 4, sizeof(SSkeletonSegment) * segmentCount);
-    }
+        decltype(decoder)::GetSkeletonSegments(mpSkeletonData[nSkeletonIndex] + 4, segmentCount, segmentBuffer);
+    });
     return true;
 }
 
 bool CRTPacket::GetSkeletonSegment(unsigned int nSkeletonIndex, unsigned segmentIndex, SSkeletonSegment &segment)
 {
-    if (mSkeletonCount <= nSkeletonIndex)
+    if (GetSkeletonCount() <= nSkeletonIndex)
     {
         return false;
     }
@@ -1769,21 +2011,10 @@ bool CRTPacket::GetSkeletonSegment(unsigned int nSkeletonIndex, unsigned segment
         return false;
     }
 
-    if (mbBigEndian)
+    Decode([&](auto decoder)
     {
-        segment.id = SetByteOrder((unsigned int*)(mpSkeletonData[nSkeletonIndex] + 4 + 32 * segmentIndex));
-        segment.positionX = SetByteOrder((float*)(mpSkeletonData[nSkeletonIndex] + 8 + 32 * segmentIndex));
-        segment.positionY = SetByteOrder((float*)(mpSkeletonData[nSkeletonIndex] + 12 + 32 * segmentIndex));
-        segment.positionZ = SetByteOrder((float*)(mpSkeletonData[nSkeletonIndex] + 16 + 32 * segmentIndex));
-        segment.rotationX = SetByteOrder((float*)(mpSkeletonData[nSkeletonIndex] + 20 + 32 * segmentIndex));
-        segment.rotationY = SetByteOrder((float*)(mpSkeletonData[nSkeletonIndex] + 24 + 32 * segmentIndex));
-        segment.rotationZ = SetByteOrder((float*)(mpSkeletonData[nSkeletonIndex] + 28 + 32 * segmentIndex));
-        segment.rotationW = SetByteOrder((float*)(mpSkeletonData[nSkeletonIndex] + 32 + 32 * segmentIndex));
-    }
-    else
-    {
-        memcpy(&segment, mpSkeletonData[nSkeletonIndex] + 4 + 32 * segmentIndex, sizeof(SSkeletonSegment));
-    }
+        decltype(decoder)::GetSkeletonSegment(mpSkeletonData[nSkeletonIndex] + 4, segmentIndex, segment);
+    });
     
     return true;
 }
@@ -1794,12 +2025,13 @@ bool CRTPacket::GetSkeletonSegment(unsigned int nSkeletonIndex, unsigned segment
 //-----------------------------------------------------------
 unsigned int CRTPacket::GetForceSinglePlateCount()
 {
+    EnsureIndexed(ComponentForceSingle);
     return mnForceSinglePlateCount;
 }
 
 unsigned int CRTPacket::GetForceSinglePlateId(unsigned int nPlateIndex)
 {
-    if ((mnMajorVersion == 1 && mnMinorVersion == 0) || mnForceSinglePlateCount <= nPlateIndex)
+    if ((mnMajorVersion == 1 && mnMinorVersion == 0) || GetForceSinglePlateCount() <= nPlateIndex)
     {
         return 0;
     }
@@ -1808,7 +2040,7 @@ unsigned int CRTPacket::GetForceSinglePlateId(unsigned int nPlateIndex)
 
 bool CRTPacket::GetForceSingleData(unsigned int nPlateIndex, SForce &sForce)
 {
-    if (nPlateIndex < mnForceSinglePlateCount)
+    if (nPlateIndex < GetForceSinglePlateCount())
     {
         for (unsigned int k = 0; k < 9; k++)
         {
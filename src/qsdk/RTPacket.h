@@ -157,6 +157,15 @@ public:
     void             SetEndianness(bool bBigEndian);
     void             ClearData();
     void             SetData(char* ptr);
+    // Components the caller reads, as a mask of CRTProtocol::cComponent* bits (see ComponentBit).
+    // 0, the default, makes SetData index every component. Otherwise SetData only records where
+    // the registered components start, stopping once it has found them all, and the per camera /
+    // per device tables of a component are built the first time it is accessed. Components that
+    // aren't registered may read as absent. Lazy indexing writes to the packet, so a packet
+    // mustn't be read from several threads at once in that mode.
+    void             SetConsumedComponents(unsigned int nComponentMask);
+    unsigned int     GetConsumedComponents() const;
+    static unsigned int ComponentBit(EComponentType eComponent) { return 1u << (eComponent - 1); }
     void             GetData(char* &ptr, unsigned int &nSize);
 
     unsigned int     GetSize();
@@ -197,6 +206,16 @@ public:
 
     unsigned int     Get3DMarkerCount();
     bool             Get3DMarker(unsigned int nMarkerIndex, float &fX, float &fY, float &fZ);
+    // Decode all markers (at most nBufSize) or the markers listed in pIndices in one pass, to pXYZ
+    // as x, y, z per marker or to separate x, y and z arrays. pValid, if given, gets 1 per marker
+    // with a position and 0 for a marker that is NaN or out of range. Returns the number of markers written.
+    unsigned int     Get3DMarkers(float* pXYZ, unsigned int nBufSize, unsigned char* pValid = nullptr);
+    unsigned int     Get3DMarkers(float* pX, float* pY, float* pZ, unsigned int nBufSize,
+                                  unsigned char* pValid = nullptr);
+    unsigned int     Get3DMarkers(const unsigned int* pIndices, unsigned int nIndexCount, float* pXYZ,
+                                  unsigned char* pValid = nullptr);
+    unsigned int     Get3DMarkers(const unsigned int* pIndices, unsigned int nIndexCount, float* pX, float* pY,
+                                  float* pZ, unsigned char* pValid = nullptr);
 
     unsigned int     Get3DResidualMarkerCount();
     bool             Get3DResidualMarker(unsigned int nMarkerIndex, float &fX, float &fY, float &fZ,
@@ -286,6 +305,24 @@ public:
     bool             GetSkeletonSegment(unsigned int nSkeletonIndex, unsigned segmentIndex, SSkeletonSegment &segment);
 
 private:
+    // Which TRTPacketDecoder instantiation the accessors use, see RTPacketDecoder.h.
+    enum EDecoder
+    {
+        DecoderLittleEndian,
+        DecoderBigEndian,
+        DecoderLittleEndianDoubles,
+        DecoderBigEndianDoubles
+    };
+
+    void             SelectDecoder();
+    void             EnsureIndexed(EComponentType eComponent);
+    void             IndexComponent(EComponentType eComponent);
+    template <typename TFunc>
+    void             Decode(TFunc&& func) const;
+
+    unsigned int     Decode3DMarkers(const unsigned int* pIndices, unsigned int nCount, float* pXYZ,
+                                     float* pX, float* pY, float* pZ, unsigned char* pValid);
+
     float            SetByteOrder(float* pfData);
     double           SetByteOrder(double* pfData);
     short            SetByteOrder(short* pnData);
@@ -326,6 +363,11 @@ private:
     int            mnMajorVersion;
     int            mnMinorVersion;
     bool           mbBigEndian;
+    EDecoder       meDecoder;
+    unsigned int   mnConsumedComponents; // 0 when every component is indexed in SetData
+    unsigned int   mnIndexedComponents;  // Components whose tables are built for the current data
+
+    static const unsigned int cAllComponents = (1u << (ComponentNone - 1)) - 1;
 }; // RTPacket
 
 
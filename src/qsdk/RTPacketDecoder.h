@@ -0,0 +1,219 @@
+#ifndef RTPACKET_DECODER_H
+#define RTPACKET_DECODER_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "RTPacket.h"
+
+// Decoding of data component fields with the byte order and the wire format fixed at compile time.
+// bBigEndian is the byte order of the stream. bFloats is the wire format of protocol 1.8 and later,
+// older versions send 3D and 6DOF values as doubles.
+// CRTPacket picks one instantiation whenever its version or byte order is set, which happens once in
+// CRTProtocol::Connect, and each accessor dispatches to it once per call. Loops in here have no
+// per-field branches and compile down to plain loads (and byte swaps for big endian streams).
+// Pointers are to the first item after a component's header.
+template <bool bBigEndian, bool bFloats>
+struct TRTPacketDecoder
+{
+    static const bool         cBigEndian = bBigEndian;
+    static const bool         cFloats    = bFloats;
+    static const unsigned int cRealSize  = bFloats ? 4 : 8;
+
+    // Item sizes, old versions pad the 4 byte fields after the doubles to 8 bytes.
+    static const unsigned int c3DSize                  = bFloats ? 12 : 24;
+    static const unsigned int c3DResidualSize          = bFloats ? 16 : 32;
+    static const unsigned int c3DNoLabelsSize          = bFloats ? 16 : 32;
+    static const unsigned int c3DNoLabelsResidualSize  = bFloats ? 20 : 32;
+    static const unsigned int c6DOFSize                = bFloats ? 48 : 96;
+    static const unsigned int c6DOFResidualSize        = bFloats ? 52 : 104;
+    static const unsigned int c6DOFEulerSize           = bFloats ? 24 : 48;
+    static const unsigned int c6DOFEulerResidualSize   = bFloats ? 28 : 56;
+    static const unsigned int cSkeletonSegmentSize     = 32;
+
+    static uint32_t Load32(const char* pData)
+    {
+        uint32_t nValue;
+        memcpy(&nValue, pData, sizeof(nValue));
+        if (bBigEndian)
+        {
+            nValue = (nValue >> 24) | ((nValue >> 8) & 0xff00) | ((nValue << 8) & 0xff0000) | (nValue << 24);
+        }
+        return nValue;
+    }
+
+    static uint64_t Load64(const char* pData)
+    {
+        uint64_t nValue;
+        memcpy(&nValue, pData, sizeof(nValue));
+        if (bBigEndian)
+        {
+            nValue = ((uint64_t)Load32(pData) << 32) | Load32(pData + 4);
+        }
+        return nValue;
+    }
+
+    static unsigned int UInt(const char* pData)
+    {
+        return Load32(pData);
+    }
+
+    static float Float(const char* pData)
+    {
+        const uint32_t nValue = Load32(pData);
+        float fValue;
+        memcpy(&fValue, &nValue, sizeof(fValue));
+        return fValue;
+    }
+
+    static double Double(const char* pData)
+    {
+        const uint64_t nValue = Load64(pData);
+        double fValue;
+        memcpy(&fValue, &nValue, sizeof(fValue));
+        return fValue;
+    }
+
+    // A position or rotation value, float or double depending on the wire format.
+    static float Real(const char* pData)
+    {
+        return bFloats ? Float(pData) : (float)Double(pData);
+    }
+
+    static void Reals(const char* pData, unsigned int nCount, float* pDst)
+    {
+        for (unsigned int i = 0; i < nCount; i++)
+        {
+            pDst[i] = Real(pData + i * cRealSize);
+        }
+    }
+
+    static void Floats(const char* pData, unsigned int nCount, float* pDst)
+    {
+        if (!bBigEndian)
+        {
+            memcpy(pDst, pData, nCount * sizeof(float));
+            return;
+        }
+        for (unsigned int i = 0; i < nCount; i++)
+        {
+            pDst[i] = Float(pData + i * sizeof(float));
+        }
+    }
+
+    static bool Get3DMarker(const char* pMarkers, unsigned int nIndex, float &fX, float &fY, float &fZ)
+    {
+        const char* pMarker = pMarkers + nIndex * c3DSize;
+        fX = Real(pMarker);
+        fY = Real(pMarker + cRealSize);
+        fZ = Real(pMarker + 2 * cRealSize);
+        return (isnan(fX) == 0);
+    }
+
+    static bool Get3DResidualMarker(const char* pMarkers, unsigned int nIndex, float &fX, float &fY, float &fZ,
+                                    float &fResidual)
+    {
+        const char* pMarker = pMarkers + nIndex * c3DResidualSize;
+        fX        = Real(pMarker);
+        fY        = Real(pMarker + cRealSize);
+        fZ        = Real(pMarker + 2 * cRealSize);
+        fResidual = Float(pMarker + 3 * cRealSize);
+        return (isnan(fX) == 0);
+    }
+
+    static void Get3DNoLabelsMarker(const char* pMarkers, unsigned int nIndex, float &fX, float &fY, float &fZ,
+                                    unsigned int &nId)
+    {
+        const char* pMarker = pMarkers + nIndex * c3DNoLabelsSize;
+        fX  = Real(pMarker);
+        fY  = Real(pMarker + cRealSize);
+        fZ  = Real(pMarker + 2 * cRealSize);
+        nId = UInt(pMarker + 3 * cRealSize);
+    }
+
+    static void Get3DNoLabelsResidualMarker(const char* pMarkers, unsigned int nIndex, float &fX, float &fY,
+                                            float &fZ, unsigned int &nId, float &fResidual)
+    {
+        const char* pMarker = pMarkers + nIndex * c3DNoLabelsResidualSize;
+        fX        = Real(pMarker);
+        fY        = Real(pMarker + cRealSize);
+        fZ        = Real(pMarker + 2 * cRealSize);
+        nId       = UInt(pMarker + 3 * cRealSize);
+        fResidual = Float(pMarker + 3 * cRealSize + 4);
+    }
+
+    static void Get6DOFBody(const char* pBodies, unsigned int nIndex, float &fX, float &fY, float &fZ,
+                            float afRotMatrix[9])
+    {
+        const char* pBody = pBodies + nIndex * c6DOFSize;
+        fX = Real(pBody);
+        fY = Real(pBody + cRealSize);
+        fZ = Real(pBody + 2 * cRealSize);
+        Reals(pBody + 3 * cRealSize, 9, afRotMatrix);
+    }
+
+    static void Get6DOFResidualBody(const char* pBodies, unsigned int nIndex, float &fX, float &fY, float &fZ,
+                                    float afRotMatrix[9], float &fResidual)
+    {
+        const char* pBody = pBodies + nIndex * c6DOFResidualSize;
+        fX = Real(pBody);
+        fY = Real(pBody + cRealSize);
+        fZ = Real(pBody + 2 * cRealSize);
+        Reals(pBody + 3 * cRealSize, 9, afRotMatrix);
+        fResidual = Float(pBody + 12 * cRealSize);
+    }
+
+    static void Get6DOFEulerBody(const char* pBodies, unsigned int nIndex, float &fX, float &fY, float &fZ,
+                                 float &fAng1, float &fAng2, float &fAng3)
+    {
+        const char* pBody = pBodies + nIndex * c6DOFEulerSize;
+        fX    = Real(pBody);
+        fY    = Real(pBody + cRealSize);
+        fZ    = Real(pBody + 2 * cRealSize);
+        fAng1 = Real(pBody + 3 * cRealSize);
+        fAng2 = Real(pBody + 4 * cRealSize);
+        fAng3 = Real(pBody + 5 * cRealSize);
+    }
+
+    static void Get6DOFEulerResidualBody(const char* pBodies, unsigned int nIndex, float &fX, float &fY, float &fZ,
+                                         float &fAng1, float &fAng2, float &fAng3, float &fResidual)
+    {
+        const char* pBody = pBodies + nIndex * c6DOFEulerResidualSize;
+        fX        = Real(pBody);
+        fY        = Real(pBody + cRealSize);
+        fZ        = Real(pBody + 2 * cRealSize);
+        fAng1     = Real(pBody + 3 * cRealSize);
+        fAng2     = Real(pBody + 4 * cRealSize);
+        fAng3     = Real(pBody + 5 * cRealSize);
+        fResidual = Float(pBody + 6 * cRealSize);
+    }
+
+    static void GetSkeletonSegment(const char* pSegments, unsigned int nIndex, CRTPacket::SSkeletonSegment &segment)
+    {
+        const char* pSegment = pSegments + nIndex * cSkeletonSegmentSize;
+        segment.id        = UInt(pSegment);
+        segment.positionX = Float(pSegment + 4);
+        segment.positionY = Float(pSegment + 8);
+        segment.positionZ = Float(pSegment + 12);
+        segment.rotationX = Float(pSegment + 16);
+        segment.rotationY = Float(pSegment + 20);
+        segment.rotationZ = Float(pSegment + 24);
+        segment.rotationW = Float(pSegment + 28);
+    }
+
+    static void GetSkeletonSegments(const char* pSegments, unsigned int nCount, CRTPacket::SSkeletonSegment* pSegmentBuf)
+    {
+        if (!bBigEndian)
+        {
+            memcpy(pSegmentBuf, pSegments, nCount * cSkeletonSegmentSize);
+            return;
+        }
+        for (unsigned int i = 0; i < nCount; i++)
+        {
+            GetSkeletonSegment(pSegments, i, pSegmentBuf[i]);
+        }
+    }
+};
+
+#endif // RTPACKET_DECODER_H
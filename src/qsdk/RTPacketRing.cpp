@@ -0,0 +1,178 @@
+#include "RTPacketRing.h"
+
+CRTPacketHandle::CRTPacketHandle() : mpRing(nullptr), mnSlot(0)
+{
+}
+
+CRTPacketHandle::CRTPacketHandle(CRTPacketRing* pRing, unsigned int nSlot) : mpRing(pRing), mnSlot(nSlot)
+{
+}
+
+CRTPacketHandle::CRTPacketHandle(CRTPacketHandle&& other) : mpRing(other.mpRing), mnSlot(other.mnSlot)
+{
+    other.mpRing = nullptr;
+}
+
+CRTPacketHandle& CRTPacketHandle::operator=(CRTPacketHandle&& other)
+{
+    if (this != &other)
+    {
+        Release();
+        mpRing = other.mpRing;
+        mnSlot = other.mnSlot;
+        other.mpRing = nullptr;
+    }
+    return *this;
+}
+
+CRTPacketHandle::~CRTPacketHandle()
+{
+    Release();
+}
+
+void CRTPacketHandle::Release()
+{
+    if (mpRing)
+    {
+        mpRing->Unpin(mnSlot);
+        mpRing = nullptr;
+    }
+}
+
+CRTPacket* CRTPacketHandle::Get() const
+{
+    if (mpRing == nullptr)
+    {
+        return nullptr;
+    }
+    return &mpRing->mSlots[mnSlot]->packet;
+}
+
+long long CRTPacketHandle::GetArrivalTime() const
+{
+    if (mpRing == nullptr)
+    {
+        return 0;
+    }
+    return mpRing->mSlots[mnSlot]->arrivalTimeNs;
+}
+
+
+CRTPacketRing::CRTPacketRing(unsigned int nSlotCount, unsigned int nSlotCapacity)
+{
+    mnCurrent = -1;
+    mSlots.reserve(nSlotCount);
+    for (unsigned int i = 0; i < nSlotCount; i++)
+    {
+        std::unique_ptr<SSlot> slot(new SSlot());
+        slot->data.resize(nSlotCapacity);
+        slot->arrivalTimeNs = 0;
+        slot->pins = 0;
+        mSlots.push_back(std::move(slot));
+    }
+}
+
+void CRTPacketRing::SetVersion(unsigned int nMajorVersion, unsigned int nMinorVersion)
+{
+    for (auto& slot : mSlots)
+    {
+        slot->packet.SetVersion(nMajorVersion, nMinorVersion);
+    }
+}
+
+void CRTPacketRing::SetEndianness(bool bBigEndian)
+{
+    for (auto& slot : mSlots)
+    {
+        slot->packet.SetEndianness(bBigEndian);
+    }
+}
+
+void CRTPacketRing::SetConsumedComponents(unsigned int nComponentMask)
+{
+    for (auto& slot : mSlots)
+    {
+        slot->packet.SetConsumedComponents(nComponentMask);
+    }
+}
+
+unsigned int CRTPacketRing::GetSlotCount() const
+{
+    return (unsigned int)mSlots.size();
+}
+
+// Find the next slot after nAfterSlot that is neither the current packet nor held by a handle.
+int CRTPacketRing::NextFree(int nAfterSlot) const
+{
+    const int nSlotCount = (int)mSlots.size();
+    int nStart = (nAfterSlot < 0) ? mnCurrent : nAfterSlot;
+
+    for (int i = 1; i <= nSlotCount; i++)
+    {
+        int nSlot = (nStart + i + nSlotCount) % nSlotCount;
+        if (nSlot != mnCurrent && mSlots[nSlot]->pins.load(std::memory_order_acquire) == 0)
+        {
+            return nSlot;
+        }
+    }
+    return -1;
+}
+
+// Only grows the slot when a packet doesn't fit, which should never happen for streamed frames.
+char* CRTPacketRing::GetSlotData(unsigned int nSlot, unsigned int nMinSize)
+{
+    auto& data = mSlots[nSlot]->data;
+    if (nMinSize > data.size())
+    {
+        data.resize(nMinSize);
+    }
+    return data.data();
+}
+
+unsigned int CRTPacketRing::GetSlotCapacity(unsigned int nSlot) const
+{
+    return (unsigned int)mSlots[nSlot]->data.size();
+}
+
+CRTPacket* CRTPacketRing::Commit(unsigned int nSlot, long long nArrivalTimeNs)
+{
+    auto& slot = *mSlots[nSlot];
+    slot.packet.SetData(slot.data.data());
+    slot.arrivalTimeNs = nArrivalTimeNs;
+    mnCurrent = nSlot;
+    return &slot.packet;
+}
+
+CRTPacket* CRTPacketRing::GetCurrent() const
+{
+    if (mnCurrent < 0)
+    {
+        return nullptr;
+    }
+    return &mSlots[mnCurrent]->packet;
+}
+
+long long CRTPacketRing::GetCurrentArrivalTime() const
+{
+    if (mnCurrent < 0)
+    {
+        return 0;
+    }
+    return mSlots[mnCurrent]->arrivalTimeNs;
+}
+
+// Must be called from the receiving thread, between receives.
+CRTPacketHandle CRTPacketRing::Hold()
+{
+    if (mnCurrent < 0)
+    {
+        return CRTPacketHandle();
+    }
+    mSlots[mnCurrent]->pins.fetch_add(1, std::memory_order_relaxed);
+    return CRTPacketHandle(this, mnCurrent);
+}
+
+void CRTPacketRing::Unpin(unsigned int nSlot)
+{
+    mSlots[nSlot]->pins.fetch_sub(1, std::memory_order_release);
+}
@@ -0,0 +1,74 @@
+#ifndef RTPACKETRING_H
+#define RTPACKETRING_H
+
+#include "RTPacket.h"
+#include <vector>
+#include <atomic>
+#include <memory>
+
+class CRTPacketRing;
+
+// Keeps a received packet alive while later packets arrive. The slot goes back to the ring
+// when the handle is released or destroyed.
+class DLL_EXPORT CRTPacketHandle
+{
+public:
+    CRTPacketHandle();
+    CRTPacketHandle(CRTPacketRing* pRing, unsigned int nSlot);
+    CRTPacketHandle(CRTPacketHandle&& other);
+    CRTPacketHandle& operator=(CRTPacketHandle&& other);
+    CRTPacketHandle(const CRTPacketHandle&) = delete;
+    CRTPacketHandle& operator=(const CRTPacketHandle&) = delete;
+    ~CRTPacketHandle();
+
+    void       Release();
+    CRTPacket* Get() const;
+    long long  GetArrivalTime() const;
+    CRTPacket* operator->() const { return Get(); }
+    explicit   operator bool() const { return mpRing != nullptr; }
+
+private:
+    CRTPacketRing* mpRing;
+    unsigned int   mnSlot;
+};
+
+// Preallocated packet slots that received frames are written into directly.
+// One thread receives (NextFree / Commit / Hold), handles may be released from any thread.
+class DLL_EXPORT CRTPacketRing
+{
+public:
+    static const unsigned int cDefaultSlotCount    = 32;
+    static const unsigned int cDefaultSlotCapacity = 65535;
+
+    CRTPacketRing(unsigned int nSlotCount = cDefaultSlotCount, unsigned int nSlotCapacity = cDefaultSlotCapacity);
+
+    void         SetVersion(unsigned int nMajorVersion, unsigned int nMinorVersion);
+    void         SetEndianness(bool bBigEndian);
+    void         SetConsumedComponents(unsigned int nComponentMask);
+
+    unsigned int GetSlotCount() const;
+    int          NextFree(int nAfterSlot = -1) const;   // -1 if every slot is held
+    char*        GetSlotData(unsigned int nSlot, unsigned int nMinSize = 0);
+    unsigned int GetSlotCapacity(unsigned int nSlot) const;
+    CRTPacket*   Commit(unsigned int nSlot, long long nArrivalTimeNs = 0); // Make the slot the current packet.
+    CRTPacket*   GetCurrent() const;
+    long long    GetCurrentArrivalTime() const;
+    CRTPacketHandle Hold();                              // Pin the current packet.
+
+private:
+    friend class CRTPacketHandle;
+    void         Unpin(unsigned int nSlot);
+
+    struct SSlot
+    {
+        std::vector<char>  data;
+        CRTPacket          packet;
+        long long          arrivalTimeNs;
+        std::atomic<int>   pins;
+    };
+
+    std::vector<std::unique_ptr<SSlot>> mSlots;
+    int                                 mnCurrent;
+};
+
+#endif // RTPACKETRING_H
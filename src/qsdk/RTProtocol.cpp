@@ -15,6 +15,8 @@
 
 #include "RTProtocol.h"
 #include "Markup.h"
+#include "XmlReader.h"
+#include "XmlWriter.h"
 #include "Network.h"
 #include <stdexcept>
 
@@ -65,6 +67,7 @@ CRTProtocol::CRTProtocol()
     mpoRTPacket     = nullptr;
     meLastEvent     = CRTPacket::EventCaptureStopped;
     meState         = CRTPacket::EventCaptureStopped;
+    mnCameraSettingsChanges = 0;
     mnMajorVersion  = 1;
     mnMinorVersion  = 0;
     mbBigEndian     = false;
@@ -72,7 +75,16 @@ CRTProtocol::CRTProtocol()
     mnBroadcastPort = 0;
     mpFileBuffer    = nullptr;
     mbIsMaster = false;
+    mnDiscardedFrames = 0;
     mDataBuff.resize(65535);
+    mTcpStreamBuff.resize(cTcpStreamBufferSize);
+    mnTcpStreamHead = 0;
+    mnTcpStreamTail = 0;
+    mnTcpStreamTimeNs = 0;
+    mUdpBatchTimes.resize(cUdpBatchSize);
+    mUdpBatchSlots.resize(cUdpBatchSize);
+    mUdpBatchPtrs.resize(cUdpBatchSize);
+    mUdpBatchSizes.resize(cUdpBatchSize);
     mSendBuffer.resize(5000);
 } // CRTProtocol
 
@@ -84,11 +96,6 @@ CRTProtocol::~CRTProtocol()
         delete mpoNetwork;
         mpoNetwork = nullptr;
     }
-    if (mpoRTPacket)
-    {
-        delete mpoRTPacket;
-        mpoRTPacket = nullptr;
-    }
 } // ~CRTProtocol
 
 
@@ -120,17 +127,11 @@ bool CRTProtocol::Connect(const char* pServerAddr, unsigned short nPort, unsigne
         }
     }
 
-    if (mpoRTPacket)
-    {
-        delete mpoRTPacket;
-    }
-    mpoRTPacket = new CRTPacket(nMajorVersion, nMinorVersion, bBigEndian);
-
-    if (mpoRTPacket == nullptr)
-    {
-        strcpy(maErrorStr, "Could not allocate data packet.");
-        return false;
-    }
+    // The packets live in the ring, mpoRTPacket follows the slot of the last received packet.
+    mPacketRing.SetVersion(nMajorVersion, nMinorVersion);
+    mPacketRing.SetEndianness(bBigEndian);
+    mnTcpStreamHead = 0;
+    mnTcpStreamTail = 0;
 
     if (mpoNetwork->Connect(pServerAddr, nPort))
     {
@@ -226,12 +227,21 @@ void CRTProtocol::Disconnect()
 {
     mpoNetwork->Disconnect();
     mnBroadcastPort = 0;
-    if (mpoRTPacket)
+    mpoRTPacket = nullptr;
+    mnTcpStreamHead = 0;
+    mnTcpStreamTail = 0;
+    mbIsMaster = false;
+
+    // Nothing will answer the commands that are still in flight.
+    std::deque<SPendingCommand> pendingCommands;
     {
-        delete mpoRTPacket;
-        mpoRTPacket = nullptr;
+        std::lock_guard<std::mutex> lock(mCommandMutex);
+        pendingCommands.swap(mPendingCommands);
+    }
+    for (auto& command : pendingCommands)
+    {
+        CompleteCommand(command, false, "Disconnected from server.");
     }
-    mbIsMaster = false;
 } // Disconnect
 
 
@@ -256,7 +266,7 @@ bool CRTProtocol::SetVersion(int nMajorVersion, int nMinorVersion)
         {
             mnMajorVersion = nMajorVersion;
             mnMinorVersion = nMinorVersion;
-            mpoRTPacket->SetVersion(mnMajorVersion, mnMinorVersion);
+            mPacketRing.SetVersion(mnMajorVersion, mnMinorVersion);
             return true;
         }
 
@@ -867,6 +877,119 @@ bool CRTProtocol::StartCapture()
 }
 
 
+std::future<CRTProtocol::SCommandResult> CRTProtocol::SendCommandAsync(const char* pCmdStr, const char* pExpectedResponse, TCommandCallback callback)
+{
+    SPendingCommand pending;
+    pending.expected = pExpectedResponse ? pExpectedResponse : "";
+    pending.callback = callback;
+    auto future = pending.promise.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(mCommandMutex);
+        pending.issueTime = std::chrono::steady_clock::now();
+        // Queue before sending, the response may be received by another thread right away.
+        mPendingCommands.push_back(std::move(pending));
+        if (SendString(pCmdStr, CRTPacket::PacketCommand))
+        {
+            return future;
+        }
+        pending = std::move(mPendingCommands.back());
+        mPendingCommands.pop_back();
+    }
+
+    char pTmpStr[256];
+    strcpy(pTmpStr, maErrorStr);
+    sprintf(maErrorStr, "\'%s\' command failed. %s", pCmdStr, pTmpStr);
+
+    CompleteCommand(pending, false, maErrorStr);
+    return future;
+}
+
+
+std::future<CRTProtocol::SCommandResult> CRTProtocol::SetQTMEventAsync(const char* pLabel, TCommandCallback callback)
+{
+    char tTemp[100];
+    const int nLength = snprintf(tTemp, sizeof(tTemp), "%s %s",
+        (mnMajorVersion > 1 || mnMinorVersion > 7) ? "SetQTMEvent" : "Event", pLabel);
+
+    if (nLength < 0 || nLength >= (int)sizeof(tTemp))
+    {
+        strcpy(maErrorStr, "Event label too long.");
+        SPendingCommand failed;
+        failed.callback  = callback;
+        failed.issueTime = std::chrono::steady_clock::now();
+        auto future = failed.promise.get_future();
+        CompleteCommand(failed, false, maErrorStr);
+        return future;
+    }
+
+    return SendCommandAsync(tTemp, "Event set", callback);
+}
+
+
+std::future<CRTProtocol::SCommandResult> CRTProtocol::StartCaptureAsync(TCommandCallback callback)
+{
+    return SendCommandAsync("Start", "Starting measurement", callback);
+}
+
+
+std::future<CRTProtocol::SCommandResult> CRTProtocol::StopCaptureAsync(TCommandCallback callback)
+{
+    return SendCommandAsync("Stop", "Stopping measurement", callback);
+}
+
+
+size_t CRTProtocol::GetPendingCommandCount() const
+{
+    std::lock_guard<std::mutex> lock(mCommandMutex);
+    return mPendingCommands.size();
+}
+
+
+// Complete the oldest pending asynchronous command with the packet just received.
+// Returns false if no command is waiting, the packet then belongs to the caller of Receive.
+bool CRTProtocol::DispatchCommandResponse(CRTPacket::EPacketType eType)
+{
+    SPendingCommand pending;
+    {
+        std::lock_guard<std::mutex> lock(mCommandMutex);
+        if (mPendingCommands.empty())
+        {
+            return false;
+        }
+        pending = std::move(mPendingCommands.front());
+        mPendingCommands.pop_front();
+    }
+
+    if (eType == CRTPacket::PacketCommand)
+    {
+        const char* pResponse = mpoRTPacket->GetCommandString();
+        CompleteCommand(pending, pending.expected.empty() || pending.expected == pResponse, pResponse);
+    }
+    else
+    {
+        CompleteCommand(pending, false, mpoRTPacket->GetErrorString());
+    }
+    return true;
+}
+
+
+void CRTProtocol::CompleteCommand(SPendingCommand& command, bool bSuccess, const char* pResponse)
+{
+    SCommandResult result;
+    result.bSuccess     = bSuccess;
+    result.response     = pResponse;
+    result.issueTime    = command.issueTime;
+    result.responseTime = std::chrono::steady_clock::now();
+
+    if (command.callback)
+    {
+        command.callback(result);
+    }
+    command.promise.set_value(result);
+}
+
+
 bool CRTProtocol::StartRTOnFile()
 {
     char pResponseStr[256];
@@ -1460,69 +1583,182 @@ CNetwork::ResponseType CRTProtocol::Receive(CRTPacket::EPacketType &eType, bool
 {
     CNetwork::Response response(CNetwork::ResponseType::error, 0);
     unsigned int nRecvedTotal = 0;
-    unsigned int nFrameSize;
+    unsigned int nFrameSize = 0;
+    long long nArrivalTime = 0;
+    bool bDispatched = false;
+    const bool bBigEndian = (mbBigEndian || (mnMajorVersion == 1 && mnMinorVersion == 0));
 
     eType = CRTPacket::PacketNone;
 
     do 
     {
-        nRecvedTotal = 0;
-
-        response = mpoNetwork->Receive(mDataBuff.data(), (int)mDataBuff.size(), true, nTimeout);
-
-        if (response.type == CNetwork::ResponseType::timeout)
+        // Receive straight into a free ring slot, so packets held by the application stay untouched.
+        const int nSlot = mPacketRing.NextFree();
+        if (nSlot < 0)
         {
-            // Receive timeout.
-            strcpy(maErrorStr, "Data receive timeout.");
-            return CNetwork::ResponseType::timeout;
-        }
-        if (response.type == CNetwork::ResponseType::error)
-        {
-            strcpy(maErrorStr, "Socket Error.");
+            strcpy(maErrorStr, "No free packet slot, too many packets held.");
             return CNetwork::ResponseType::error;
         }
-        if (response.type == CNetwork::ResponseType::disconnect)
+        char* pData = mPacketRing.GetSlotData(nSlot);
+
+        // TCP frames are split out of the stream buffer, one recv usually brings in several of them.
+        // Only read when the next frame isn't complete yet. A UDP datagram is received directly into the slot.
+        bool bFromTcp = true;
+        unsigned int nBuffered;
+        while (true)
         {
-            strcpy(maErrorStr, "Disconnected from server.");
-            return CNetwork::ResponseType::disconnect;
-        }        
-        if (response.received < qtmPacketHeaderSize)
+            nBuffered = mnTcpStreamTail - mnTcpStreamHead;
+            if (nBuffered >= qtmPacketHeaderSize)
+            {
+                nFrameSize = CRTPacket::GetSize(&mTcpStreamBuff[mnTcpStreamHead], bBigEndian);
+                if (nFrameSize < qtmPacketHeaderSize)
+                {
+                    strcpy(maErrorStr, "Invalid packet size.");
+                    mnTcpStreamHead = mnTcpStreamTail = 0;
+                    return CNetwork::ResponseType::error;
+                }
+                if (nBuffered >= nFrameSize || nFrameSize > mTcpStreamBuff.size())
+                {
+                    // Complete, or too large for the stream buffer and read directly into the slot below.
+                    break;
+                }
+            }
+
+            if (mnTcpStreamHead > 0)
+            {
+                memmove(mTcpStreamBuff.data(), &mTcpStreamBuff[mnTcpStreamHead], nBuffered);
+                mnTcpStreamHead = 0;
+                mnTcpStreamTail = nBuffered;
+            }
+
+            response = mpoNetwork->ReceiveStream(&mTcpStreamBuff[mnTcpStreamTail], (int)(mTcpStreamBuff.size() - mnTcpStreamTail),
+                                                 pData, (int)mPacketRing.GetSlotCapacity(nSlot), nTimeout, bFromTcp);
+
+            if (response.type == CNetwork::ResponseType::timeout)
+            {
+                // Receive timeout. A partial TCP frame stays buffered for the next call.
+                strcpy(maErrorStr, "Data receive timeout.");
+                return CNetwork::ResponseType::timeout;
+            }
+            if (response.type == CNetwork::ResponseType::error)
+            {
+                strcpy(maErrorStr, "Socket Error.");
+                return CNetwork::ResponseType::error;
+            }
+            if (response.type == CNetwork::ResponseType::disconnect)
+            {
+                strcpy(maErrorStr, "Disconnected from server.");
+                return CNetwork::ResponseType::disconnect;
+            }
+            if (!bFromTcp)
+            {
+                break;
+            }
+            mnTcpStreamTail += response.received;
+            // Every complete frame left in the buffer was completed by this read, as complete frames are
+            // always taken out before reading more.
+            mnTcpStreamTimeNs = mpoNetwork->GetLastReceiveTime();
+        }
+
+        if (!bFromTcp)
         {
-            // QTM header not received.
-            strcpy(maErrorStr, "Couldn't read header bytes.");
-            return CNetwork::ResponseType::error;
+            nRecvedTotal = response.received;
+            if (nRecvedTotal < qtmPacketHeaderSize)
+            {
+                // QTM header not received.
+                strcpy(maErrorStr, "Couldn't read header bytes.");
+                return CNetwork::ResponseType::error;
+            }
+            nFrameSize   = CRTPacket::GetSize(pData, bBigEndian);
+            eType        = CRTPacket::GetType(pData, bBigEndian);
+            nArrivalTime = mpoNetwork->GetLastReceiveTime();
         }
-        nRecvedTotal += response.received;
+        else
+        {
+            nArrivalTime = mnTcpStreamTimeNs;
+            char* pFrame = &mTcpStreamBuff[mnTcpStreamHead];
+            eType        = CRTPacket::GetType(pFrame, bBigEndian);
+            nRecvedTotal = std::min(nBuffered, nFrameSize);
 
-        bool bBigEndian = (mbBigEndian || (mnMajorVersion == 1 && mnMinorVersion == 0));
-        nFrameSize = mpoRTPacket->GetSize(mDataBuff.data(), bBigEndian);
-        eType      = mpoRTPacket->GetType(mDataBuff.data(), bBigEndian);
-        
-        unsigned int nReadSize;
+            unsigned int nReadSize;
 
-        if (eType == CRTPacket::PacketC3DFile || eType == CRTPacket::PacketQTMFile)
-        {
-            if (mpFileBuffer != nullptr)
+            if (eType == CRTPacket::PacketC3DFile || eType == CRTPacket::PacketQTMFile)
             {
-                rewind(mpFileBuffer); // Start from the beginning
-                if (fwrite(mDataBuff.data() + sizeof(int) * 2, 1, nRecvedTotal - sizeof(int) * 2, mpFileBuffer) !=
-                    nRecvedTotal - sizeof(int) * 2)
+                if (mpFileBuffer != nullptr)
                 {
-                    strcpy(maErrorStr, "Failed to write file to disk.");
-                    fclose(mpFileBuffer);
+                    rewind(mpFileBuffer); // Start from the beginning
+                    if (fwrite(pFrame + sizeof(int) * 2, 1, nRecvedTotal - sizeof(int) * 2, mpFileBuffer) !=
+                        nRecvedTotal - sizeof(int) * 2)
+                    {
+                        strcpy(maErrorStr, "Failed to write file to disk.");
+                        fclose(mpFileBuffer);
+                        mpFileBuffer = nullptr;
+                        return CNetwork::ResponseType::error;
+                    }
+                    memcpy(pData, pFrame, sizeof(int) * 2);
+                    ConsumeTcpStream(nRecvedTotal);
+
+                    // Receive more data until we have read the whole packet
+                    while (nRecvedTotal < nFrameSize) 
+                    {
+                        nReadSize = nFrameSize - nRecvedTotal;
+                        if (nReadSize > mPacketRing.GetSlotCapacity(nSlot) - sizeof(int) * 2)
+                        {
+                            nReadSize = mPacketRing.GetSlotCapacity(nSlot) - sizeof(int) * 2;
+                        }
+                        // As long as we haven't received enough data, wait for more
+                        response = mpoNetwork->ReceiveTcp(&pData[sizeof(int) * 2], nReadSize, cWaitForDataTimeout);
+                        if (response.type == CNetwork::ResponseType::timeout)
+                        {
+                            strcpy(maErrorStr, "Packet truncated.");
+                            return CNetwork::ResponseType::error;
+                        }
+                        if (response.type == CNetwork::ResponseType::error)
+                        {
+                            strcpy(maErrorStr, "Socket Error.");
+                            fclose(mpFileBuffer);
+                            mpFileBuffer = nullptr;
+                            return CNetwork::ResponseType::error;
+                        }
+                        if (response.type == CNetwork::ResponseType::disconnect)
+                        {
+                            strcpy(maErrorStr, "Disconnected from server.");
+                            return CNetwork::ResponseType::disconnect;
+                        }
+
+                        if (fwrite(pData + sizeof(int) * 2, 1, response.received, mpFileBuffer) != (size_t)(response.received))
+                        {
+                            strcpy(maErrorStr, "Failed to write file to disk.");
+                            fclose(mpFileBuffer);
+                            mpFileBuffer = nullptr;
+                            return CNetwork::ResponseType::error;
+                        }
+                        nRecvedTotal += response.received;
+                    }
+                }
+                else
+                {
+                    strcpy(maErrorStr, "Receive file buffer not opened.");
+                    if (mpFileBuffer)
+                    {
+                        fclose(mpFileBuffer);
+                    }
                     mpFileBuffer = nullptr;
                     return CNetwork::ResponseType::error;
                 }
+            }
+            else
+            {
+                // Only large non-streamed packets (images, big XML) can outgrow a slot.
+                pData = mPacketRing.GetSlotData(nSlot, nFrameSize);
+                memcpy(pData, pFrame, nRecvedTotal);
+                ConsumeTcpStream(nRecvedTotal);
+
                 // Receive more data until we have read the whole packet
                 while (nRecvedTotal < nFrameSize) 
                 {
-                    nReadSize = nFrameSize - nRecvedTotal;
-                    if (nFrameSize > mDataBuff.size())                                                                                                                                                                                                                                                                                             
-                    {
-                        nReadSize = (int)mDataBuff.size();
-                    }
                     // As long as we haven't received enough data, wait for more
-                    response = mpoNetwork->Receive(&(mDataBuff.data()[sizeof(int) * 2]), nReadSize, false, cWaitForDataTimeout);
+                    response = mpoNetwork->ReceiveTcp(&pData[nRecvedTotal], nFrameSize - nRecvedTotal, -1);
                     if (response.type == CNetwork::ResponseType::timeout)
                     {
                         strcpy(maErrorStr, "Packet truncated.");
@@ -1531,8 +1767,6 @@ CNetwork::ResponseType CRTProtocol::Receive(CRTPacket::EPacketType &eType, bool
                     if (response.type == CNetwork::ResponseType::error)
                     {
                         strcpy(maErrorStr, "Socket Error.");
-                        fclose(mpFileBuffer);
-                        mpFileBuffer = nullptr;
                         return CNetwork::ResponseType::error;
                     }
                     if (response.type == CNetwork::ResponseType::disconnect)
@@ -1540,60 +1774,13 @@ CNetwork::ResponseType CRTProtocol::Receive(CRTPacket::EPacketType &eType, bool
                         strcpy(maErrorStr, "Disconnected from server.");
                         return CNetwork::ResponseType::disconnect;
                     }
-
-                    if (fwrite(mDataBuff.data() + sizeof(int) * 2, 1, response.received, mpFileBuffer) != (size_t)(response.received))
-                    {
-                        strcpy(maErrorStr, "Failed to write file to disk.");
-                        fclose(mpFileBuffer);
-                        mpFileBuffer = nullptr;
-                        return CNetwork::ResponseType::error;
-                    }
                     nRecvedTotal += response.received;
+                    nArrivalTime = mpoNetwork->GetLastReceiveTime();
                 }
             }
-            else
-            {
-                strcpy(maErrorStr, "Receive file buffer not opened.");
-                if (mpFileBuffer)
-                {
-                    fclose(mpFileBuffer);
-                }
-                mpFileBuffer = nullptr;
-                return CNetwork::ResponseType::error;
-            }
-        }
-        else
-        {
-            if (nFrameSize > mDataBuff.size())
-            {
-                mDataBuff.resize(nFrameSize);
-            }
-
-            // Receive more data until we have read the whole packet
-            while (nRecvedTotal < nFrameSize) 
-            {
-                // As long as we haven't received enough data, wait for more
-                response = mpoNetwork->Receive(&(mDataBuff.data()[nRecvedTotal]), nFrameSize - nRecvedTotal, false, -1);
-                if (response.type == CNetwork::ResponseType::timeout)
-                {
-                    strcpy(maErrorStr, "Packet truncated.");
-                    return CNetwork::ResponseType::error;
-                }
-                if (response.type == CNetwork::ResponseType::error)
-                {
-                    strcpy(maErrorStr, "Socket Error.");
-                    return CNetwork::ResponseType::error;
-                }
-                if (response.type == CNetwork::ResponseType::disconnect)
-                {
-                    strcpy(maErrorStr, "Disconnected from server.");
-                    return CNetwork::ResponseType::disconnect;
-                }
-                nRecvedTotal += response.received;
-            }
         }
 
-        mpoRTPacket->SetData(mDataBuff.data());
+        mpoRTPacket = mPacketRing.Commit(nSlot, nArrivalTime);
 
         if (mpoRTPacket->GetEvent(meLastEvent)) // Update last event if there is an event
         {
@@ -1601,8 +1788,14 @@ CNetwork::ResponseType CRTProtocol::Receive(CRTPacket::EPacketType &eType, bool
             {
                 meState = meLastEvent;
             }
+            else
+            {
+                mnCameraSettingsChanges++;
+            }
         }
-    } while (bSkipEvents && eType == CRTPacket::PacketEvent);
+        // A response to an asynchronous command is handed to its sender, the caller gets the next packet.
+        bDispatched = (eType == CRTPacket::PacketCommand || eType == CRTPacket::PacketError) && DispatchCommandResponse(eType);
+    } while ((bSkipEvents && eType == CRTPacket::PacketEvent) || bDispatched);
     
     if (nRecvedTotal == nFrameSize)
     {
@@ -1614,12 +1807,182 @@ CNetwork::ResponseType CRTProtocol::Receive(CRTPacket::EPacketType &eType, bool
 } // ReceiveRTPacket
 
 
+bool CRTProtocol::TcpFrameBuffered() const
+{
+    const unsigned int nBuffered = mnTcpStreamTail - mnTcpStreamHead;
+    if (nBuffered < qtmPacketHeaderSize)
+    {
+        return false;
+    }
+    const bool bBigEndian = (mbBigEndian || (mnMajorVersion == 1 && mnMinorVersion == 0));
+    return nBuffered >= CRTPacket::GetSize(const_cast<char*>(&mTcpStreamBuff[mnTcpStreamHead]), bBigEndian);
+}
+
+
+void CRTProtocol::ConsumeTcpStream(unsigned int nSize)
+{
+    mnTcpStreamHead += nSize;
+    if (mnTcpStreamHead == mnTcpStreamTail)
+    {
+        mnTcpStreamHead = mnTcpStreamTail = 0;
+    }
+}
+
+
+// Like Receive, but when streaming over UDP every datagram that is already queued is read in one go
+// and only the newest data frame is kept. The older ones are counted in GetDiscardedFrameCount.
+CNetwork::ResponseType CRTProtocol::ReceiveLatest(CRTPacket::EPacketType &eType, bool bSkipEvents, int nTimeout)
+{
+    if (!mpoNetwork->HasUdpSocket() || TcpFrameBuffered())
+    {
+        return Receive(eType, bSkipEvents, nTimeout);
+    }
+
+    eType = CRTPacket::PacketNone;
+
+    auto response = mpoNetwork->WaitForData(nTimeout);
+    if (response.type == CNetwork::ResponseType::timeout)
+    {
+        strcpy(maErrorStr, "Data receive timeout.");
+        return CNetwork::ResponseType::timeout;
+    }
+    if (response.type == CNetwork::ResponseType::error)
+    {
+        strcpy(maErrorStr, "Socket Error.");
+        return CNetwork::ResponseType::error;
+    }
+    if ((response.received & CNetwork::cReadyTcp) || TcpFrameBuffered())
+    {
+        // Command responses and events still come on the TCP socket.
+        return Receive(eType, bSkipEvents, 0);
+    }
+
+    // The datagrams are received straight into free ring slots, the newest one becomes the current packet.
+    unsigned int nBatchSize = 0;
+    int nSlot = -1;
+    while (nBatchSize < cUdpBatchSize)
+    {
+        nSlot = mPacketRing.NextFree(nSlot);
+        if (nSlot < 0 || (nBatchSize > 0 && nSlot == mUdpBatchSlots[0]))
+        {
+            break;
+        }
+        mUdpBatchSlots[nBatchSize] = nSlot;
+        mUdpBatchPtrs[nBatchSize] = mPacketRing.GetSlotData(nSlot);
+        nBatchSize++;
+    }
+    if (nBatchSize == 0)
+    {
+        strcpy(maErrorStr, "No free packet slot, too many packets held.");
+        return CNetwork::ResponseType::error;
+    }
+
+    response = mpoNetwork->ReceiveUdpBatch(mUdpBatchPtrs.data(), (int)CRTPacketRing::cDefaultSlotCapacity, nBatchSize, mUdpBatchSizes.data(), mUdpBatchTimes.data());
+    if (response.type == CNetwork::ResponseType::timeout)
+    {
+        strcpy(maErrorStr, "Data receive timeout.");
+        return CNetwork::ResponseType::timeout;
+    }
+    if (response.type == CNetwork::ResponseType::error)
+    {
+        strcpy(maErrorStr, "Socket Error.");
+        return CNetwork::ResponseType::error;
+    }
+
+    const bool bBigEndian = (mbBigEndian || (mnMajorVersion == 1 && mnMinorVersion == 0));
+    const unsigned int nCount = (unsigned int)response.received;
+    int nNewest = -1;
+    unsigned int nNewestFrame = 0;
+    unsigned int nDataFrames = 0;
+
+    for (unsigned int i = 0; i < nCount; i++)
+    {
+        char* pData = mUdpBatchPtrs[i];
+        if (mUdpBatchSizes[i] < qtmPacketHeaderSize || CRTPacket::GetSize(pData, bBigEndian) != (unsigned int)mUdpBatchSizes[i])
+        {
+            continue;
+        }
+        if (CRTPacket::GetType(pData, bBigEndian) != CRTPacket::PacketData)
+        {
+            if (nNewest < 0)
+            {
+                nNewest = i;
+            }
+            continue;
+        }
+        nDataFrames++;
+        const unsigned int nFrame = CRTPacket::GetFrameNumber(pData, bBigEndian);
+        // A frame number that jumps back by more than the batch is a restart (looping RT playback), not a reorder.
+        if (nNewest < 0 || nDataFrames == 1 || nFrame > nNewestFrame || nNewestFrame - nFrame > nCount)
+        {
+            nNewest = i;
+            nNewestFrame = nFrame;
+        }
+    }
+
+    if (nNewest < 0)
+    {
+        strcpy(maErrorStr, "Packet truncated.");
+        return CNetwork::ResponseType::error;
+    }
+    if (nDataFrames > 1)
+    {
+        mnDiscardedFrames += nDataFrames - 1;
+    }
+
+    mpoRTPacket = mPacketRing.Commit(mUdpBatchSlots[nNewest], mUdpBatchTimes[nNewest]);
+    eType = mpoRTPacket->GetType();
+
+    return CNetwork::ResponseType::success;
+} // ReceiveLatest
+
+
+unsigned long long CRTProtocol::GetDiscardedFrameCount() const
+{
+    return mnDiscardedFrames;
+}
+
+
+void CRTProtocol::Interrupt()
+{
+    mpoNetwork->Wake();
+}
+
+
 CRTPacket* CRTProtocol::GetRTPacket()
 {
     return mpoRTPacket;
 }
 
 
+long long CRTProtocol::GetRTPacketArrivalTime() const
+{
+    return mPacketRing.GetCurrentArrivalTime();
+}
+
+
+void CRTProtocol::SetConsumedComponents(unsigned int nComponentMask)
+{
+    mPacketRing.SetConsumedComponents(nComponentMask);
+}
+
+
+unsigned int CRTProtocol::GetCameraSettingsChangeCount() const
+{
+    return mnCameraSettingsChanges;
+}
+
+
+CRTPacketHandle CRTProtocol::HoldRTPacket()
+{
+    if (mpoRTPacket == nullptr)
+    {
+        return CRTPacketHandle();
+    }
+    return mPacketRing.Hold();
+}
+
+
 bool CRTProtocol::ReadXmlBool(CMarkup* xml, const std::string& element, bool& value) const
 {
     if (!xml->FindChildElem(element.c_str()))
@@ -1649,15 +2012,17 @@ bool CRTProtocol::ReadXmlBool(CMarkup* xml, const std::string& element, bool& va
 }
 
 
-bool CRTProtocol::ReadSettings(std::string settingsType, CMarkup &oXML)
+// Asks QTM for the settings and waits for the XML packet, which is the current packet on success.
+bool CRTProtocol::RequestSettings(const char* pSettingsType)
 {
     CRTPacket::EPacketType eType;
+    char                   pCmd[64];
 
     mvsAnalogDeviceSettings.clear();
-    auto sendStr = std::string("GetParameters ") + settingsType;
-    if (!SendCommand(sendStr.c_str()))
+    snprintf(pCmd, sizeof(pCmd), "GetParameters %s", pSettingsType);
+    if (!SendCommand(pCmd))
     {
-        sprintf(maErrorStr, "GetParameters %s failed", settingsType.c_str());
+        sprintf(maErrorStr, "GetParameters %s failed", pSettingsType);
         return false;
     }
 
@@ -1684,16 +2049,41 @@ retry:
         else
         {
             goto retry;
-            //sprintf(maErrorStr, "GetParameters %s returned wrong packet type. Got type %d expected type 2.", settingsType.c_str(), eType);
+            //sprintf(maErrorStr, "GetParameters %s returned wrong packet type. Got type %d expected type 2.", pSettingsType, eType);
         }
     }
+    return true;
+}
+
 
+bool CRTProtocol::ReadSettings(std::string settingsType, CMarkup &oXML)
+{
+    if (!RequestSettings(settingsType.c_str()))
+    {
+        return false;
+    }
     oXML.SetDoc(mpoRTPacket->GetXMLString());
     
     return true;
 }
 
 
+// Reads the XML in place, it stays valid until the next packet is received.
+bool CRTProtocol::ReadSettings(const char* pSettingsType, CXmlReader &oXML)
+{
+    if (!RequestSettings(pSettingsType))
+    {
+        return false;
+    }
+    if (!oXML.SetDoc(mpoRTPacket->GetXMLString(), mpoRTPacket->GetSize() - 8))
+    {
+        sprintf(maErrorStr, "GetParameters %s returned malformed XML.", pSettingsType);
+        return false;
+    }
+    return true;
+}
+
+
 bool CRTProtocol::ReadCameraSystemSettings()
 {
     return ReadGeneralSettings();
@@ -3056,19 +3446,24 @@ bool CRTProtocol::ReceiveCalibrationSettings(int timeout)
 
 bool CRTProtocol::Read3DSettings(bool &bDataAvailable)
 {
-    CMarkup     oXML;
-    std::string tStr;
-
     bDataAvailable = false;
 
-    ms3DSettings.s3DLabels.clear();
-    ms3DSettings.pCalibrationTime[0] = 0;
-
-    if (!ReadSettings("3D", oXML))
+    const bool bResult = ReadSettings("3D", moXmlReader) && Parse3DSettings(moXmlReader, bDataAvailable);
+    if (!bDataAvailable)
     {
-        return false;
+        ms3DSettings.s3DLabels.clear();
+        ms3DSettings.sBones.clear();
+        ms3DSettings.pCalibrationTime[0] = 0;
+        m3DLabelIndex.clear();
     }
+    return bResult;
+} // Read3DSettings
 
+// Fills ms3DSettings in place, so re-reading the same settings doesn't allocate:
+// the label and bone strings keep their capacity, and the label index is only
+// rebuilt when the names changed.
+bool CRTProtocol::Parse3DSettings(CXmlReader &oXML, bool &bDataAvailable)
+{
     if (!oXML.FindChildElem("The_3D"))
     {
         // No 3D data available.
@@ -3080,29 +3475,29 @@ bool CRTProtocol::Read3DSettings(bool &bDataAvailable)
     {
         return false;
     }
-    tStr = ToLower(oXML.GetChildData());
+    const CXmlSpan axis = oXML.GetChildData();
 
-    if (tStr == "+x")
+    if (axis.EqualsNoCase("+x"))
     {
         ms3DSettings.eAxisUpwards = XPos;
     }
-    else if (tStr == "-x")
+    else if (axis.EqualsNoCase("-x"))
     {
         ms3DSettings.eAxisUpwards = XNeg;
     }
-    else if (tStr == "+y")
+    else if (axis.EqualsNoCase("+y"))
     {
         ms3DSettings.eAxisUpwards = YPos;
     }
-    else if (tStr == "-y")
+    else if (axis.EqualsNoCase("-y"))
     {
         ms3DSettings.eAxisUpwards = YNeg;
     }
-    else if (tStr == "+z")
+    else if (axis.EqualsNoCase("+z"))
     {
         ms3DSettings.eAxisUpwards = ZPos;
     }
-    else if (tStr == "-z")
+    else if (axis.EqualsNoCase("-z"))
     {
         ms3DSettings.eAxisUpwards = ZNeg;
     }
@@ -3115,35 +3510,47 @@ bool CRTProtocol::Read3DSettings(bool &bDataAvailable)
     {
         return false;
     }
-    tStr = oXML.GetChildData();
-    strcpy(ms3DSettings.pCalibrationTime, tStr.c_str());
+    oXML.GetChildData().CopyTo(ms3DSettings.pCalibrationTime, sizeof(ms3DSettings.pCalibrationTime));
 
     if (!oXML.FindChildElem("Labels"))
     {
         return false;
     }
-    unsigned int nNumberOfLabels = atoi(oXML.GetChildData().c_str());
+    unsigned int nNumberOfLabels = oXML.GetChildData().ToInt();
 
+    bool bNamesChanged = nNumberOfLabels != ms3DSettings.s3DLabels.size() || m3DLabelIndex.empty();
     ms3DSettings.s3DLabels.resize(nNumberOfLabels);
-    SSettings3DLabel sLabel;
 
     for (unsigned int iLabel = 0; iLabel < nNumberOfLabels; iLabel++)
     {
         if (oXML.FindChildElem("Label"))
         {
+            SSettings3DLabel& sLabel = ms3DSettings.s3DLabels[iLabel];
             oXML.IntoElem();
             if (oXML.FindChildElem("Name"))
             {
-                sLabel.oName = oXML.GetChildData();
-                if (oXML.FindChildElem("RGBColor"))
+                const CXmlSpan name = oXML.GetChildData();
+                if (!name.Equals(sLabel.oName))
                 {
-                    sLabel.nRGBColor = atoi(oXML.GetChildData().c_str());
+                    name.AssignTo(sLabel.oName);
+                    bNamesChanged = true;
                 }
+                sLabel.nRGBColor = oXML.FindChildElem("RGBColor") ? oXML.GetChildData().ToInt() : 0;
                 if (oXML.FindChildElem("Trajectory_Type"))
                 {
-                    sLabel.type = oXML.GetChildData();
+                    oXML.GetChildData().AssignTo(sLabel.type);
                 }
-                ms3DSettings.s3DLabels[iLabel] = sLabel;
+                else
+                {
+                    sLabel.type.clear();
+                }
+            }
+            else
+            {
+                bNamesChanged = bNamesChanged || !sLabel.oName.empty();
+                sLabel.oName.clear();
+                sLabel.nRGBColor = 0;
+                sLabel.type.clear();
             }
             oXML.OutOfElem();
         }
@@ -3153,31 +3560,44 @@ bool CRTProtocol::Read3DSettings(bool &bDataAvailable)
         }
     }
 
-    ms3DSettings.sBones.clear();
+    if (bNamesChanged)
+    {
+        // The first marker wins if a name is used twice.
+        m3DLabelIndex.clear();
+        m3DLabelIndex.reserve(nNumberOfLabels);
+        for (unsigned int iLabel = 0; iLabel < nNumberOfLabels; iLabel++)
+        {
+            if (!ms3DSettings.s3DLabels[iLabel].oName.empty())
+            {
+                m3DLabelIndex.emplace(ms3DSettings.s3DLabels[iLabel].oName, iLabel);
+            }
+        }
+    }
+
+    size_t nBones = 0;
     if (oXML.FindChildElem("Bones"))
     {
         oXML.IntoElem();
         while (oXML.FindChildElem("Bone"))
         {
-            oXML.IntoElem();
-            SSettingsBone bone = { };
-            bone.fromName = oXML.GetAttrib("From").c_str();
-            bone.toName = oXML.GetAttrib("To").c_str();
-
-            auto colorString = oXML.GetAttrib("Color");
-            if (!colorString.empty())
+            if (nBones == ms3DSettings.sBones.size())
             {
-                bone.color = atoi(colorString.c_str());
+                ms3DSettings.sBones.emplace_back();
             }
-            ms3DSettings.sBones.push_back(bone);
-            oXML.OutOfElem();
+            SSettingsBone& bone = ms3DSettings.sBones[nBones++];
+            oXML.GetChildAttrib("From").AssignTo(bone.fromName);
+            oXML.GetChildAttrib("To").AssignTo(bone.toName);
+
+            const CXmlSpan color = oXML.GetChildAttrib("Color");
+            bone.color = color.Empty() ? 0 : color.ToInt();
         }
         oXML.OutOfElem();
     }
-    
+    ms3DSettings.sBones.resize(nBones);
+
     bDataAvailable = true;
     return true;
-} // Read3DSettings
+}
 
 bool CRTProtocol::Read6DOFSettings(bool &bDataAvailable)
 {
@@ -4741,6 +5161,17 @@ const char* CRTProtocol::Get3DLabelName(unsigned int nMarkerIndex) const
     return nullptr;
 }
 
+bool CRTProtocol::Get3DLabelIndex(const std::string& name, unsigned int &nMarkerIndex) const
+{
+    auto label = m3DLabelIndex.find(name);
+    if (label == m3DLabelIndex.end())
+    {
+        return false;
+    }
+    nMarkerIndex = label->second;
+    return true;
+}
+
 unsigned int CRTProtocol::Get3DLabelColor(unsigned int nMarkerIndex) const
 {
     if (nMarkerIndex < ms3DSettings.s3DLabels.size())
@@ -5187,8 +5618,9 @@ bool CRTProtocol::SetGeneralSettings(
     const bool* pbStartOnExtTrig, const bool* startOnTrigNO, const bool* startOnTrigNC, const bool* startOnTrigSoftware,
     const EProcessingActions* peProcessingActions, const EProcessingActions* peRtProcessingActions, const EProcessingActions* peReprocessingActions)
 {
-    CMarkup oXML;
+    CXmlWriter& oXML = moXmlWriter;
 
+    oXML.Clear();
     oXML.AddElem("QTM_Settings");
     oXML.IntoElem();
     oXML.AddElem("General");
@@ -5263,7 +5695,7 @@ bool CRTProtocol::SetGeneralSettings(
     oXML.OutOfElem(); // General
     oXML.OutOfElem(); // QTM_Settings
 
-    if (SendXML(oXML.GetDoc().c_str()))
+    if (SendXML(oXML.GetDoc()))
     {
         return true;
     }
@@ -5836,8 +6268,9 @@ bool CRTProtocol::Set6DOFBodySettings(std::vector<SSettings6DOFBody> settings)
         return false;
     }
 
-    CMarkup oXML;
+    CXmlWriter& oXML = moXmlWriter;
 
+    oXML.Clear();
     oXML.AddElem("QTM_Settings");
     oXML.IntoElem();
     oXML.AddElem("The_6D");
@@ -5849,12 +6282,12 @@ bool CRTProtocol::Set6DOFBodySettings(std::vector<SSettings6DOFBody> settings)
         oXML.IntoElem();
         oXML.AddElem("Name", body.name.c_str());
         oXML.AddElem("Color");
-        oXML.AddAttrib("R", std::to_string(body.color & 0xff).c_str());
-        oXML.AddAttrib("G", std::to_string((body.color >> 8) & 0xff).c_str());
-        oXML.AddAttrib("B", std::to_string((body.color >> 16) & 0xff).c_str());
-        oXML.AddElem("MaximumResidual", std::to_string(body.maxResidual).c_str());
-        oXML.AddElem("MinimumMarkersInBody", std::to_string(body.minMarkersInBody).c_str());
-        oXML.AddElem("BoneLengthTolerance", std::to_string(body.boneLengthTolerance).c_str());
+        oXML.AddAttrib("R", body.color & 0xff);
+        oXML.AddAttrib("G", (body.color >> 8) & 0xff);
+        oXML.AddAttrib("B", (body.color >> 16) & 0xff);
+        oXML.AddElem("MaximumResidual", body.maxResidual);
+        oXML.AddElem("MinimumMarkersInBody", body.minMarkersInBody);
+        oXML.AddElem("BoneLengthTolerance", body.boneLengthTolerance);
         oXML.AddElem("Filter");
         oXML.AddAttrib("Preset", body.filterPreset.c_str());
 
@@ -5864,15 +6297,15 @@ bool CRTProtocol::Set6DOFBodySettings(std::vector<SSettings6DOFBody> settings)
             oXML.IntoElem();
             oXML.AddElem("Name", body.mesh.name.c_str());
             oXML.AddElem("Position");
-            oXML.AddAttrib("X", std::to_string(body.mesh.position.fX).c_str());
-            oXML.AddAttrib("Y", std::to_string(body.mesh.position.fY).c_str());
-            oXML.AddAttrib("Z", std::to_string(body.mesh.position.fZ).c_str());
+            oXML.AddAttrib("X", body.mesh.position.fX);
+            oXML.AddAttrib("Y", body.mesh.position.fY);
+            oXML.AddAttrib("Z", body.mesh.position.fZ);
             oXML.AddElem("Rotation");
-            oXML.AddAttrib("X", std::to_string(body.mesh.rotation.fX).c_str());
-            oXML.AddAttrib("Y", std::to_string(body.mesh.rotation.fY).c_str());
-            oXML.AddAttrib("Z", std::to_string(body.mesh.rotation.fZ).c_str());
-            oXML.AddElem("Scale", std::to_string(body.mesh.scale).c_str());
-            oXML.AddElem("Opacity", std::to_string(body.mesh.opacity).c_str());
+            oXML.AddAttrib("X", body.mesh.rotation.fX);
+            oXML.AddAttrib("Y", body.mesh.rotation.fY);
+            oXML.AddAttrib("Z", body.mesh.rotation.fZ);
+            oXML.AddElem("Scale", body.mesh.scale);
+            oXML.AddElem("Opacity", body.mesh.opacity);
             oXML.OutOfElem(); // Mesh
         }
 
@@ -5883,35 +6316,35 @@ bool CRTProtocol::Set6DOFBodySettings(std::vector<SSettings6DOFBody> settings)
             for (auto &point : body.points)
             {
                 oXML.AddElem("Point");
-                oXML.AddAttrib("X", std::to_string(point.fX).c_str());
-                oXML.AddAttrib("Y", std::to_string(point.fY).c_str());
-                oXML.AddAttrib("Z", std::to_string(point.fZ).c_str());
+                oXML.AddAttrib("X", point.fX);
+                oXML.AddAttrib("Y", point.fY);
+                oXML.AddAttrib("Z", point.fZ);
                 oXML.AddAttrib("Virtual", point.virtual_ ? "1" : "0");
-                oXML.AddAttrib("PhysicalId", std::to_string(point.physicalId).c_str());
+                oXML.AddAttrib("PhysicalId", point.physicalId);
                 oXML.AddAttrib("Name", point.name.c_str());
             }
             oXML.OutOfElem(); // Points
         }
-        oXML.AddElem("Data_origin", std::to_string(body.origin.type).c_str());
-        oXML.AddAttrib("X", std::to_string(body.origin.position.fX).c_str());
-        oXML.AddAttrib("Y", std::to_string(body.origin.position.fY).c_str());
-        oXML.AddAttrib("Z", std::to_string(body.origin.position.fZ).c_str());
-        oXML.AddAttrib("Relative_body", std::to_string(body.origin.relativeBody).c_str());
-        oXML.AddElem("Data_orientation", std::to_string(body.origin.type).c_str());
+        oXML.AddElem("Data_origin", (int)body.origin.type);
+        oXML.AddAttrib("X", body.origin.position.fX);
+        oXML.AddAttrib("Y", body.origin.position.fY);
+        oXML.AddAttrib("Z", body.origin.position.fZ);
+        oXML.AddAttrib("Relative_body", body.origin.relativeBody);
+        oXML.AddElem("Data_orientation", (int)body.origin.type);
         for (uint32_t i = 0; i < 9; i++)
         {
             char tmpStr[16];
             sprintf(tmpStr, "R%u%u", (i / 3) + 1, (i % 3) + 1);
-            oXML.AddAttrib(tmpStr, std::to_string(body.origin.rotation[i]).c_str());
+            oXML.AddAttrib(tmpStr, body.origin.rotation[i]);
         }
-        oXML.AddAttrib("Relative_body", std::to_string(body.origin.relativeBody).c_str());
+        oXML.AddAttrib("Relative_body", body.origin.relativeBody);
 
         oXML.OutOfElem(); // Body
     }
     oXML.OutOfElem(); // The_6D
     oXML.OutOfElem(); // QTM_Settings
 
-    return SendXML(oXML.GetDoc().c_str());
+    return SendXML(oXML.GetDoc());
 }
 
 bool CRTProtocol::SetSkeletonSettings(const std::vector<SSettingsSkeletonHierarchical>& skeletons)
@@ -6243,6 +6676,35 @@ void CRTProtocol::AddXMLElementFloat(CMarkup* oXML, const char* tTag, const floa
     }
 }
 
+void CRTProtocol::AddXMLElementBool(CXmlWriter* oXML, const char* tTag, const bool* pbValue, const char* tTrue, const char* tFalse)
+{
+    if (pbValue)
+    {
+        oXML->AddElem(tTag, *pbValue ? tTrue : tFalse);
+    }
+}
+
+void CRTProtocol::AddXMLElementBool(CXmlWriter* oXML, const char* tTag, const bool bValue, const char* tTrue, const char* tFalse)
+{
+    oXML->AddElem(tTag, bValue ? tTrue : tFalse);
+}
+
+void CRTProtocol::AddXMLElementUnsignedInt(CXmlWriter* oXML, const char* tTag, const unsigned int* pnValue)
+{
+    if (pnValue)
+    {
+        oXML->AddElem(tTag, *pnValue);
+    }
+}
+
+void CRTProtocol::AddXMLElementFloat(CXmlWriter* oXML, const char* tTag, const float* pfValue, unsigned int pnDecimals)
+{
+    if (pfValue)
+    {
+        oXML->AddElem(tTag, *pfValue, pnDecimals);
+    }
+}
+
 void CRTProtocol::AddXMLElementTransform(CMarkup& xml, const std::string& name, const SPosition& position, const SRotation& rotation)
 {
     xml.AddElem(name.c_str());
@@ -3,10 +3,19 @@
 
 
 #include "RTPacket.h"
+#include "RTPacketRing.h"
 #include "Network.h"
+#include "XmlReader.h"
+#include "XmlWriter.h"
 #include <vector>
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <deque>
+#include <mutex>
+#include <future>
+#include <chrono>
+#include <functional>
 #include <limits>
 #include <cmath>
 
@@ -34,6 +43,9 @@ public:
     static const unsigned int cDefaultOscPort           = cDefaultBasePort + 3;
     static const unsigned int cDefaultAutoDiscoverPort  = cDefaultBasePort + 4;
 
+    static const unsigned int cUdpBatchSize              = 16;        // Datagrams drained per ReceiveLatest call
+    static const unsigned int cTcpStreamBufferSize       = 262144;    // TCP bytes read ahead by Receive
+
     static const unsigned int cWaitForDataTimeout        = 5000000;   // 5 s
     static const unsigned int cWaitForCalibrationTimeout = 600000000; // 10 min
 
@@ -664,6 +676,16 @@ public:
         std::vector<SSettingsSkeletonSegment> segments;
     };
 
+    struct SCommandResult
+    {
+        bool                                  bSuccess;
+        std::string                           response;     // Command response or error string
+        std::chrono::steady_clock::time_point issueTime;    // Local time the command was sent
+        std::chrono::steady_clock::time_point responseTime; // Local time the response was received
+    };
+
+    typedef std::function<void(const SCommandResult&)> TCommandCallback;
+
 public:
     CRTProtocol();
     ~CRTProtocol();
@@ -701,6 +723,16 @@ public:
     bool       StartCapture();
     bool       StartRTOnFile();
     bool       StopCapture();
+
+    // Send a command without waiting for the response. Responses come back in order and are matched to the
+    // oldest pending command by whichever thread calls Receive / ReceiveLatest next, so the callback runs on
+    // that thread. pExpectedResponse == nullptr accepts any command response.
+    std::future<SCommandResult> SendCommandAsync(const char* pCmdStr, const char* pExpectedResponse = nullptr, TCommandCallback callback = nullptr);
+    std::future<SCommandResult> SetQTMEventAsync(const char* pLabel, TCommandCallback callback = nullptr);
+    std::future<SCommandResult> StartCaptureAsync(TCommandCallback callback = nullptr);
+    std::future<SCommandResult> StopCaptureAsync(TCommandCallback callback = nullptr);
+    size_t     GetPendingCommandCount() const;
+
     bool       Calibrate(const bool refine, SCalibration &calibrationResult, int timeout = cWaitForCalibrationTimeout);
     bool       LoadCapture(const char* pFileName);
     bool       SaveCapture(const char* pFileName, bool bOverwrite, char* pNewFileName = nullptr, int nSizeOfNewFileName = 0);
@@ -717,9 +749,16 @@ public:
     [[deprecated("Replaced by Receive.")]]
     int         ReceiveRTPacket(CRTPacket::EPacketType &eType, bool bSkipEvents = true, int nTimeout = cWaitForDataTimeout); // nTimeout < 0 : Blocking receive
     CNetwork::ResponseType Receive(CRTPacket::EPacketType &eType, bool bSkipEvents = true, int nTimeout = cWaitForDataTimeout); // nTimeout < 0 : Blocking receive
-    
+    CNetwork::ResponseType ReceiveLatest(CRTPacket::EPacketType &eType, bool bSkipEvents = true, int nTimeout = cWaitForDataTimeout); // Newest UDP frame wins
+    unsigned long long GetDiscardedFrameCount() const;
+    void       Interrupt(); // Wake up a Receive / ReceiveLatest blocked in another thread.
+
 
     CRTPacket* GetRTPacket();
+    CRTPacketHandle HoldRTPacket(); // Keep the last received packet valid until the handle is released. Receiving thread only.
+    unsigned int GetCameraSettingsChangeCount() const; // EventCameraSettingsChanged received so far, settings read before the last one may be stale
+    long long  GetRTPacketArrivalTime() const; // When the last received packet reached this host, ns since the epoch (CLOCK_REALTIME)
+    void       SetConsumedComponents(unsigned int nComponentMask); // cComponent* read from received packets, 0 for all. See CRTPacket::SetConsumedComponents.
 
     bool ReadGeneralSettings();
     [[deprecated("Replaced by ReadGeneralSettings.")]]
@@ -806,6 +845,7 @@ public:
     const char*  Get3DCalibrated() const;
     unsigned int Get3DLabeledMarkerCount() const;
     const char*  Get3DLabelName(unsigned int nMarkerIndex) const;
+    bool         Get3DLabelIndex(const std::string& name, unsigned int &nMarkerIndex) const; // Hash lookup, no scan of the labels
     unsigned int Get3DLabelColor(unsigned int nMarkerIndex) const;
 
     const char*  Get3DTrajectoryType(unsigned int nMarkerIndex) const;
@@ -927,41 +967,75 @@ private:
     bool SendCommand(const char* pCmdStr);
     bool SendCommand(const char* pCmdStr, char* pCommandResponseStr, unsigned int timeout = cWaitForDataTimeout);
     bool SendXML(const char* pCmdStr);
+    bool DispatchCommandResponse(CRTPacket::EPacketType eType);
+    bool RequestSettings(const char* pSettingsType);
     bool ReadSettings(std::string settingsType, CMarkup &oXML);
+    bool ReadSettings(const char* pSettingsType, CXmlReader &oXML);
     void AddXMLElementBool(CMarkup* oXML, const char* tTag, const bool* pbValue, const char* tTrue = "True", const char* tFalse = "False");
     void AddXMLElementBool(CMarkup* oXML, const char* tTag, const bool bValue, const char* tTrue = "True", const char* tFalse = "False");
     void AddXMLElementInt(CMarkup* oXML, const char* tTag, const int* pnValue);
     void AddXMLElementUnsignedInt(CMarkup* oXML, const char* tTag, const unsigned int value);
     void AddXMLElementUnsignedInt(CMarkup* oXML, const char* tTag, const unsigned int* pnValue);
     void AddXMLElementFloat(CMarkup* oXML, const char* tTag, const float* pfValue, unsigned int pnDecimals = 6);
+    void AddXMLElementBool(CXmlWriter* oXML, const char* tTag, const bool* pbValue, const char* tTrue = "True", const char* tFalse = "False");
+    void AddXMLElementBool(CXmlWriter* oXML, const char* tTag, const bool bValue, const char* tTrue = "True", const char* tFalse = "False");
+    void AddXMLElementUnsignedInt(CXmlWriter* oXML, const char* tTag, const unsigned int* pnValue);
+    void AddXMLElementFloat(CXmlWriter* oXML, const char* tTag, const float* pfValue, unsigned int pnDecimals = 6);
     void AddXMLElementTransform(CMarkup& xml, const std::string& name, const SPosition& position, const SRotation& rotation);
     void AddXMLElementDOF(CMarkup& xml, const std::string& name, SDegreeOfFreedom degreeOfFreedom);
     bool CompareNoCase(std::string tStr1, const char* tStr2) const;
     bool ReceiveCalibrationSettings(int timeout = cWaitForDataTimeout);
     static std::string ToLower(std::string str);
+    bool TcpFrameBuffered() const;
+    void ConsumeTcpStream(unsigned int nSize);
     static bool ParseString(const std::string& str, uint32_t& value);
     static bool ParseString(const std::string& str, int32_t& value);
     static bool ParseString(const std::string& str, float& value);
     static bool ParseString(const std::string& str, double& value);
     static bool ParseString(const std::string& str, bool& value);
     bool ReadXmlBool(CMarkup* xml, const std::string& element, bool& value) const;
+    bool Parse3DSettings(CXmlReader& oXML, bool& bDataAvailable);
     SPosition ReadXMLPosition(CMarkup& xml, const std::string& element);
     SRotation ReadXMLRotation(CMarkup& xml, const std::string& element);
     bool ReadXMLDegreesOfFreedom(CMarkup& xml, const std::string& element, std::vector<SDegreeOfFreedom>& degreesOfFreedom);
 
 private:
     CNetwork*                      mpoNetwork;
-    CRTPacket*                     mpoRTPacket;
-    std::vector<char>              mDataBuff;
+    CRTPacketRing                  mPacketRing;
+    CRTPacket*                     mpoRTPacket; // Points into mPacketRing
+    std::vector<char>              mDataBuff;   // Discovery broadcasts only
+    std::vector<char>              mTcpStreamBuff;
+    unsigned int                   mnTcpStreamHead; // Start of the next unread frame
+    unsigned int                   mnTcpStreamTail; // End of the received bytes
+    long long                      mnTcpStreamTimeNs; // Arrival of the last bytes read into mTcpStreamBuff
+    std::vector<long long>         mUdpBatchTimes;
+    std::vector<int>               mUdpBatchSlots;
+    std::vector<char*>             mUdpBatchPtrs;
+    std::vector<int>               mUdpBatchSizes;
+    unsigned long long             mnDiscardedFrames;
     std::vector<char>              mSendBuffer;
+
+    struct SPendingCommand
+    {
+        std::string                           expected;
+        TCommandCallback                      callback;
+        std::promise<SCommandResult>          promise;
+        std::chrono::steady_clock::time_point issueTime;
+    };
+    void CompleteCommand(SPendingCommand& command, bool bSuccess, const char* pResponse);
+
+    std::deque<SPendingCommand>    mPendingCommands;
+    mutable std::mutex             mCommandMutex; // Guards mPendingCommands, held while sending so the queue matches the wire order
     CRTPacket::EEvent              meLastEvent;
     CRTPacket::EEvent              meState;  // Same as meLastEvent but without EventCameraSettingsChanged
+    unsigned int                   mnCameraSettingsChanges;
     int                            mnMinorVersion;
     int                            mnMajorVersion;
     bool                           mbBigEndian;
     bool                           mbIsMaster;
     SSettingsGeneral               msGeneralSettings;
     SSettings3D                    ms3DSettings;
+    std::unordered_map<std::string, unsigned int> m3DLabelIndex; // Label name -> marker index, rebuilt by Read3DSettings
     std::vector<SSettings6DOFBody> m6DOFSettings;
     std::vector<SGazeVector>       mvsGazeVectorSettings;
     std::vector<SEyeTracker>       mvsEyeTrackerSettings;
@@ -975,6 +1049,8 @@ private:
     unsigned short                 mnBroadcastPort;
     FILE*                          mpFileBuffer;
     std::vector<SDiscoverResponse> mvsDiscoverResponseList;
+    CXmlReader                     moXmlReader; // Kept so its index keeps its capacity between settings reads
+    CXmlWriter                     moXmlWriter; // Kept so its buffer keeps its capacity between settings writes
 };
 
 
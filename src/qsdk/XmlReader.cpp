@@ -0,0 +1,502 @@
+#include "XmlReader.h"
+
+#include <ctype.h>
+#include <string.h>
+
+namespace
+{
+    // The white space XML knows.
+    bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+    }
+
+    bool IsNameEnd(char c)
+    {
+        return IsSpace(c) || c == '/' || c == '>' || c == '=';
+    }
+
+    const char* SkipSpace(const char* p, const char* pEnd)
+    {
+        while (p < pEnd && IsSpace(*p))
+        {
+            p++;
+        }
+        return p;
+    }
+
+    bool StartsWith(const char* p, const char* pEnd, const char* pPrefix)
+    {
+        const size_t nSize = strlen(pPrefix);
+        return (size_t)(pEnd - p) >= nSize && memcmp(p, pPrefix, nSize) == 0;
+    }
+
+}
+
+//-----------------------------------------------------------
+//                         CXmlSpan
+//-----------------------------------------------------------
+
+bool CXmlSpan::Equals(const char* pStr) const
+{
+    return strlen(pStr) == mnSize && memcmp(mpData, pStr, mnSize) == 0;
+}
+
+bool CXmlSpan::EqualsNoCase(const char* pStr) const
+{
+    if (strlen(pStr) != mnSize)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < mnSize; i++)
+    {
+        if (tolower((unsigned char)mpData[i]) != tolower((unsigned char)pStr[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CXmlSpan::Equals(const std::string& str) const
+{
+    const char* p    = mpData;
+    const char* pEnd = mpData + mnSize;
+    size_t      nPos = 0;
+    char        aChar[4];
+    size_t      nChar;
+
+    while (p < pEnd)
+    {
+        p += Decode(p, pEnd, aChar, nChar);
+        if (nPos + nChar > str.size() || memcmp(str.data() + nPos, aChar, nChar) != 0)
+        {
+            return false;
+        }
+        nPos += nChar;
+    }
+    return nPos == str.size();
+}
+
+int CXmlSpan::ToInt() const
+{
+    const char* pEnd = mpData + mnSize;
+    const char* p    = SkipSpace(mpData, pEnd);
+    bool        bNegative = false;
+    int         nValue = 0;
+
+    if (p < pEnd && (*p == '-' || *p == '+'))
+    {
+        bNegative = *p == '-';
+        p++;
+    }
+    for (; p < pEnd && *p >= '0' && *p <= '9'; p++)
+    {
+        nValue = nValue * 10 + (*p - '0');
+    }
+    return bNegative ? -nValue : nValue;
+}
+
+void CXmlSpan::AssignTo(std::string& str) const
+{
+    const char* pEnd = mpData + mnSize;
+
+    if (memchr(mpData, '&', mnSize) == nullptr)
+    {
+        str.assign(mpData, mnSize);
+        return;
+    }
+    str.clear();
+    char   aChar[4];
+    size_t nChar;
+    for (const char* p = mpData; p < pEnd; )
+    {
+        p += Decode(p, pEnd, aChar, nChar);
+        str.append(aChar, nChar);
+    }
+}
+
+void CXmlSpan::CopyTo(char* pBuffer, size_t nBufferSize) const
+{
+    if (nBufferSize == 0)
+    {
+        return;
+    }
+    const size_t nCopy = mnSize < nBufferSize - 1 ? mnSize : nBufferSize - 1;
+    memcpy(pBuffer, mpData, nCopy);
+    pBuffer[nCopy] = 0;
+}
+
+// Decodes the character or entity at p into pOut. Returns the number of characters read.
+// Like CMarkup only the five predefined entities are decoded, anything else is taken as it is.
+size_t CXmlSpan::Decode(const char* p, const char* pEnd, char* pOut, size_t& nOut)
+{
+    nOut = 1;
+    pOut[0] = *p;
+    if (*p != '&')
+    {
+        return 1;
+    }
+    const char* pSemicolon = (const char*)memchr(p, ';', pEnd - p);
+    if (pSemicolon == nullptr)
+    {
+        return 1;
+    }
+    const CXmlSpan entity(p + 1, pSemicolon - p - 1);
+    const size_t   nRead = pSemicolon - p + 1;
+
+    if (entity.Equals("lt"))
+    {
+        pOut[0] = '<';
+    }
+    else if (entity.Equals("gt"))
+    {
+        pOut[0] = '>';
+    }
+    else if (entity.Equals("amp"))
+    {
+        pOut[0] = '&';
+    }
+    else if (entity.Equals("quot"))
+    {
+        pOut[0] = '"';
+    }
+    else if (entity.Equals("apos"))
+    {
+        pOut[0] = '\'';
+    }
+    else
+    {
+        return 1;
+    }
+    return nRead;
+}
+
+//-----------------------------------------------------------
+//                        CXmlReader
+//-----------------------------------------------------------
+
+CXmlReader::CXmlReader()
+{
+    SetDoc(nullptr, 0);
+}
+
+CXmlReader::CXmlReader(const char* pDoc, size_t nSize)
+{
+    SetDoc(pDoc, nSize);
+}
+
+bool CXmlReader::SetDoc(const char* pDoc, size_t nSize)
+{
+    mpDoc = pDoc;
+    mpEnd = pDoc == nullptr ? nullptr : pDoc + strnlen(pDoc, nSize);
+    ResetPos();
+
+    const bool bResult = Index();
+    if (!bResult)
+    {
+        maElems.resize(1);
+        maElems[0].nFirstChild = 0;
+    }
+    return bResult;
+}
+
+// One pass over the document, the end tag of an element has to match its start tag.
+bool CXmlReader::Index()
+{
+    maElems.clear();
+    maOpen.clear();
+    maLastChild.clear();
+
+    const SElem doc = { mpDoc, mpDoc, mpEnd, 0, 0, 0, 0 };
+    maElems.push_back(doc);
+    maOpen.push_back(0);
+    maLastChild.push_back(0);
+
+    const char* p = mpDoc;
+    while (p != nullptr && p < mpEnd)
+    {
+        p = (const char*)memchr(p, '<', mpEnd - p);
+        if (p == nullptr)
+        {
+            break;
+        }
+        if (p + 1 >= mpEnd)
+        {
+            return false;
+        }
+
+        if (p[1] == '/')
+        {
+            const unsigned int nElem = maOpen.back();
+            if (nElem == 0)
+            {
+                return false;
+            }
+            const unsigned int nNameSize = maElems[nElem].nNameSize;
+            const char*        pNameEnd  = p + 2 + nNameSize;
+            if (pNameEnd >= mpEnd || memcmp(maElems[nElem].pStart + 1, p + 2, nNameSize) != 0 || !IsNameEnd(*pNameEnd))
+            {
+                return false;
+            }
+            maElems[nElem].pEnd = p;
+            maOpen.pop_back();
+            maLastChild.pop_back();
+            p = *pNameEnd == '>' ? pNameEnd + 1 : Skip(pNameEnd, ">");
+        }
+        else if (p[1] == '?')
+        {
+            p = Skip(p, "?>");
+        }
+        else if (StartsWith(p, mpEnd, "<!--"))
+        {
+            p = Skip(p + 4, "-->");
+        }
+        else if (StartsWith(p, mpEnd, "<![CDATA["))
+        {
+            p = Skip(p, "]]>");
+        }
+        else if (p[1] == '!')
+        {
+            p = Skip(p, ">");
+        }
+        else
+        {
+            const unsigned int nElem = AddElem(p, maOpen.back());
+            bool               bEmpty;
+            const char*        pTagEnd = TagEnd(p + 1 + maElems[nElem].nNameSize, bEmpty);
+            if (pTagEnd == nullptr)
+            {
+                return false;
+            }
+            if (!bEmpty)
+            {
+                maElems[nElem].pContent = pTagEnd + 1;
+                maOpen.push_back(nElem);
+                maLastChild.push_back(0);
+            }
+            p = pTagEnd + 1;
+        }
+        if (p == nullptr)
+        {
+            return false;
+        }
+    }
+    return maOpen.size() == 1;
+}
+
+// Links a new element in after the last child of nParent.
+unsigned int CXmlReader::AddElem(const char* pStart, unsigned int nParent)
+{
+    const char* p = pStart + 1;
+    while (p < mpEnd && !IsNameEnd(*p))
+    {
+        p++;
+    }
+    const unsigned int nElem = (unsigned int)maElems.size();
+    const SElem        elem = { pStart, nullptr, nullptr, (unsigned int)(p - pStart - 1), nParent, 0, 0 };
+    maElems.push_back(elem);
+
+    unsigned int& nLastChild = maLastChild.back();
+    if (nLastChild == 0)
+    {
+        maElems[nParent].nFirstChild = nElem;
+    }
+    else
+    {
+        maElems[nLastChild].nNext = nElem;
+    }
+    nLastChild = nElem;
+    return nElem;
+}
+
+bool CXmlReader::FindElem(const char* pName)
+{
+    const unsigned int nFrom  = mnMain != 0 ? maElems[mnMain].nNext : maElems[mnParent].nFirstChild;
+    const unsigned int nFound = FindElemFrom(nFrom, pName);
+    if (nFound == 0)
+    {
+        return false;
+    }
+    mnMain  = nFound;
+    mnChild = 0;
+    return true;
+}
+
+bool CXmlReader::FindChildElem(const char* pName)
+{
+    // Like CMarkup, the first element at this level becomes the main position.
+    if (mnMain == 0 && !FindElem())
+    {
+        return false;
+    }
+
+    const unsigned int nFrom  = mnChild != 0 ? maElems[mnChild].nNext : maElems[mnMain].nFirstChild;
+    const unsigned int nFound = FindElemFrom(nFrom, pName);
+    if (nFound == 0)
+    {
+        return false;
+    }
+    mnChild = nFound;
+    return true;
+}
+
+// Like CMarkup the child position becomes the main position, which may be none.
+bool CXmlReader::IntoElem()
+{
+    if (mnMain == 0)
+    {
+        return false;
+    }
+    mnParent = mnMain;
+    mnMain   = mnChild;
+    mnChild  = 0;
+    return true;
+}
+
+bool CXmlReader::OutOfElem()
+{
+    if (mnParent == 0)
+    {
+        return false;
+    }
+    mnChild  = mnMain;
+    mnMain   = mnParent;
+    mnParent = maElems[mnParent].nParent;
+    return true;
+}
+
+// The first element from nElem on with the name, any if pName is null.
+unsigned int CXmlReader::FindElemFrom(unsigned int nElem, const char* pName) const
+{
+    if (pName == nullptr || pName[0] == 0)
+    {
+        return nElem;
+    }
+    const size_t nNameSize = strlen(pName);
+    for (; nElem != 0; nElem = maElems[nElem].nNext)
+    {
+        const SElem& elem = maElems[nElem];
+        if (elem.nNameSize == nNameSize && memcmp(elem.pStart + 1, pName, nNameSize) == 0)
+        {
+            return nElem;
+        }
+    }
+    return 0;
+}
+
+// The '>' closing the start tag, from just past the tag name on. Attribute values may contain one.
+const char* CXmlReader::TagEnd(const char* pAfterName, bool& bEmpty) const
+{
+    char cQuote = 0;
+    bEmpty = false;
+    for (const char* p = pAfterName; p < mpEnd; p++)
+    {
+        if (cQuote != 0)
+        {
+            if (*p == cQuote)
+            {
+                cQuote = 0;
+            }
+        }
+        else if (*p == '"' || *p == '\'')
+        {
+            cQuote = *p;
+        }
+        else if (*p == '>')
+        {
+            bEmpty = p[-1] == '/';
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+// Just past the next pTerminator from p, null if there is none.
+const char* CXmlReader::Skip(const char* p, const char* pTerminator) const
+{
+    const size_t nSize = strlen(pTerminator);
+    for (; p != nullptr && p + nSize <= mpEnd; p++)
+    {
+        p = (const char*)memchr(p, pTerminator[0], mpEnd - p);
+        if (p == nullptr || p + nSize > mpEnd)
+        {
+            return nullptr;
+        }
+        if (memcmp(p, pTerminator, nSize) == 0)
+        {
+            return p + nSize;
+        }
+    }
+    return nullptr;
+}
+
+CXmlSpan CXmlReader::TagName(unsigned int nElem) const
+{
+    if (nElem == 0)
+    {
+        return CXmlSpan();
+    }
+    return CXmlSpan(maElems[nElem].pStart + 1, maElems[nElem].nNameSize);
+}
+
+// The text of an element without child elements, like CMarkup::GetData.
+CXmlSpan CXmlReader::Data(unsigned int nElem) const
+{
+    if (nElem == 0 || maElems[nElem].pContent == nullptr || maElems[nElem].nFirstChild != 0)
+    {
+        return CXmlSpan();
+    }
+    const SElem& elem = maElems[nElem];
+    const char*  p    = (const char*)memchr(elem.pContent, '<', elem.pEnd - elem.pContent + 1);
+    if (p != elem.pEnd)
+    {
+        return CXmlSpan();
+    }
+    return CXmlSpan(elem.pContent, elem.pEnd - elem.pContent);
+}
+
+CXmlSpan CXmlReader::Attrib(unsigned int nElem, const char* pName) const
+{
+    if (nElem == 0)
+    {
+        return CXmlSpan();
+    }
+    const char* p = maElems[nElem].pStart + 1 + maElems[nElem].nNameSize;
+
+    while (true)
+    {
+        p = SkipSpace(p, mpEnd);
+        if (p >= mpEnd || *p == '>' || *p == '/')
+        {
+            return CXmlSpan();
+        }
+        const char* pAttribName = p;
+        while (p < mpEnd && !IsNameEnd(*p))
+        {
+            p++;
+        }
+        const CXmlSpan attribName(pAttribName, p - pAttribName);
+        p = SkipSpace(p, mpEnd);
+        if (p >= mpEnd || *p != '=')
+        {
+            return CXmlSpan();
+        }
+        p = SkipSpace(p + 1, mpEnd);
+        if (p >= mpEnd || (*p != '"' && *p != '\''))
+        {
+            return CXmlSpan();
+        }
+        const char* pValue = p + 1;
+        const char* pQuote = (const char*)memchr(pValue, *p, mpEnd - pValue);
+        if (pQuote == nullptr)
+        {
+            return CXmlSpan();
+        }
+        if (attribName.Equals(pName))
+        {
+            return CXmlSpan(pValue, pQuote - pValue);
+        }
+        p = pQuote + 1;
+    }
+}
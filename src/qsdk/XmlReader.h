@@ -0,0 +1,98 @@
+#ifndef XMLREADER_H
+#define XMLREADER_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// A piece of an XML document, pointing into the document buffer and not null
+// terminated. Entities are left as they are until the text is compared or copied out.
+class CXmlSpan
+{
+public:
+    CXmlSpan() : mpData(nullptr), mnSize(0) {}
+    CXmlSpan(const char* pData, size_t nSize) : mpData(pData), mnSize(nSize) {}
+
+    const char*  Data() const { return mpData; }
+    size_t       Size() const { return mnSize; }
+    bool         Empty() const { return mnSize == 0; }
+    bool         Equals(const char* pStr) const;
+    bool         EqualsNoCase(const char* pStr) const;
+    bool         Equals(const std::string& str) const; // Compares the decoded text
+    int          ToInt() const;                        // Like atoi, leading digits only
+    void         AssignTo(std::string& str) const;     // Decodes entities, reuses the capacity of str
+    void         CopyTo(char* pBuffer, size_t nBufferSize) const; // Raw text, truncated and null terminated
+
+private:
+    static size_t Decode(const char* p, const char* pEnd, char* pOut, size_t& nOut);
+
+    const char* mpData;
+    size_t      mnSize;
+};
+
+// Non validating XML reader that works in place on a document buffer (e.g. the
+// payload of an XML packet). SetDoc tokenizes the document once into an index
+// of elements linked to their parent, first child and next sibling, so finding
+// the next element only follows links and compares names. The index keeps its
+// capacity between documents, re-reading settings of the same size doesn't
+// allocate. Navigation follows CMarkup: a main position at the current level
+// and a child position inside the main element, FindChildElem searches on from
+// the current child.
+// Comments, processing instructions and CDATA sections are skipped.
+class CXmlReader
+{
+public:
+    CXmlReader();
+    CXmlReader(const char* pDoc, size_t nSize);
+
+    bool     SetDoc(const char* pDoc, size_t nSize); // The buffer must outlive the reader, stops at a null.
+                                                     // False and an empty document if it isn't well formed.
+    bool     FindElem(const char* pName = nullptr);
+    bool     FindChildElem(const char* pName = nullptr);
+    bool     IntoElem();
+    bool     OutOfElem();
+    void     ResetChildPos() { mnChild = 0; }
+    void     ResetPos() { mnParent = 0; mnMain = 0; mnChild = 0; }
+    size_t   GetElemCount() const { return maElems.size() - 1; }
+
+    CXmlSpan GetTagName() const { return TagName(mnMain); }
+    CXmlSpan GetChildTagName() const { return TagName(mnChild); }
+    CXmlSpan GetData() const { return Data(mnMain); }
+    CXmlSpan GetChildData() const { return Data(mnChild); }
+    CXmlSpan GetAttrib(const char* pName) const { return Attrib(mnMain, pName); }
+    CXmlSpan GetChildAttrib(const char* pName) const { return Attrib(mnChild, pName); }
+
+private:
+    // Element 0 is the document, its children are the top level elements.
+    // 0 as a link means there is none.
+    struct SElem
+    {
+        const char*  pStart;      // '<' of the start tag
+        const char*  pContent;    // Just past the start tag, null for an empty element
+        const char*  pEnd;        // '<' of the end tag, null for an empty element
+        unsigned int nNameSize;
+        unsigned int nParent;
+        unsigned int nFirstChild;
+        unsigned int nNext;
+    };
+
+    bool         Index();
+    unsigned int AddElem(const char* pStart, unsigned int nParent);
+    unsigned int FindElemFrom(unsigned int nElem, const char* pName) const;
+    const char*  TagEnd(const char* pAfterName, bool& bEmpty) const;
+    const char*  Skip(const char* p, const char* pTerminator) const;
+    CXmlSpan     TagName(unsigned int nElem) const;
+    CXmlSpan     Data(unsigned int nElem) const;
+    CXmlSpan     Attrib(unsigned int nElem, const char* pName) const;
+
+    const char*               mpDoc;
+    const char*               mpEnd;
+    std::vector<SElem>        maElems;
+    std::vector<unsigned int> maOpen;      // Elements whose end tag is still to come, while indexing
+    std::vector<unsigned int> maLastChild; // Their last child so far
+    unsigned int              mnParent;    // Element holding the main position, 0 at the top level
+    unsigned int              mnMain;      // 0 before the first FindElem
+    unsigned int              mnChild;     // 0 before the first FindChildElem
+};
+
+#endif // XMLREADER_H
@@ -0,0 +1,196 @@
+#include "XmlWriter.h"
+
+#include <stdio.h>
+#include <string.h>
+
+CXmlWriter::CXmlWriter(size_t nReserve)
+{
+    msDoc.reserve(nReserve);
+    msData.reserve(64);
+    Clear();
+}
+
+void CXmlWriter::Clear()
+{
+    msDoc.clear();
+    msData.clear();
+    meOpenTag = OpenTagNone;
+    mnDepth   = 0;
+}
+
+void CXmlWriter::AddElem(const char* pName, const char* pData)
+{
+    CloseTag();
+    AddIndent(mnDepth);
+    msDoc += '<';
+    mMain.nOffset = msDoc.size();
+    mMain.nSize   = strlen(pName);
+    msDoc.append(pName, mMain.nSize);
+    msData.assign(pData != nullptr ? pData : "");
+    meOpenTag = OpenTagMain;
+}
+
+void CXmlWriter::AddElem(const char* pName, int nValue)
+{
+    char pValue[16];
+    snprintf(pValue, sizeof(pValue), "%d", nValue);
+    AddElem(pName, pValue);
+}
+
+void CXmlWriter::AddElem(const char* pName, unsigned int nValue)
+{
+    char pValue[16];
+    snprintf(pValue, sizeof(pValue), "%u", nValue);
+    AddElem(pName, pValue);
+}
+
+void CXmlWriter::AddElem(const char* pName, float fValue, unsigned int nDecimals)
+{
+    char pValue[64];
+    snprintf(pValue, sizeof(pValue), "%.*f", (int)nDecimals, fValue);
+    AddElem(pName, pValue);
+}
+
+bool CXmlWriter::AddAttrib(const char* pName, const char* pValue)
+{
+    if (meOpenTag != OpenTagMain)
+    {
+        return false;
+    }
+    msDoc += ' ';
+    msDoc += pName;
+    msDoc += "=\"";
+    AddText(pValue, true);
+    msDoc += '"';
+    return true;
+}
+
+bool CXmlWriter::AddAttrib(const char* pName, int nValue)
+{
+    char pValue[16];
+    snprintf(pValue, sizeof(pValue), "%d", nValue);
+    return AddAttrib(pName, pValue);
+}
+
+bool CXmlWriter::AddAttrib(const char* pName, unsigned int nValue)
+{
+    char pValue[16];
+    snprintf(pValue, sizeof(pValue), "%u", nValue);
+    return AddAttrib(pName, pValue);
+}
+
+bool CXmlWriter::AddAttrib(const char* pName, float fValue)
+{
+    char pValue[64];
+    snprintf(pValue, sizeof(pValue), "%f", fValue);
+    return AddAttrib(pName, pValue);
+}
+
+bool CXmlWriter::IntoElem()
+{
+    if (meOpenTag != OpenTagMain || mnDepth == cMaxDepth)
+    {
+        return false;
+    }
+    maParents[mnDepth++] = mMain;
+    meOpenTag = OpenTagParent;
+    return true;
+}
+
+bool CXmlWriter::OutOfElem()
+{
+    if (mnDepth == 0)
+    {
+        return false;
+    }
+    if (meOpenTag == OpenTagParent)
+    {
+        // Nothing was added, like CMarkup it stays an empty element.
+        mnDepth--;
+        meOpenTag = OpenTagMain;
+        CloseTag();
+        return true;
+    }
+    CloseTag();
+    mMain = maParents[--mnDepth];
+    AddIndent(mnDepth);
+    msDoc += "</";
+    msDoc.append(msDoc, mMain.nOffset, mMain.nSize);
+    msDoc += ">\r\n";
+    return true;
+}
+
+const char* CXmlWriter::GetDoc()
+{
+    while (OutOfElem())
+    {
+    }
+    CloseTag();
+    return msDoc.c_str();
+}
+
+void CXmlWriter::CloseTag()
+{
+    if (meOpenTag == OpenTagMain)
+    {
+        if (msData.empty())
+        {
+            msDoc += "/>\r\n";
+        }
+        else
+        {
+            msDoc += '>';
+            AddText(msData.c_str(), false);
+            msDoc += "</";
+            msDoc.append(msDoc, mMain.nOffset, mMain.nSize);
+            msDoc += ">\r\n";
+        }
+    }
+    else if (meOpenTag == OpenTagParent)
+    {
+        msDoc += '>';
+        AddText(msData.c_str(), false);
+        msDoc += "\r\n";
+    }
+    msData.clear();
+    meOpenTag = OpenTagNone;
+}
+
+void CXmlWriter::AddIndent(unsigned int nDepth)
+{
+    msDoc.append(nDepth * 4, ' ');
+}
+
+// Escapes the characters CMarkup escapes, quotes only in attribute values.
+void CXmlWriter::AddText(const char* pText, bool bAttrib)
+{
+    const char* pSpecial = bAttrib ? "<&>'\"" : "<&>";
+
+    for (const char* p = pText; *p != 0; )
+    {
+        const size_t nPlain = strcspn(p, pSpecial);
+        msDoc.append(p, nPlain);
+        p += nPlain;
+        switch (*p)
+        {
+        case '<':
+            msDoc += "&lt;";
+            break;
+        case '&':
+            msDoc += "&amp;";
+            break;
+        case '>':
+            msDoc += "&gt;";
+            break;
+        case '\'':
+            msDoc += "&apos;";
+            break;
+        case '"':
+            msDoc += "&quot;";
+            break;
+        default:
+            return;
+        }
+        p++;
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef XMLWRITER_H
+#define XMLWRITER_H
+
+#include <stddef.h>
+#include <string>
+
+// Builds an XML document front to back into a buffer that keeps its capacity
+// between documents. The calls and the layout follow CMarkup (one element per
+// line, 4 spaces indent, CRLF line ends), but the main position is always the
+// element added last: attributes can be added to it until the next element is
+// added, and only it can be entered.
+// Numbers are written like std::to_string, without allocating.
+class CXmlWriter
+{
+public:
+    static const unsigned int cMaxDepth = 16;
+
+    explicit CXmlWriter(size_t nReserve = 4096);
+
+    void        Clear(); // Starts a new document, keeps the buffer
+    void        AddElem(const char* pName, const char* pData = nullptr);
+    void        AddElem(const char* pName, int nValue);
+    void        AddElem(const char* pName, unsigned int nValue);
+    void        AddElem(const char* pName, float fValue, unsigned int nDecimals = 6);
+    bool        AddAttrib(const char* pName, const char* pValue);
+    bool        AddAttrib(const char* pName, int nValue);
+    bool        AddAttrib(const char* pName, unsigned int nValue);
+    bool        AddAttrib(const char* pName, float fValue);
+    bool        IntoElem();
+    bool        OutOfElem();
+    const char* GetDoc(); // Closes the elements still open
+    size_t      GetSize() const { return msDoc.size(); }
+
+private:
+    enum EOpenTag
+    {
+        OpenTagNone,
+        OpenTagMain,  // The start tag of the main element
+        OpenTagParent // The start tag of an entered element without children yet
+    };
+
+    struct SName
+    {
+        size_t nOffset; // Into msDoc
+        size_t nSize;
+    };
+
+    void CloseTag();
+    void AddIndent(unsigned int nDepth);
+    void AddText(const char* pText, bool bAttrib);
+
+    std::string  msDoc;
+    std::string  msData;      // Data of the main element, written when its start tag is closed
+    EOpenTag     meOpenTag;
+    SName        mMain;
+    SName        maParents[cMaxDepth];
+    unsigned int mnDepth;
+};
+
+#endif // XMLWRITER_H
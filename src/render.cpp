@@ -1,5 +1,6 @@
 #define BELA_DISABLE_CPU_TIME
 #define BELA_DONT_INCLUDE_UTILITIES
+#include <algorithm>
 #include <iostream>
 #include <array>
 #include <iterator>
@@ -20,17 +21,27 @@
 
 #include "utils/qtm.h"
 #include "utils/sound.h"
+#include "utils/sinc_resampler.h"
+#include "utils/voice_pool.h"
+#include "utils/warp_reader.h"
 #include "utils/space.h"
-
-// #include "utils/latency_check.h" // include this file to do a latency check
+#include "utils/latency_monitor.h"
+#include "utils/motion_prediction.h"
 
 #include "utils/experiment.h"
 
+// the sample of tone and its playback frequency range
+const SampleBuffer *tone_buffer(Tone tone) {
+  return tone == OVERTONE ? &gOvertoneSampleData : &gUndertoneSampleData;
+}
+float tone_freq_min(Tone tone) { return tone == OVERTONE ? gOvertoneFreqMin : gUndertoneFreqMin; }
+float tone_freq_max(Tone tone) { return tone == OVERTONE ? gOvertoneFreqMax : gUndertoneFreqMax; }
+
 // bela setup task
 bool setup(BelaContext *context, void *userData) {
-  // create fill buffer function auxillary task
-  if ((gFillBufferTask =
-           Bela_createAuxiliaryTask(&fillBuffer, 90, "fill-buffer")) == 0)
+  // create the mocap receiver auxillary task, it runs for the whole session
+  if ((gMocapReceiverTask =
+           Bela_createAuxiliaryTask(&receiveMocap, 90, "mocap-receiver")) == 0)
     return false;
 
   if ((gRunExperimentTask =
@@ -76,46 +87,86 @@ bool setup(BelaContext *context, void *userData) {
   gBelaCapeButton.open(kBelaCapeButtonPin, Gpio::INPUT, false);
   printf("Done\n");
 
-#ifdef CHECK_CMD_LATENCY
-  checkLatency(rtProtocol);
-#endif
+  // optional background monitor of the streamed frame latency
+  setupLatencyMonitor();
+  if (gPredictToOutput) {
+    printf("Predicting positions to the audio output, %.1f ms + measured latency, at most %.0f ms ahead\n",
+           (gCaptureToArrivalSec + gOutputLatencySec) * 1e3f, gPredictionMaxSec * 1e3f);
+  }
 
   printf("\n");
   // these are (and should be) small enough to load into memory.
-  gUndertoneSampleData = AudioFileUtilities::loadMono(gUndertoneFile);
-  gOvertoneSampleData = AudioFileUtilities::loadMono(gOvertoneFile);
+  gUndertoneSampleData.load(AudioFileUtilities::loadMono(gUndertoneFile), context->audioFrames);
+  gOvertoneSampleData.load(AudioFileUtilities::loadMono(gOvertoneFile), context->audioFrames);
+  if (gUndertoneSampleData.empty() || gOvertoneSampleData.empty()) {
+    printf("Couldn't load %s and %s\n", gUndertoneFile.c_str(), gOvertoneFile.c_str());
+    return false;
+  }
+  if (gResampleTaps > 0 && !gSincResampler.setup(gResampleTaps)) {
+    printf("gResampleTaps has to be 8, 16, 32 or 0, not %u\n", gResampleTaps);
+    return false;
+  }
+  // a voice per subject and the shared one, mixed onto every output channel
+  if (!gVoices.setup(NUM_SUBJECTS + 1, context->audioOutChannels, context->audioFrames)) {
+    printf("Couldn't set up the voices for %u output channels\n", context->audioOutChannels);
+    return false;
+  }
+  for (unsigned int i = 0; i < NUM_SUBJECTS; i++) {
+    if (gSubjectOutChannels[i] < 0 || gSubjectOutChannels[i] >= (int)context->audioOutChannels) {
+      printf("Subject %u's output channel %d isn't one of the %u\n", i, gSubjectOutChannels[i], context->audioOutChannels);
+      return false;
+    }
+    gVoices.add(tone_buffer(gSubjectTones[i]));
+  }
+  gVoices.add(&gOvertoneSampleData);
 
+  Bela_scheduleAuxiliaryTask(gMocapReceiverTask);
   Bela_scheduleAuxiliaryTask(gRunExperimentTask);
   return true;
 }
 
-// bela main render loop function
-void render(BelaContext *context, void *userData) {
-  // check for button press
-  if (gWaitingForButtonPress) {
-    // read == false when button is pressed !?!
-  	if (!gBelaCapeButton.read()) {
-      gBelaButtonPressed = true;
-  	}
+// reads a block of buffer at the playback rates, with the configured resampler
+void read_sample_block(const SampleBuffer &buffer, WarpPhase &phase, const float *rates, float *out, unsigned int frames) {
+  if (gResampleTaps > 0) {
+    gSincResampler.read(buffer, phase, rates, out, frames);
+  } else {
+    warp_read_block(buffer, phase, rates, out, frames);
   }
-  // this is how many audio frames are rendered per loop
-  for (unsigned int n = 0; n < context->audioFrames; n++) {
-    gCurrentTrialDuration++;
-    // if silent mode is set or the current tone is the "pause" tone
-    if (gSilence) {
-      // if this is between trials, or in the no sonification condition
-      // just output silence.
-      audioWrite(context, n, 0, 0);
-      audioWrite(context, n, 1, 0);
-      continue;
-    } else if (startTonePlaying || endTonePlaying) {
-      // if we're playing a start or end tone, we need to play a sine tone instead of sonification
-      gOut = sin_freq(gCurrentTonePhase, gCurrentToneFreq, gCurrentToneInvSampleRate);
-      audioWrite(context, n, 0, gOut);
-      audioWrite(context, n, 1, gOut);
-      continue;
+}
+
+// which sample each voice plays and where, for the current condition
+void route_voices() {
+  const bool task = gCurrentConditionIdx == Condition::TASK_SONIFICATION;
+  for (unsigned int i = 0; i < NUM_SUBJECTS; i++) {
+    if (task) {
+      gVoices.setBuffer(i, tone_buffer(gSubjectTones[i]));
+      gVoices.route(i, VoicePool::kAllChannels);
+    } else {
+      gVoices.setBuffer(i, &gUndertoneSampleData);
+      if (gSyncUseTwoChannels) {
+        gVoices.route(i, gSubjectOutChannels[i]);
+      } else if (i == 0) {
+        gVoices.route(i, VoicePool::kAllChannels);
+      } else {
+        gVoices.mute(i);
+      }
     }
+  }
+  // the overtone stays at the center frequency, every channel hears the same one
+  if (task) {
+    gVoices.mute(gGroupVoice);
+  } else {
+    gVoices.route(gGroupVoice, VoicePool::kAllChannels);
+  }
+}
 
+// reads a block of every voice at its ramped playback rate, then writes the mix
+void render_sonification(BelaContext *context) {
+  const unsigned int frames = context->audioFrames;
+  route_voices();
+  gVoices.process(read_sample_block, frames);
+
+  for (unsigned int n = 0; n < frames; n++) {
     gAmpMod = amp_fade_linear(gAmpModPtr, gAmpModBaseRate, gAmpModNumSamplesIO, gAmpModDepth);
     if (gAmpMod > 0.0f) {
       ++gAmpModPtr;
@@ -123,38 +174,83 @@ void render(BelaContext *context, void *userData) {
         gAmpModPtr = 0;
       }
     }
-    
-    if (gCurrentConditionIdx == Condition::TASK_SONIFICATION) {
-      undertone_sr = pos_to_freq(gPos3D[1][0][gTrackAxis], gTrackStart, gTrackEnd, gUndertoneFreqMin, gUndertoneFreqMax);
-      overtone_sr = pos_to_freq(gPos3D[1][1][gTrackAxis], gTrackStart, gTrackEnd, gOvertoneFreqMin, gOvertoneFreqMax);
-      gOut = (
-        warp_read_sample(gUndertoneSampleData, gReadPtrUndertone, undertone_sr / gUndertoneFreqMin, gSampleLength) +
-        warp_read_sample(gOvertoneSampleData, gReadPtrOvertone, overtone_sr / gOvertoneFreqMin, gSampleLength)
-        ) * 0.5f * gAmpMod;
-      audioWrite(context, n, 0, gOut);
-      audioWrite(context, n, 1, gOut);
-    } else {
-      undertone_srs = sync_to_freq(gPos3D[1][0][gTrackAxis], gPos3D[1][1][gTrackAxis], gTrackStart, gTrackEnd, gUndertoneFreqMin, gUndertoneFreqMax);
-      overtone_amp = sync_to_amp(gPos3D[1][0][gTrackAxis], gPos3D[1][1][gTrackAxis], gTrackStart, gTrackEnd, 0.15f);
-
-      gOut = (
-        warp_read_sample(gUndertoneSampleData, gReadPtrUndertone, undertone_srs[0] / gUndertoneFreqMin, gSampleLength) +
-        warp_read_sample(gOvertoneSampleData, gReadPtrOvertone, gFreqCenter / gOvertoneFreqMin, gSampleLength, !gSyncUseTwoChannels) * overtone_amp
-      ) * 0.5f * gAmpMod;
+    for (unsigned int c = 0; c < gVoices.channels(); c++) {
+      gOut = gVoices.bus(c)[n] * gAmpMod;
+      audioWrite(context, n, c, gOut);
+    }
+  }
+}
 
-      audioWrite(context, n, 0, gOut);
+// bela main render loop function
+void render(BelaContext *context, void *userData) {
+  // check for button press
+  if (gWaitingForButtonPress) {
+    // read == false when button is pressed !?!
+  	if (!gBelaCapeButton.read()) {
+      gBelaButtonPressed = true;
+  	}
+  }
+  gAudioFramesElapsed.store(context->audioFramesElapsed, std::memory_order_relaxed);
+  gClockSync.stampAudio(context->audioFramesElapsed, latency_now_ns());
+  // pick up the newest mocap frame (if any), it stays put for the whole block
+  if (gMocapBuffer.update() && gLatencyMonitor.enabled()) {
+    gLatencyMonitor.record(LatencyMonitor::kPickup, (latency_now_ns() - gMocapBuffer.read().arrival) / 1000);
+  }
+  const MocapFrame &mocap = gMocapBuffer.read();
+  // where the subjects will be when this block is heard
+  const MocapPositions &pos = output_positions(mocap, context, gOutputPos);
 
-      if (gSyncUseTwoChannels) {
-        gOut = (
-          warp_read_sample(gUndertoneSampleData, gReadPtrUndertone2, undertone_srs[1] / gUndertoneFreqMin, gSampleLength) +
-          warp_read_sample(gOvertoneSampleData, gReadPtrOvertone, gFreqCenter / gOvertoneFreqMin, gSampleLength) * overtone_amp
-        ) * 0.5f * gAmpMod;
+  // control values for these positions, reached at the end of the block. the
+  // samples before glide there from the last block's values, which takes the
+  // steps out of the sound when a new frame comes in.
+  const unsigned int rampSamples = gControlsLive ? context->audioFrames : 0;
+  if (gCurrentConditionIdx == Condition::TASK_SONIFICATION) {
+    for (unsigned int i = 0; i < NUM_SUBJECTS; i++) {
+      const Tone tone = gSubjectTones[i];
+      const float freq = pos_to_freq(pos[i][gTrackAxis], gTrackStart, gTrackEnd, tone_freq_min(tone), tone_freq_max(tone));
+      gVoices.rate(i).rampTo(freq / tone_freq_min(tone), rampSamples);
+    }
+  } else {
+    // every subject against the mean of the others, for a pair that's each other
+    float lowest = pos[0][gTrackAxis], highest = pos[0][gTrackAxis];
+    for (unsigned int i = 1; i < NUM_SUBJECTS; i++) {
+      lowest = std::min(lowest, pos[i][gTrackAxis]);
+      highest = std::max(highest, pos[i][gTrackAxis]);
+    }
+    for (unsigned int i = 0; i < NUM_SUBJECTS; i++) {
+      const float x = pos[i][gTrackAxis];
+      float others = 0.0f;
+      for (unsigned int j = 0; j < NUM_SUBJECTS; j++) {
+        if (j != i) others += pos[j][gTrackAxis];
       }
+      others = NUM_SUBJECTS > 1 ? others / (NUM_SUBJECTS - 1) : x;
+      const std::array<float, 2> undertoneFreqs = sync_to_freq(x, others, gTrackStart, gTrackEnd, gUndertoneFreqMin, gUndertoneFreqMax);
+      gVoices.rate(i).rampTo(undertoneFreqs[0] / gUndertoneFreqMin, rampSamples);
+    }
+    gVoices.rate(gGroupVoice).reset(gFreqCenter / gOvertoneFreqMin);
+    // the overtone comes in as the group closes up
+    gVoices.gain(gGroupVoice).rampTo(sync_to_amp(lowest, highest, gTrackStart, gTrackEnd, 0.15f), rampSamples);
+  }
 
-      audioWrite(context, n, 1, gOut);
-      
+  gCurrentTrialDuration += context->audioFrames;
+  // if silent mode is set or the current tone is the "pause" tone
+  if (gSilence) {
+    // if this is between trials, or in the no sonification condition
+    // just output silence.
+    for (unsigned int n = 0; n < context->audioFrames; n++) {
+      for (unsigned int c = 0; c < context->audioOutChannels; c++) audioWrite(context, n, c, 0);
+    }
+    gControlsLive = false;
+  } else if (startTonePlaying || endTonePlaying) {
+    // if we're playing a start or end tone, we need to play a sine tone instead of sonification
+    for (unsigned int n = 0; n < context->audioFrames; n++) {
+      gOut = sin_freq(gCurrentTonePhase, gCurrentToneFreq, gCurrentToneInvSampleRate);
+      for (unsigned int c = 0; c < context->audioOutChannels; c++) audioWrite(context, n, c, gOut);
     }
-    // }
+    gControlsLive = false;
+  } else {
+    gControlsLive = true;
+    render_sonification(context);
   }
   Bela_scheduleAuxiliaryTask(gRunExperimentTask);
   
@@ -162,9 +258,23 @@ void render(BelaContext *context, void *userData) {
 
 // bela cleanup function
 void cleanup(BelaContext *context, void *userData) {
+  if (rtProtocol == NULL) return;
+  // stop the receiver thread first, it may be blocked in Receive() on the sockets
+  gReceiverStop = true;
+  // don't leave it waiting out its socket timeout
+  rtProtocol->Interrupt();
+  for (unsigned int waited = 0; gReceiverRunning && waited < gReceiverStopMicroSec; waited += gReceiverIdleMicroSec) {
+    usleep(gReceiverIdleMicroSec);
+  }
+  if (gReceiverRunning) {
+    printf("The mocap receiver didn't stop, leaving the QTM connection open.\n");
+    return;
+  }
   // disconnect nicely from QTM
   if (gConnected) {
     gConnected = false;
     rtProtocol->Disconnect();
   }
+  delete rtProtocol;
+  rtProtocol = NULL;
 }
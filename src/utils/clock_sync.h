@@ -0,0 +1,211 @@
+#ifndef CLOCK_SYNC_UTILS_H
+#define CLOCK_SYNC_UTILS_H
+
+#include <array>
+#include <cmath>
+#include <cstdio>
+
+#include "./spsc_queue.h"
+#include "./triple_buffer.h"
+
+// straight line y = y0 + offset + rate * (x - x0) under a stream of (x, y)
+// points whose y can only come late, e.g. the wall clock time a packet stamped
+// on another clock arrived at. the earliest point of every window of x is kept
+// and the line is a least squares fit through the last kWindows of them, so the
+// rate follows the drift between the clocks while queueing delays don't pull
+// the line up. until kMinWindows are in, the line has the nominal rate and goes
+// through the earliest point seen.
+class ClockLine {
+public:
+  static constexpr unsigned int kWindows = 16;
+  // fewer windows give a noisier rate than the nominal one
+  static constexpr unsigned int kMinWindows = 4;
+
+  ClockLine(double nominalRate, long long windowX) : mNominalRate(nominalRate), mWindowX(windowX) { reset(); }
+
+  void reset() {
+    mStarted = false;
+    mWindowCount = 0;
+    mNext = 0;
+    mRate = mNominalRate;
+    mOffset = 0.0;
+  }
+
+  void add(long long x, long long y) {
+    if (!mStarted) {
+      mStarted = true;
+      mX0 = x;
+      mY0 = y;
+      startWindow(x);
+    } else if (x - mWindowStart >= mWindowX) {
+      closeWindow();
+      startWindow(x);
+    }
+    const double dx = (double)(x - mX0);
+    const double residual = (double)(y - mY0) - mNominalRate * dx;
+    if (residual < mWindowMin) {
+      mWindowMin = residual;
+      mWindowMinX = dx;
+    }
+    if (!fitted() && residual < mOffset) mOffset = residual;
+  }
+
+  // true once there is a point to go by, fitted() once the rate is measured
+  bool ready() const { return mStarted; }
+  bool fitted() const { return mWindowCount >= kMinWindows; }
+  // y per x, nominal until fitted()
+  double rate() const { return mRate; }
+
+  long long at(long long x) const { return mY0 + llround(mOffset + mRate * (double)(x - mX0)); }
+  long long inverse(long long y) const { return mX0 + llround(((double)(y - mY0) - mOffset) / mRate); }
+
+private:
+  void startWindow(long long x) {
+    mWindowStart = x;
+    mWindowMin = INFINITY;
+    // the running minimum starts over with the first window
+    if (mWindowCount == 0) mOffset = INFINITY;
+  }
+
+  // keep the window's earliest point and refit the line through the kept ones
+  void closeWindow() {
+    mWindowX0[mNext] = mWindowMinX;
+    mWindowR[mNext] = mWindowMin;
+    mNext = (mNext + 1) % kWindows;
+    if (mWindowCount < kWindows) mWindowCount++;
+    if (!fitted()) return;
+
+    // residuals against the nominal rate keep the sums well conditioned
+    double sumX = 0.0, sumR = 0.0;
+    for (unsigned int i = 0; i < mWindowCount; i++) {
+      sumX += mWindowX0[i];
+      sumR += mWindowR[i];
+    }
+    const double meanX = sumX / mWindowCount, meanR = sumR / mWindowCount;
+    double sxx = 0.0, sxr = 0.0;
+    for (unsigned int i = 0; i < mWindowCount; i++) {
+      sxx += (mWindowX0[i] - meanX) * (mWindowX0[i] - meanX);
+      sxr += (mWindowX0[i] - meanX) * (mWindowR[i] - meanR);
+    }
+    const double slope = sxx > 0.0 ? sxr / sxx : 0.0;
+    mRate = mNominalRate + slope;
+    mOffset = meanR - slope * meanX;
+  }
+
+  const double mNominalRate;
+  const long long mWindowX;
+  bool mStarted;
+  long long mX0 = 0;
+  long long mY0 = 0;
+  long long mWindowStart = 0;
+  double mWindowMin = 0.0;
+  double mWindowMinX = 0.0;
+  std::array<double, kWindows> mWindowX0{};
+  std::array<double, kWindows> mWindowR{};
+  unsigned int mWindowCount;
+  unsigned int mNext;
+  double mRate;
+  double mOffset;
+};
+
+// QTM capture time to audio sample, as a line through a reference point
+struct ClockMap {
+  bool valid = false;
+  unsigned long long captureUs = 0;
+  double sample = 0.0;
+  double samplesPerUs = 0.0;
+
+  double toSample(unsigned long long timeUs) const {
+    return sample + samplesPerUs * (double)((long long)(timeUs - captureUs));
+  }
+  double toCaptureUs(double atSample) const { return (double)captureUs + (atSample - sample) / samplesPerUs; }
+};
+
+// maps QTM capture timestamps onto the audio timeline. neither clock can be read
+// from the other side, but both can be lined up with the wall clock:
+// - render() stamps the wall clock at the start of every block, so audio
+//   frames -> wall clock is the line under the block start times
+// - the receiver thread has the kernel arrival time of every mocap frame, so
+//   capture time -> wall clock is the line under the arrival times
+// chaining the two gives the sample a frame reached the Bela at in the best
+// case, minus the fixed captureToArrivalSec that no timestamp can show. both
+// lines track the drift of their clock against the wall clock, so their ratio
+// is the drift between QTM and the audio clock.
+// the receiver thread owns the fit, render() only pushes stamps, and one other
+// thread (the experiment task) can read the latest map.
+class ClockSync {
+public:
+  ClockSync(float sampleRate, float windowSec, float captureToArrivalSec)
+    : mSampleRate(sampleRate),
+      mLatencySamples(captureToArrivalSec * sampleRate),
+      mAudio(1e9 / sampleRate, (long long)(windowSec * sampleRate)),
+      mQtm(1000.0, (long long)(windowSec * 1e6f)) {}
+
+  // render(): audio frames elapsed at the start of the block and the wall clock in ns.
+  // stamps are dropped while nobody is receiving, the line doesn't need all of them.
+  void stampAudio(unsigned long long framesElapsed, long long nowNs) {
+    mAudioStamps.push({(long long)framesElapsed, nowNs});
+  }
+
+  // receiver thread: one received frame, returns the map after it
+  const ClockMap &addFrame(unsigned long long captureUs, long long arrivalNs) {
+    AudioStamp stamp;
+    while (mAudioStamps.pop(stamp)) mAudio.add(stamp.frames, stamp.ns);
+    if (arrivalNs <= 0 || !mAudio.ready()) return mMap;
+
+    // a paused stream or looping RT playback starts a new time line
+    if (mQtm.ready() && (arrivalNs - mLastArrivalNs > kStreamGapNs || captureUs < mLastCaptureUs)) {
+      mQtm.reset();
+      mReported = false;
+    }
+    // frames read from TCP in one go share a receive time that is too early for
+    // all but the first of them
+    if (arrivalNs != mLastArrivalNs) mQtm.add((long long)captureUs, arrivalNs);
+    mLastArrivalNs = arrivalNs;
+    mLastCaptureUs = captureUs;
+
+    mMap.valid = true;
+    mMap.captureUs = captureUs;
+    mMap.sample = (double)mAudio.inverse(mQtm.at((long long)captureUs)) - mLatencySamples;
+    mMap.samplesPerUs = mQtm.rate() / mAudio.rate();
+    mPublished.write() = mMap;
+    mPublished.publish();
+
+    if (!mReported && mQtm.fitted() && mAudio.fitted()) {
+      printf("Clock sync locked: audio clock %+.1f ppm against QTM, QTM %.6f s is audio frame %.0f\n",
+             driftPpm(), captureUs * 1e-6, mMap.sample);
+      mReported = true;
+    }
+    return mMap;
+  }
+
+  // audio samples per QTM second above the nominal rate, in ppm
+  double driftPpm() const { return (mMap.samplesPerUs / (mSampleRate * 1e-6) - 1.0) * 1e6; }
+
+  // the one reading thread: the newest map published by the receiver
+  const ClockMap &latest() {
+    mPublished.update();
+    return mPublished.read();
+  }
+
+private:
+  static constexpr long long kStreamGapNs = 1000000000LL; // 1 s
+
+  struct AudioStamp {
+    long long frames;
+    long long ns;
+  };
+
+  const double mSampleRate;
+  const double mLatencySamples;
+  ClockLine mAudio;
+  ClockLine mQtm;
+  SpscQueue<AudioStamp, 256> mAudioStamps;
+  long long mLastArrivalNs = 0;
+  unsigned long long mLastCaptureUs = 0;
+  bool mReported = false;
+  ClockMap mMap;
+  TripleBuffer<ClockMap> mPublished;
+};
+
+#endif
@@ -4,10 +4,9 @@
 #include <array>
 #include <string>
 
-// how much history to keep
-#define NUM_SAMPLES 2
-// how many signals to process (at the moment this is required to be 2)
-// because we match them to out channels...for now.
+// how many subjects are tracked, each one has a marker in gSubjMarkerLabels,
+// a tone in gSubjectTones and an output channel in gSubjectOutChannels.
+// tools/bench/voice_pool_bench.cpp measures what more subjects cost.
 #define NUM_SUBJECTS 2
 // just x, y, z. but maybe we want to track other things?
 #define NUM_COORDS 3
@@ -80,6 +79,14 @@ const std::array<unsigned int, 3> gConditionOrder = {{
 /* MOCAP */
 
 const unsigned int gPacketTimeoutMicroSec = 100000; // 100ms
+// how long the receiver thread sleeps between checks while not streaming
+const unsigned int gReceiverIdleMicroSec = 1000; // 1ms
+// how long cleanup() waits for the receiver thread to return before leaving
+// the QTM connection open rather than pulling it out from under the thread
+const unsigned int gReceiverStopMicroSec = 5000000; // 5s
+// how long the receiver thread waits on the way out for QTM to answer the last
+// commands (shorter than gReceiverStopMicroSec, so cleanup() still sees it return)
+const unsigned int gReceiverDrainMicroSec = 2000000; // 2s
 // track axis
 const unsigned int gTrackAxis = 1; // x: 0, y: 1, z: 2
 
@@ -91,14 +98,65 @@ const float gTrackEnd = 900.0;
 // UDP has less overhead so try to use that if no problems.
 const bool gStreamUDP = true;
 
+// when streaming over UDP, read every queued frame at once and only keep the
+// newest one, so a late receiver never plays back a backlog of stale frames.
+const bool gCoalesceUDPFrames = true;
+
+// how often (in seconds of stream time) to print frame arrival jitter, delay
+// and clock drift measured from kernel receive timestamps. 0 disables it.
+const float gFrameTimingReportSec = 10.0f;
+
+// window (in seconds of stream time) for the stream health rates. a line is
+// printed for every window in which frames were lost, duplicated or out of
+// order, or QTM reported dropped camera frames (see utils/stream_health.h).
+const float gStreamHealthWindowSec = 1.0f;
+
+// background latency monitor for the streamed frames (see utils/latency_monitor.h).
+// can also be switched on or off when starting the program with QTM_LATENCY_MONITOR=1 / =0.
+const bool gLatencyMonitorEnabled = false;
+// TSV file the monitor appends to, QTM_LATENCY_LOG overrides it.
+const std::string gLatencyLogFile = "/var/log/qtm_latency.tsv";
+// how often the monitor writes a row per metric
+const float gLatencyMonitorFlushSec = 10.0f;
+
 // Should bela tell QTM to start and stop capture?
 const bool gControlQTMCapture = false;
 
 // names of tracked markers in QTM.
 const std::array<std::string, NUM_SUBJECTS> gSubjMarkerLabels{{"CAR_W", "CAR_D"}};
 
+// filling in markers that drop out of frames (see utils/marker_tracker.h):
+// alpha-beta filter gains, and how long a gap is filled before the marker is
+// considered lost and held in place.
+const float gGapFillAlpha = 0.85f;
+const float gGapFillBeta = 0.3f;
+const float gGapFillMaxSec = 0.1f;
+
+// move the subjects along their estimated velocity to where they will be when
+// the audio block reaches the DAC (see utils/motion_prediction.h), to take the
+// mocap and audio latency out of the sound.
+const bool gPredictToOutput = true;
+// QTM capture to arrival at the Bela in the best case (exposure, QTM processing
+// and network), which can't be measured on the Bela.
+const float gCaptureToArrivalSec = 0.004f;
+// Bela output latency on top of the block being rendered (codec).
+const float gOutputLatencySec = 0.0005f;
+// longest prediction, the horizon is clamped to this.
+const float gPredictionMaxSec = 0.03f;
+
+// QTM capture times are mapped onto the audio timeline by fitting both clocks
+// against the wall clock (see utils/clock_sync.h). the earliest frame of every
+// window this long goes into the fit, which spans 16 windows.
+const float gClockSyncWindowSec = 0.5f;
+
 /* SONIFICATION */
 
+// the samples the voices play
+enum Tone {
+  UNDERTONE = 0,
+  OVERTONE = 1
+};
+
 // file for the lower tone
 const std::string gUndertoneFile = "./res/simple_As2.wav";
 
@@ -118,10 +176,26 @@ const float gOvertoneFreqMax = 277.183;
 const float gFreqCenter = 220.0;
 
 
+// taps of the windowed sinc resampler that plays the samples at their pitch:
+// 8, 16 or 32 (band-limited, more taps alias less), or 0 for linear
+// interpolation (the cheapest, but it aliases when the samples are played
+// faster). tools/bench/resampler_bench.cpp measures them.
+const unsigned int gResampleTaps = 16;
+
 // length of wave files in samples
 const unsigned int gSampleLength = 113145;
 
-// Should sync condition be different for left and right channels?
+// the tone each subject's position plays in the task sonification condition
+const std::array<Tone, NUM_SUBJECTS> gSubjectTones{{UNDERTONE, OVERTONE}};
+
+// the output channel each subject hears their own sound on, when the
+// condition gives every subject their own (see gSyncUseTwoChannels). the
+// shared sound plays on all channels.
+const std::array<int, NUM_SUBJECTS> gSubjectOutChannels{{0, 1}};
+
+// Should sync condition be different for left and right channels? every
+// subject then hears their own undertone on their gSubjectOutChannels,
+// otherwise only the first subject's undertone plays, on all channels.
 const bool gSyncUseTwoChannels = false;
 
 /* MODULATION */
@@ -0,0 +1,62 @@
+#ifndef CONTROL_RAMP_UTILS_H
+#define CONTROL_RAMP_UTILS_H
+
+#include <cmath>
+
+// a control value for the audio loop that glides from one control point to the
+// next instead of stepping, e.g. from the value for the end of the last block
+// to the one for the end of this block. the target is set once per block with
+// whatever math it takes, the per sample step is an add (linear) or a multiply
+// (exponential, an equal ratio per sample, for frequencies and playback rates).
+// exponential ramps through zero or negative values fall back to linear.
+// render thread only.
+class ControlRamp {
+public:
+  enum class Shape { kLinear, kExponential };
+
+  explicit ControlRamp(Shape shape, float value = 0.0f) : mShape(shape) { reset(value); }
+
+  // straight to value, e.g. when the sound starts again
+  void reset(float value) {
+    mValue = mTarget = value;
+    mRemaining = 0;
+  }
+
+  // glide to target over the next samples, reached on the last of them
+  void rampTo(float target, unsigned int samples) {
+    if (samples == 0 || target == mValue) {
+      reset(target);
+      return;
+    }
+    mTarget = target;
+    mRemaining = samples;
+    mMultiply = mShape == Shape::kExponential && mValue > 0.0f && target > 0.0f;
+    mStep = mMultiply ? powf(target / mValue, 1.0f / samples) : (target - mValue) / samples;
+  }
+
+  // per sample: the value for this sample
+  float next() {
+    if (mRemaining > 0) {
+      // land on the target exactly, whatever the rounding on the way
+      if (--mRemaining == 0) {
+        mValue = mTarget;
+      } else {
+        mValue = mMultiply ? mValue * mStep : mValue + mStep;
+      }
+    }
+    return mValue;
+  }
+
+  float value() const { return mValue; }
+  float target() const { return mTarget; }
+
+private:
+  const Shape mShape;
+  float mValue;
+  float mTarget;
+  float mStep = 0.0f;
+  bool mMultiply = false;
+  unsigned int mRemaining;
+};
+
+#endif
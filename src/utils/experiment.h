@@ -1,6 +1,8 @@
 #ifndef GLOBALS_EXPERIMENT_H
 #define GLOBALS_EXPERIMENT_H
 
+#include <unistd.h>
+
 #include <Bela.h>
 
 #include "../qsdk/RTPacket.h"
@@ -8,52 +10,66 @@
 
 #include "./config.h"
 #include "./globals.h"
+#include "./latency_monitor.h"
 #include "./qtm.h"
 #include "./sound.h"
 #include "./space.h"
 
+// the QTM side of a condition runs on the receiver thread like every command,
+// the experiment task waits for it
 bool prepare_sonification_condition() {
-  // make sure there's 3D data
-  bool dataAvailable;
-  if (!rtProtocol->Read3DSettings(dataAvailable)) return false;
-
-  // Start streaming from QTM
-  if (gStreamUDP) {
-    if (!rtProtocol->StreamFrames(CRTProtocol::RateAllFrames, 0, nPort, NULL,
-                                 CRTProtocol::cComponent3d)) {
-      printf("Error streaming from QTM\n");
-      return false;
-    }
-  } else {
-    // Start the 3D data stream.
-    if (!rtProtocol->StreamFrames(CRTProtocol::RateAllFrames, 0, 0, NULL,
-                                 CRTProtocol::cComponent3d)) {
-      printf("Error streaming from QTM\n");
-      return false;
+  return runOnReceiver([] {
+    // make sure there's 3D data
+    bool dataAvailable;
+    gCameraSettingsChanges = rtProtocol->GetCameraSettingsChangeCount();
+    if (!rtProtocol->Read3DSettings(dataAvailable)) return false;
+    // only 3D is read from the frames, the rest of a packet isn't indexed
+    rtProtocol->SetConsumedComponents(CRTProtocol::cComponent3d);
+
+    // Start streaming from QTM
+    if (gStreamUDP) {
+      if (!rtProtocol->StreamFrames(CRTProtocol::RateAllFrames, 0, nPort, NULL,
+                                   CRTProtocol::cComponent3d)) {
+        printf("Error streaming from QTM\n");
+        return false;
+      }
+    } else {
+      // Start the 3D data stream.
+      if (!rtProtocol->StreamFrames(CRTProtocol::RateAllFrames, 0, 0, NULL,
+                                   CRTProtocol::cComponent3d)) {
+        printf("Error streaming from QTM\n");
+        return false;
+      }
     }
-  }
-  printf("Started streaming 3D data...\n");
-  gStreaming = true;
+    printf("Started streaming 3D data...\n");
+    for (MarkerTracker &tracker : gMarkerTrackers) tracker.setup(gGapFillAlpha, gGapFillBeta, gGapFillMaxSec);
+    gStreaming = true;
 
-  if (!reindexMarkers(rtProtocol)) return false;
-  // start getting the 3D data.
-  // Bela_scheduleAuxiliaryTask(gFillBufferTask);
-  gSilence = true;
-  
-  // Bela_deleteAllAuxiliaryTasks();
-  return true;
+    if (!reindexMarkers(rtProtocol)) return false;
+    // the receiver thread picks up the 3D data as soon as we're not silent.
+    gSilence = true;
+
+    // Bela_deleteAllAuxiliaryTasks();
+    return true;
+  });
 }
 
 bool end_sonification_condition() {
-  // Stop streaming from QTM
-  if (!rtProtocol->StreamFramesStop()) {
-    printf("Error stopping streaming from QTM\n");
-    return false;
-  }
-  printf("Stopped streaming 3D data\n");
-  gStreaming = false;
-  gSilence = true;
-  return true;
+  return runOnReceiver([] {
+    // Stop streaming from QTM
+    if (!rtProtocol->StreamFramesStop()) {
+      printf("Error stopping streaming from QTM\n");
+      return false;
+    }
+    printf("Stopped streaming 3D data\n");
+    if (gStreamUDP && gCoalesceUDPFrames) {
+      printf("Stale frames skipped so far: %llu\n", rtProtocol->GetDiscardedFrameCount());
+    }
+    gStreamHealth.printTotals();
+    gStreaming = false;
+    gSilence = true;
+    return true;
+  });
 }
 
 void resetDuration() {
@@ -66,9 +82,7 @@ void resetTrial() {
   startTonePlayed = false;
   endTonePlayed = false;
   gTrialDone = false;
-  gReadPtrOvertone = 0.0f;
-  gReadPtrUndertone = 0.0f;
-  gReadPtrUndertone2 = 0.0f;
+  gVoices.resetPhases();
   gAmpModPtr = 0;
 
 }
@@ -173,7 +187,7 @@ void startExperiment() {
   // if we're using bela to start / stop capture, do it here.
   if (gControlQTMCapture) {
     startCapture(rtProtocol);
-    printf("QTM capture started.\n");
+    printf("QTM capture start requested.\n");
   }
   sendEventLabel(rtProtocol, Labels::EXPERIMENT_START);
   waitForButton();
@@ -187,7 +201,7 @@ void endExperiment() {
   // if we're using bela to start / stop capture, do it here.
   if (gControlQTMCapture) {
     stopCapture(rtProtocol);
-    printf("QTM capture stopped.\n");
+    printf("QTM capture stop requested.\n");
   }
   printf("Exiting.\n");
   Bela_requestStop();
@@ -263,10 +277,6 @@ void startTrialIfReady() {
     gSilence = false;
   }
   startTrial();
-  if (!gSilence && gStreaming) {
-    Bela_scheduleAuxiliaryTask(gFillBufferTask);
-  }
-  
 }
 
 void endTrial() {
@@ -323,11 +333,6 @@ void endTrialIfReady() {
     }
     printf("Sending trial end label...\n");
     sendEventLabel(rtProtocol, Labels::TRIAL_END);
-  } else {
-    if (!gSilence && gStreaming) {
-      // just keep polling for 3D data.
-      Bela_scheduleAuxiliaryTask(gFillBufferTask);
-    }
   }
 }
 
@@ -359,50 +364,118 @@ void runExperiment(void *) {
   
 }
 
-// update buffer of QTM data
-void fillBuffer(void *) {
+// read the latest QTM 3D packet into the mocap buffer and publish it.
+// returns false if there was no data frame to process.
+bool fillBuffer() {
   // if stream is not open, or we're silenced, don't do anything
-  if (!gStreaming || gSilence) return;
+  if (!gStreaming || gSilence) return false;
   // Make sure we successfully get the data
-  if (!get3DPacket(rtProtocol, rtPacket, packetType)) return;
+  if (!get3DPacket(rtProtocol, rtPacket, packetType)) return false;
+
+  // frames that come in twice or late would take the trackers back in time
+  const StreamHealth::FrameClass frameClass = gStreamHealth.record(
+    rtPacket->GetFrameNumber(), rtPacket->GetTimeStamp(), rtProtocol->GetRTPacketArrivalTime(),
+    rtProtocol->GetDiscardedFrameCount(),
+    rtPacket->GetDropRate(), rtPacket->GetOutOfSyncRate());
+  if (frameClass == StreamHealth::FrameClass::kDuplicate || frameClass == StreamHealth::FrameClass::kReorder) {
+    return false;
+  }
+  if (frameClass == StreamHealth::FrameClass::kRestart) {
+    printf("QTM stream went back to frame %u, starting over.\n", rtPacket->GetFrameNumber());
+  }
+
+  MocapFrame &frame = gMocapBuffer.write();
 
   // this helps us when we're doing realtime playback, because it loops.
-  const unsigned int uPacketFrame = rtPacket->GetFrameNumber();
+  frame.frame = rtPacket->GetFrameNumber();
+  frame.timestamp = rtPacket->GetTimeStamp();
+  frame.arrival = rtProtocol->GetRTPacketArrivalTime();
+  frame.delayUs = 0;
+  if (gFrameTimingReportSec > 0.0f || gLatencyMonitor.enabled() || gPredictToOutput) {
+    const long long delayUs = gFrameTiming.record(frame.arrival, frame.timestamp);
+    gLatencyMonitor.record(LatencyMonitor::kDelay, delayUs);
+    if (delayUs > 0) frame.delayUs = delayUs;
+  }
+  const ClockMap &clock = gClockSync.addFrame(frame.timestamp, frame.arrival);
+  frame.sample = clock.valid ? clock.toSample(frame.timestamp) : -1.0;
+
+  // all subject markers in one pass over the packet
+  static_assert(sizeof(frame.pos) == NUM_SUBJECTS * NUM_COORDS * sizeof(float), "frame.pos must be contiguous");
+  std::array<unsigned char, NUM_SUBJECTS> markerValid{};
+  if (rtPacket->Get3DMarkers(gSubjMarker.data(), NUM_SUBJECTS, frame.pos[0].data(), markerValid.data()) != NUM_SUBJECTS) {
+    // no 3D component, nothing was written: every marker is missing and the trackers fill in
+    markerValid.fill(0);
+  }
 
   for (int i = 0; i < NUM_SUBJECTS; i++) {
-    // auto &prevPos = gPos3D[1][i];
-    auto &currPos = gPos3D[0][i];
-    // get the position of the marker
-    if (!rtPacket->Get3DMarker(gSubjMarker[i], currPos[0], currPos[1], currPos[2])) {
-      // the marker failed, we can try reindexing
-      printf("Marker %d failed, reindexing.\n", gSubjMarker[i]);
-      if (reindexMarkers(rtProtocol)) {
-        printf("Reindexing successful.\n");
-        // reindexing was successful, so we can try again
-        if (!rtPacket->Get3DMarker(gSubjMarker[i], currPos[0], currPos[1], currPos[2])) {
-          // the marker failed again, so we'll just set the position to 0
-          printf("Marker %d failed again, setting position to 0.\n", gSubjMarker[i]);
-          currPos[0] = 0.0f;
-          currPos[1] = 0.0f;
-          currPos[2] = 0.0f;
-        }
-      } else {
-        // reindexing failed, so we'll just set the position to 0
-        printf("Reindexing failed, setting position to 0.\n");
-        currPos[0] = 0.0f;
-        currPos[1] = 0.0f;
-        currPos[2] = 0.0f;
-      }
+    auto &currPos = frame.pos[i];
+    MarkerTracker &tracker = gMarkerTrackers[i];
+    const MarkerTracker::State previous = tracker.state();
+    const unsigned long long lastMeasured = tracker.lastMeasured();
+    const MarkerTracker::State state = tracker.update(frame.timestamp, currPos.data(), markerValid[i]);
+    // measured positions go out as they are, the filter only stands in for missing ones
+    if (!markerValid[i]) currPos = tracker.position();
+    frame.vel[i] = tracker.velocity();
+    frame.lost[i] = state == MarkerTracker::State::kLost || state == MarkerTracker::State::kIdle;
+
+    if (state == previous) continue;
+    if (state == MarkerTracker::State::kFilling) {
+      printf("Marker %u failed, filling the gap.\n", gSubjMarker[i]);
+    } else if (state == MarkerTracker::State::kLost) {
+      printf("Marker %u missing for over %.0f ms, holding its last position.\n", gSubjMarker[i], gGapFillMaxSec * 1e3f);
+    } else if (state == MarkerTracker::State::kTracking && previous != MarkerTracker::State::kIdle) {
+      printf("Marker %u back after %.1f ms.\n", gSubjMarker[i], (frame.timestamp - lastMeasured) * 1e-3);
     }
   }
 
-  // update last processed frame
-  gLastFrame = uPacketFrame;
+  // hand the frame over to render(), it will pick it up at the next block
+  gMocapBuffer.publish();
+  return true;
+}
 
-  // swap the current and previous positions
-  // this means we always have the previous position in gPos3D[1]
-  // but overwrite gPos3D[0]
-  std::swap(gPos3D[0], gPos3D[1]);
+// persistent mocap receiver thread, started once from setup().
+// it blocks on the QTM socket (up to gPacketTimeoutMicroSec) so every frame
+// is published as soon as it arrives instead of at the next audio block.
+// it's the one thread that uses rtProtocol: the experiment task's commands
+// are run here between receives (see runOnReceiver), never alongside them.
+void receiveMocap(void *) {
+  // running first, then the stop check: either cleanup() sees this thread or it sees the stop
+  gReceiverRunning = true;
+  bool receiving = false;
+  while (!Bela_stopRequested() && !gReceiverStop) {
+    runProtocolJobs();
+    if (!gStreaming || gSilence) {
+      receiving = false;
+      if (gConnected && rtProtocol->GetPendingCommandCount() > 0) {
+        // no mocap wanted, but pick up the responses to queued event labels
+        CRTPacket::EPacketType type;
+        rtProtocol->Receive(type, true, gReceiverIdleMicroSec);
+        continue;
+      }
+      // nothing to receive between trials, check back shortly
+      usleep(gReceiverIdleMicroSec);
+      continue;
+    }
+    if (!receiving) {
+      // QTM kept streaming while we weren't reading, those frames aren't lost
+      gStreamHealth.restart(latency_now_ns());
+      receiving = true;
+    }
+    refreshMarkerIndices(rtProtocol);
+    fillBuffer();
+  }
+  // the last labels and the capture stop of endExperiment(), and their
+  // responses: cleanup() disconnects next, which fails whatever is still pending
+  runProtocolJobs();
+  if (gConnected) {
+    const long long deadline = latency_now_ns() + gReceiverDrainMicroSec * 1000LL;
+    while (rtProtocol->GetPendingCommandCount() > 0 && latency_now_ns() < deadline) {
+      CRTPacket::EPacketType type;
+      const CNetwork::ResponseType response = rtProtocol->Receive(type, true, gReceiverIdleMicroSec);
+      if (response == CNetwork::ResponseType::disconnect || response == CNetwork::ResponseType::error) break;
+    }
+  }
+  gReceiverRunning = false;
 }
 
 #endif
@@ -0,0 +1,110 @@
+#ifndef FRAME_TIMING_UTILS_H
+#define FRAME_TIMING_UTILS_H
+
+#include <cstdio>
+#include <cstdint>
+
+#include "./histogram.h"
+
+// network timing of the mocap stream, fed by the receiver thread with the time
+// each frame reached the Bela (kernel timestamp) and its QTM capture timestamp.
+// - interval: time between consecutive arrivals, i.e. frame jitter.
+// - delay: arrival minus capture time, relative to the smallest value seen so far.
+//   the two clocks aren't synchronised, so only the spread is meaningful, and the
+//   way the smallest value moves from one report to the next is the clock drift.
+// everything is reported and reset every reportIntervalSec of stream time.
+class FrameTimingStats {
+public:
+  explicit FrameTimingStats(float reportIntervalSec)
+    : mReportIntervalNs((long long)(reportIntervalSec * 1e9)) {
+    restart();
+  }
+
+  // forget the baseline, e.g. when QTM restarts its clock
+  void restart() {
+    mLastArrivalNs = 0;
+    mLastCaptureUs = 0;
+    mHaveBaseline = false;
+    mHavePrevWindow = false;
+    startWindow(0);
+  }
+
+  // returns the delay of this frame above the best case in microseconds, -1 without an arrival time
+  long long record(long long arrivalNs, unsigned long long captureUs) {
+    if (arrivalNs <= 0) return -1;
+    // a paused stream or looping RT playback starts a new time line
+    if (mLastArrivalNs != 0 && (arrivalNs - mLastArrivalNs > kStreamGapNs || captureUs < mLastCaptureUs)) {
+      restart();
+    }
+    if (mWindowStartNs == 0) startWindow(arrivalNs);
+
+    if (mLastArrivalNs != 0 && arrivalNs > mLastArrivalNs) {
+      mIntervalUs.record((uint64_t)((arrivalNs - mLastArrivalNs) / 1000));
+    }
+    mLastArrivalNs = arrivalNs;
+    mLastCaptureUs = captureUs;
+
+    const long long offsetUs = arrivalNs / 1000 - (long long)captureUs;
+    if (!mHaveBaseline || offsetUs < mBaselineUs) {
+      mBaselineUs = offsetUs;
+      mHaveBaseline = true;
+    }
+    if (offsetUs < mWindowMinOffsetUs) mWindowMinOffsetUs = offsetUs;
+    const long long delayUs = offsetUs - mBaselineUs;
+    mDelayUs.record((uint64_t)delayUs);
+
+    if (mReportIntervalNs > 0 && arrivalNs - mWindowStartNs >= mReportIntervalNs) {
+      report(arrivalNs);
+    }
+    return delayUs;
+  }
+
+private:
+  static constexpr long long kStreamGapNs = 1000000000LL; // 1 s
+
+  void startWindow(long long startNs) {
+    mWindowStartNs = startNs;
+    mWindowMinOffsetUs = INT64_MAX;
+    mIntervalUs.reset();
+    mDelayUs.reset();
+  }
+
+  void report(long long nowNs) {
+    const double windowSec = (nowNs - mWindowStartNs) * 1e-9;
+    printf("Frame timing over %.1f s (%llu frames): interval p50 %.2f / p99 %.2f / max %.2f ms, "
+           "delay p50 %.2f / p99 %.2f / p99.9 %.2f / max %.2f ms",
+           windowSec, (unsigned long long)mDelayUs.count(),
+           mIntervalUs.percentile(50.0) * 1e-3, mIntervalUs.percentile(99.0) * 1e-3, mIntervalUs.max() * 1e-3,
+           mDelayUs.percentile(50.0) * 1e-3, mDelayUs.percentile(99.0) * 1e-3, mDelayUs.percentile(99.9) * 1e-3,
+           mDelayUs.max() * 1e-3);
+    if (mHavePrevWindow) {
+      // how fast the best case delay moves between the middles of the last two windows,
+      // in microseconds per second of stream time
+      const double elapsedSec = ((nowNs + mWindowStartNs) - (mPrevWindowEndNs + mPrevWindowStartNs)) * 0.5e-9;
+      const double driftPpm = (double)(mWindowMinOffsetUs - mPrevWindowMinOffsetUs) / elapsedSec;
+      printf(", drift %+.1f ppm", driftPpm);
+    }
+    printf("\n");
+    mPrevWindowMinOffsetUs = mWindowMinOffsetUs;
+    mPrevWindowStartNs = mWindowStartNs;
+    mPrevWindowEndNs = nowNs;
+    mHavePrevWindow = true;
+    startWindow(nowNs);
+  }
+
+  const long long mReportIntervalNs;
+  LogLinearHistogram mIntervalUs;
+  LogLinearHistogram mDelayUs;
+  long long mLastArrivalNs;
+  unsigned long long mLastCaptureUs;
+  long long mBaselineUs = 0;
+  bool mHaveBaseline;
+  long long mWindowStartNs;
+  long long mWindowMinOffsetUs;
+  bool mHavePrevWindow;
+  long long mPrevWindowMinOffsetUs = 0;
+  long long mPrevWindowStartNs = 0;
+  long long mPrevWindowEndNs = 0;
+};
+
+#endif
@@ -2,6 +2,8 @@
 #define GLOBALS_UTILS_H
 
 #include <array>
+#include <atomic>
+#include <functional>
 #include <string>
 
 #include <Bela.h>
@@ -10,7 +12,18 @@
 #include "../qsdk/RTPacket.h"
 #include "../qsdk/RTProtocol.h"
 
+#include "./clock_sync.h"
 #include "./config.h"
+#include "./control_ramp.h"
+#include "./frame_timing.h"
+#include "./marker_tracker.h"
+#include "./sample_buffer.h"
+#include "./sinc_resampler.h"
+#include "./spsc_queue.h"
+#include "./stream_health.h"
+#include "./triple_buffer.h"
+#include "./voice_pool.h"
+#include "./warp_reader.h"
 
 /************************************************/
 /*            NON-USER VARIABLES                */
@@ -49,9 +62,31 @@ bool gBelaButtonPressed = false;
 // record of maximum distance travelled, for debugging.
 std::array<float, NUM_SUBJECTS> gMaxStep{};
 
-// array of size n_subjects x n_history x 3 (x, y, z)
-std::array<std::array<std::array<float, NUM_COORDS>, NUM_SUBJECTS>, NUM_SAMPLES>
-    gPos3D{};
+// array of size n_subjects x 3 (x, y, z)
+using MocapPositions = std::array<std::array<float, NUM_COORDS>, NUM_SUBJECTS>;
+
+// one decoded mocap frame, as handed from the receiver thread to render()
+struct MocapFrame {
+  MocapPositions pos{};
+  // estimated velocity in mm per second, 0 for lost markers (see MarkerTracker)
+  MocapPositions vel{};
+  // QTM frame number and capture timestamp (microseconds)
+  unsigned int frame = 0;
+  unsigned long long timestamp = 0;
+  // when the frame reached the Bela, ns since the epoch (kernel receive timestamp)
+  long long arrival = 0;
+  // how much later than the best case seen the frame arrived, in us (see FrameTimingStats)
+  long long delayUs = 0;
+  // audio frame the frame was captured at, -1 until the clocks are synced (see ClockSync)
+  double sample = -1.0;
+  // markers missing for longer than gGapFillMaxSec (or not seen yet), pos holds their last estimate
+  std::array<bool, NUM_SUBJECTS> lost{};
+};
+
+// latest positions, written by the receiver thread and read wait-free in render()
+TripleBuffer<MocapFrame> gMocapBuffer;
+// positions predicted for the block render() is working on
+MocapPositions gOutputPos{};
 
 // keep track of last step distance for each subject.
 std::array<float, NUM_SUBJECTS> gStepDistance{};
@@ -64,8 +99,15 @@ std::array<float, NUM_SUBJECTS> gFreq{};
 /*                QTM VARIABLES                 */
 /************************************************/
 
-// record of last rendered QTM frame.
-unsigned int gLastFrame = 0;
+// frame sequence checks and counters of the QTM stream, written by the receiver thread.
+StreamHealth gStreamHealth(gStreamHealthWindowSec);
+
+// arrival jitter / delay of the QTM stream, only touched by the receiver thread.
+FrameTimingStats gFrameTiming(gFrameTimingReportSec);
+
+// audio frames elapsed at the start of the current render() block,
+// used to line QTM event labels up with the audio.
+std::atomic<unsigned long long> gAudioFramesElapsed{0};
 
 // QTM protocol
 CRTProtocol* rtProtocol = NULL;
@@ -73,6 +115,11 @@ CRTProtocol* rtProtocol = NULL;
 // QTM communication packet
 CRTPacket* rtPacket = NULL;
 
+// QTM commands from the experiment task, run by the receiver thread between
+// receives (see runOnReceiver in qtm.h). the receiver is the only thread that
+// uses rtProtocol once it's running.
+SpscQueue<std::function<void()>, 64> gProtocolJobs;
+
 // QTM packet type (we want Data Packets (CRTPacket::PacketData).
 CRTPacket::EPacketType packetType;
 
@@ -91,11 +138,20 @@ unsigned short nPort = 0;
 // are we connected to QTM?
 bool gConnected = false;
 
+// cleanup() sets gReceiverStop and waits for the receiver thread to clear
+// gReceiverRunning before it disconnects, so nothing is left inside Receive()
+std::atomic<bool> gReceiverStop{false};
+std::atomic<bool> gReceiverRunning{false};
+
 // are we currently streaming from QTM?
 bool gStreaming = false;
 
 // IDs of corresponding markers will be stored here.
-std::array<int, NUM_SUBJECTS> gSubjMarker{};
+std::array<unsigned int, NUM_SUBJECTS> gSubjMarker{};
+// QTM's camera settings change count gSubjMarker was looked up at
+unsigned int gCameraSettingsChanges = 0;
+// per subject gap filler, updated by the receiver thread
+std::array<MarkerTracker, NUM_SUBJECTS> gMarkerTrackers;
 
 /************************************************/
 /*              AUDIO VARIABLES                 */
@@ -107,6 +163,10 @@ bool gSilence = true;
 // output sample rate
 const float gSampleRate = 44100.0f;
 
+// QTM capture time -> audio frame, fed by render() and the receiver thread,
+// read by the experiment task for the event labels.
+ClockSync gClockSync(gSampleRate, gClockSyncWindowSec, gCaptureToArrivalSec);
+
 // the duration of trials for each condition in samples
 const std::array<float, NUM_TRIALS> gTrialDurationsSamples = {{
   gTrialDurationsSec[0] * gSampleRate,
@@ -154,15 +214,18 @@ const float gTrialEndToneDuration = 2.0f * gSampleRate;
 float gOut;
 
 // the entire undertone file buffer
-std::vector<float> gUndertoneSampleData;
+SampleBuffer gUndertoneSampleData;
 
 // the entire overtone file buffer
-std::vector<float> gOvertoneSampleData;
+SampleBuffer gOvertoneSampleData;
+
+// band-limited sample reader, set up for gResampleTaps
+SincResampler gSincResampler;
 
-// read pointers for the sample output
-float gReadPtrOvertone = 0.0f;
-float gReadPtrUndertone = 0.0f;
-float gReadPtrUndertone2 = 0.0f;
+// the sample voices and their mix: one per subject, then the shared one of the
+// sync condition (gGroupVoice). allocated in setup().
+VoicePool gVoices;
+const unsigned int gGroupVoice = NUM_SUBJECTS;
 
 // the amplitude modulation pointer
 unsigned int gAmpModPtr = 0;
@@ -170,13 +233,11 @@ unsigned int gAmpModPtr = 0;
 // the current amplitude modulation value
 float gAmpMod = 0.0f;
 
-float undertone_sr = 0.0f;
-float overtone_sr = 0.0f;
-float overtone_amp = 0.0f;
-std::array<float, 2> undertone_srs = {{0.0f, 0.0f}};
+// false after silence or a tone, the ramps then start at their targets
+bool gControlsLive = false;
 
 // define Bela aux task to avoid render slowdown.
-AuxiliaryTask gFillBufferTask;
+AuxiliaryTask gMocapReceiverTask;
 AuxiliaryTask gRunExperimentTask;
 
 
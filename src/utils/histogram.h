@@ -0,0 +1,86 @@
+#ifndef HISTOGRAM_UTILS_H
+#define HISTOGRAM_UTILS_H
+
+#include <array>
+#include <cstdint>
+
+// log-linear histogram in fixed memory, nothing is allocated after construction.
+// values below kSubBuckets are counted exactly, above that every power of two
+// is split into kSubBuckets / 2 linear buckets, so a reported value is never
+// more than 2 / kSubBuckets (~3%) above the real one. covers the full uint64 range.
+class LogLinearHistogram {
+public:
+  static constexpr unsigned int kSubBucketBits = 6;
+  static constexpr unsigned int kSubBuckets = 1u << kSubBucketBits;
+  static constexpr unsigned int kHalfSubBuckets = kSubBuckets / 2;
+  static constexpr unsigned int kBucketCount = kSubBuckets + (64 - kSubBucketBits) * kHalfSubBuckets;
+
+  LogLinearHistogram() { reset(); }
+
+  void reset() {
+    mCounts.fill(0);
+    mCount = 0;
+    mMin = UINT64_MAX;
+    mMax = 0;
+  }
+
+  void record(uint64_t value) {
+    ++mCounts[bucketIndex(value)];
+    ++mCount;
+    if (value < mMin) mMin = value;
+    if (value > mMax) mMax = value;
+  }
+
+  void merge(const LogLinearHistogram& other) {
+    for (unsigned int i = 0; i < kBucketCount; i++) mCounts[i] += other.mCounts[i];
+    mCount += other.mCount;
+    if (other.mMin < mMin) mMin = other.mMin;
+    if (other.mMax > mMax) mMax = other.mMax;
+  }
+
+  uint64_t count() const { return mCount; }
+  uint64_t min() const { return mCount ? mMin : 0; }
+  uint64_t max() const { return mMax; }
+
+  // smallest recorded bucket that holds at least p percent of the values.
+  // returns the upper edge of that bucket, capped at the largest value seen.
+  uint64_t percentile(double p) const {
+    if (mCount == 0) return 0;
+    uint64_t rank = (uint64_t)(p / 100.0 * (double)mCount + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > mCount) rank = mCount;
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < kBucketCount; i++) {
+      seen += mCounts[i];
+      if (seen >= rank) {
+        const uint64_t upper = bucketUpperBound(i);
+        return upper < mMax ? upper : mMax;
+      }
+    }
+    return mMax;
+  }
+
+  static unsigned int bucketIndex(uint64_t value) {
+    if (value < kSubBuckets) return (unsigned int)value;
+    const unsigned int msb = 63 - __builtin_clzll(value);
+    const unsigned int shift = msb - kSubBucketBits + 1;
+    const unsigned int mantissa = (unsigned int)(value >> shift) - kHalfSubBuckets;
+    return kSubBuckets + (shift - 1) * kHalfSubBuckets + mantissa;
+  }
+
+  static uint64_t bucketUpperBound(unsigned int index) {
+    if (index < kSubBuckets) return index;
+    const unsigned int shift = (index - kSubBuckets) / kHalfSubBuckets + 1;
+    const uint64_t mantissa = (index - kSubBuckets) % kHalfSubBuckets;
+    const uint64_t lower = (kHalfSubBuckets + mantissa) << shift;
+    return lower + ((uint64_t)1 << shift) - 1;
+  }
+
+private:
+  std::array<uint64_t, kBucketCount> mCounts;
+  uint64_t mCount;
+  uint64_t mMin;
+  uint64_t mMax;
+};
+
+#endif
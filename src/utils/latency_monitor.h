@@ -0,0 +1,152 @@
+#ifndef LATENCY_MONITOR_UTILS_H
+#define LATENCY_MONITOR_UTILS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+
+#include <Bela.h>
+
+#include "./config.h"
+#include "./histogram.h"
+#include "./spsc_queue.h"
+
+// background latency monitor for the frames we actually play. it samples every
+// streamed frame during the session, in microseconds:
+// - delay: QTM capture to arrival at the Bela, above the best case seen (see FrameTimingStats)
+// - pickup: arrival at the Bela to the render() block that picks the frame up
+// - horizon: how far render() extrapolates the positions, per block (see motion_prediction.h)
+// the receiver and render threads only push into a wait-free queue per metric.
+// a low priority aux task drains the queues into histograms and appends one
+// TSV row per metric to the log file every gLatencyMonitorFlushSec.
+class LatencyMonitor {
+public:
+  enum Metric { kDelay = 0, kPickup, kHorizon, kMetricCount };
+
+  LatencyMonitor() : mEnabled(false), mFile(nullptr) {
+    for (auto &dropped : mDropped) dropped = 0;
+  }
+
+  bool enabled() const { return mEnabled.load(std::memory_order_relaxed); }
+  void setEnabled(bool enabled) { mEnabled.store(enabled, std::memory_order_relaxed); }
+
+  // producer side, one thread per metric
+  void record(Metric metric, long long us) {
+    if (!enabled() || us < 0) return;
+    const uint32_t sample = (uint32_t)std::min<long long>(us, UINT32_MAX);
+    if (!mQueues[metric].push(sample)) {
+      mDropped[metric].fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  // consumer side, everything below runs on the monitor task
+  bool open(const std::string &path) {
+    mFile = fopen(path.c_str(), "a");
+    if (!mFile) return false;
+    if (ftell(mFile) == 0) {
+      fprintf(mFile, "time\tmetric\tcount\tdropped\tmin_us\tp50_us\tp99_us\tp99.9_us\tmax_us\n");
+    }
+    return true;
+  }
+
+  void drain() {
+    uint32_t sample;
+    for (unsigned int m = 0; m < kMetricCount; m++) {
+      while (mQueues[m].pop(sample)) mHistograms[m].record(sample);
+    }
+  }
+
+  void flush() {
+    if (!mFile) return;
+    drain();
+    const long long now = (long long)::time(nullptr);
+    for (unsigned int m = 0; m < kMetricCount; m++) {
+      const LogLinearHistogram &h = mHistograms[m];
+      const unsigned long long dropped = mDropped[m].exchange(0, std::memory_order_relaxed);
+      if (h.count() == 0 && dropped == 0) continue;
+      fprintf(mFile, "%lld\t%s\t%llu\t%llu\t%llu\t%llu\t%llu\t%llu\t%llu\n", now, kMetricNames[m],
+              (unsigned long long)h.count(), dropped, (unsigned long long)h.min(),
+              (unsigned long long)h.percentile(50.0), (unsigned long long)h.percentile(99.0),
+              (unsigned long long)h.percentile(99.9), (unsigned long long)h.max());
+      mHistograms[m].reset();
+    }
+    fflush(mFile);
+  }
+
+  void close() {
+    if (!mFile) return;
+    flush();
+    fclose(mFile);
+    mFile = nullptr;
+  }
+
+private:
+  static constexpr const char *kMetricNames[kMetricCount] = {"delay", "pickup", "horizon"};
+
+  std::atomic<bool> mEnabled;
+  std::array<SpscQueue<uint32_t, 4096>, kMetricCount> mQueues;
+  std::array<std::atomic<unsigned long long>, kMetricCount> mDropped;
+  std::array<LogLinearHistogram, kMetricCount> mHistograms;
+  FILE *mFile;
+};
+
+constexpr const char *LatencyMonitor::kMetricNames[];
+
+LatencyMonitor gLatencyMonitor;
+AuxiliaryTask gLatencyMonitorTask;
+
+// wall clock in ns, same clock as the kernel receive timestamps
+long long latency_now_ns() {
+  timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// runs for the whole session at low priority, never touches the audio thread
+void runLatencyMonitor(void *) {
+  const unsigned int drainMicroSec = 100000; // 100ms, well within the queue size at 1kHz
+  const long long flushNs = (long long)(gLatencyMonitorFlushSec * 1e9);
+  long long lastFlush = latency_now_ns();
+  while (!Bela_stopRequested()) {
+    usleep(drainMicroSec);
+    gLatencyMonitor.drain();
+    const long long now = latency_now_ns();
+    if (now - lastFlush >= flushNs) {
+      gLatencyMonitor.flush();
+      lastFlush = now;
+    }
+  }
+  gLatencyMonitor.close();
+}
+
+// switch the monitor on if configured, QTM_LATENCY_MONITOR=1/0 overrides gLatencyMonitorEnabled
+// and QTM_LATENCY_LOG overrides gLatencyLogFile. returns true if it is running.
+bool setupLatencyMonitor() {
+  bool enabled = gLatencyMonitorEnabled;
+  const char *envEnabled = getenv("QTM_LATENCY_MONITOR");
+  if (envEnabled) enabled = strcmp(envEnabled, "0") != 0;
+  if (!enabled) return false;
+
+  const char *envFile = getenv("QTM_LATENCY_LOG");
+  const std::string logFile = envFile ? envFile : gLatencyLogFile;
+  if (!gLatencyMonitor.open(logFile)) {
+    printf("Error: could not open latency log %s\n", logFile.c_str());
+    return false;
+  }
+  if ((gLatencyMonitorTask = Bela_createAuxiliaryTask(&runLatencyMonitor, 10, "latency-monitor")) == 0) {
+    gLatencyMonitor.close();
+    return false;
+  }
+  gLatencyMonitor.setEnabled(true);
+  Bela_scheduleAuxiliaryTask(gLatencyMonitorTask);
+  printf("Latency monitor writing to %s every %.0f s\n", logFile.c_str(), gLatencyMonitorFlushSec);
+  return true;
+}
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef MARKER_TRACKER_UTILS_H
+#define MARKER_TRACKER_UTILS_H
+
+#include <array>
+
+// constant velocity alpha-beta filter for one mocap marker, so a marker that
+// drops out of a few frames keeps moving where it was heading instead of
+// jumping to (0, 0, 0).
+// - a measured frame corrects the prediction by alpha of the error in
+//   position and beta / dt of it in velocity.
+// - a dropped frame coasts on the last velocity for up to maxGapSec after the
+//   last measurement. after that the marker is lost: the estimate stays where
+//   it was with zero velocity until the marker is measured again, which starts
+//   the filter over.
+// the estimate of every frame is kept in a ring of kHistory entries, so position
+// and velocity can be read for any time: interpolated within the history and
+// extrapolated past it. nothing is allocated, times are QTM timestamps in us.
+class MarkerTracker {
+public:
+  enum class State { kIdle, kTracking, kFilling, kLost };
+  static constexpr unsigned int kHistory = 32; // power of two
+
+  MarkerTracker() { setup(0.85f, 0.3f, 0.1f); }
+
+  // set the gains and forget the marker, e.g. when a new stream starts
+  void setup(float alpha, float beta, float maxGapSec) {
+    mAlpha = alpha;
+    mBeta = beta;
+    mMaxGapUs = (unsigned long long)(maxGapSec * 1e6f);
+    reset();
+  }
+
+  void reset() {
+    mState = State::kIdle;
+    mTimeUs = 0;
+    mMeasuredUs = 0;
+    mPos.fill(0.0f);
+    mVel.fill(0.0f);
+    mNewest = 0;
+    mCount = 0;
+  }
+
+  // one frame at timeUs, xyz is only read if valid. returns the state after it.
+  State update(unsigned long long timeUs, const float *xyz, bool valid) {
+    // a new stream or looping RT playback goes back in time
+    if (mState != State::kIdle && timeUs <= mTimeUs) reset();
+
+    if (valid && (mState == State::kIdle || mState == State::kLost || timeUs - mMeasuredUs > mMaxGapUs)) {
+      // nothing recent to filter against
+      mState = State::kTracking;
+      mPos = {{xyz[0], xyz[1], xyz[2]}};
+      mVel.fill(0.0f);
+      mMeasuredUs = timeUs;
+    } else if (valid) {
+      const float dt = (timeUs - mTimeUs) * 1e-6f;
+      // after a filled gap the error built up over the whole gap
+      const float sinceMeasured = (timeUs - mMeasuredUs) * 1e-6f;
+      for (unsigned int k = 0; k < 3; k++) {
+        const float predicted = mPos[k] + mVel[k] * dt;
+        const float residual = xyz[k] - predicted;
+        mPos[k] = predicted + mAlpha * residual;
+        mVel[k] += mBeta / sinceMeasured * residual;
+      }
+      mState = State::kTracking;
+      mMeasuredUs = timeUs;
+    } else if (mState == State::kIdle) {
+      // never seen, nothing to fill with
+      return mState;
+    } else if (timeUs - mMeasuredUs > mMaxGapUs) {
+      mState = State::kLost;
+      mVel.fill(0.0f);
+    } else {
+      const float dt = (timeUs - mTimeUs) * 1e-6f;
+      for (unsigned int k = 0; k < 3; k++) mPos[k] += mVel[k] * dt;
+      mState = State::kFilling;
+    }
+    mTimeUs = timeUs;
+    push();
+    return mState;
+  }
+
+  State state() const { return mState; }
+  const std::array<float, 3> &position() const { return mPos; }
+  const std::array<float, 3> &velocity() const { return mVel; }
+  // timestamp of the last frame the marker was measured in
+  unsigned long long lastMeasured() const { return mMeasuredUs; }
+
+  // estimate for timeUs in pos and vel (units per second), false if the marker
+  // hasn't been seen yet. before the history the oldest estimate is returned.
+  bool predict(unsigned long long timeUs, float *pos, float *vel) const {
+    if (mCount == 0) return false;
+    if (timeUs >= mTimeUs) {
+      const float dt = (timeUs - mTimeUs) * 1e-6f;
+      for (unsigned int k = 0; k < 3; k++) {
+        pos[k] = mPos[k] + mVel[k] * dt;
+        vel[k] = mVel[k];
+      }
+      return true;
+    }
+    // walk back to the two estimates around timeUs
+    const Estimate *later = &mHistory[mNewest];
+    for (unsigned int i = 1; i < mCount; i++) {
+      const Estimate &earlier = mHistory[(mNewest - i) & (kHistory - 1)];
+      if (earlier.timeUs <= timeUs) {
+        const float t = (float)(timeUs - earlier.timeUs) / (float)(later->timeUs - earlier.timeUs);
+        for (unsigned int k = 0; k < 3; k++) {
+          pos[k] = earlier.pos[k] + (later->pos[k] - earlier.pos[k]) * t;
+          vel[k] = earlier.vel[k] + (later->vel[k] - earlier.vel[k]) * t;
+        }
+        return true;
+      }
+      later = &earlier;
+    }
+    for (unsigned int k = 0; k < 3; k++) {
+      pos[k] = later->pos[k];
+      vel[k] = later->vel[k];
+    }
+    return true;
+  }
+
+private:
+  struct Estimate {
+    unsigned long long timeUs;
+    std::array<float, 3> pos;
+    std::array<float, 3> vel;
+  };
+
+  void push() {
+    mNewest = (mNewest + 1) & (kHistory - 1);
+    mHistory[mNewest] = {mTimeUs, mPos, mVel};
+    if (mCount < kHistory) mCount++;
+  }
+
+  float mAlpha;
+  float mBeta;
+  unsigned long long mMaxGapUs;
+  State mState;
+  unsigned long long mTimeUs;
+  unsigned long long mMeasuredUs;
+  std::array<float, 3> mPos;
+  std::array<float, 3> mVel;
+  std::array<Estimate, kHistory> mHistory;
+  unsigned int mNewest;
+  unsigned int mCount;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef MOTION_PREDICTION_UTILS_H
+#define MOTION_PREDICTION_UTILS_H
+
+#include <algorithm>
+
+#include "./config.h"
+#include "./globals.h"
+#include "./latency_monitor.h"
+
+// the positions in a mocap frame are already old when the frame is picked up,
+// and the block being rendered is only heard later still. to take that lag out
+// of the sound the subjects are moved along their estimated velocity by the
+// prediction horizon: the time from capture to the block reaching the DAC.
+// - once the clocks are synced (see ClockSync), the frame's capture sample to
+//   the end of the block
+// - until then, gCaptureToArrivalSec plus how much later than the best case
+//   this frame arrived (measured by FrameTimingStats), arrival to now from the
+//   kernel receive timestamp, and one block
+// plus gOutputLatencySec for the codec. the horizon is clamped to
+// gPredictionMaxSec. render thread only.
+
+// horizon in seconds for frame when rendering the block in context
+float prediction_horizon(const MocapFrame &frame, const BelaContext *context) {
+  float horizonSec = gOutputLatencySec;
+  if (frame.sample >= 0.0) {
+    const double blockEnd = (double)(context->audioFramesElapsed + context->audioFrames);
+    horizonSec += (float)((blockEnd - frame.sample) / context->audioSampleRate);
+  } else {
+    horizonSec += gCaptureToArrivalSec + frame.delayUs * 1e-6f + context->audioFrames / context->audioSampleRate;
+    const long long nowNs = latency_now_ns();
+    if (frame.arrival > 0 && nowNs > frame.arrival) horizonSec += (nowNs - frame.arrival) * 1e-9f;
+  }
+  return std::max(0.0f, std::min(horizonSec, gPredictionMaxSec));
+}
+
+// positions of frame extrapolated by horizonSec
+void predict_positions(const MocapFrame &frame, float horizonSec, MocapPositions &pos) {
+  for (unsigned int i = 0; i < NUM_SUBJECTS; i++) {
+    for (unsigned int k = 0; k < NUM_COORDS; k++) {
+      pos[i][k] = frame.pos[i][k] + frame.vel[i][k] * horizonSec;
+    }
+  }
+}
+
+// positions to sonify in the current block, reports the horizon to the latency monitor
+const MocapPositions &output_positions(const MocapFrame &frame, const BelaContext *context, MocapPositions &pos) {
+  // nothing is sonified while silent or playing a tone
+  if (!gPredictToOutput || gSilence || startTonePlaying || endTonePlaying) return frame.pos;
+  const float horizonSec = prediction_horizon(frame, context);
+  predict_positions(frame, horizonSec, pos);
+  gLatencyMonitor.record(LatencyMonitor::kHorizon, (long long)(horizonSec * 1e6f));
+  return pos;
+}
+
+#endif
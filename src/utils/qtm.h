@@ -1,45 +1,95 @@
 #ifndef QTM_UTILS_H
 #define QTM_UTILS_H
 
+#include <array>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+
+#include <Bela.h>
+
 #include "../qsdk/RTPacket.h"
 #include "../qsdk/RTProtocol.h"
 
+#include "./globals.h"
+
 template<typename E>
 constexpr auto toUnderlyingType(E e) 
 {
     return static_cast<typename std::underlying_type<E>::type>(e);
 }
 
+// the protocol object isn't thread safe: its sockets, stream buffer and
+// packets belong to whichever thread is inside Receive(). the receiver thread
+// is the only one that talks to QTM once it's running, the experiment task
+// hands it commands as jobs. experiment task only, it's the one producer.
+bool postToReceiver(const std::function<void()> &job) {
+  if (!gProtocolJobs.push(job)) {
+    printf("Error: too many QTM commands queued, dropping one.\n");
+    return false;
+  }
+  return true;
+}
+
+// runs job on the receiver thread and waits for its result, for the commands
+// the experiment has to wait for. false if the program stops first.
+// experiment task only.
+bool runOnReceiver(const std::function<bool()> &job) {
+  const auto result = std::make_shared<std::promise<bool>>();
+  std::future<bool> done = result->get_future();
+  if (!postToReceiver([job, result] { result->set_value(job()); })) return false;
+  while (done.wait_for(std::chrono::milliseconds(10)) != std::future_status::ready) {
+    if (Bela_stopRequested() || gReceiverStop) return false;
+  }
+  return done.get();
+}
+
+// the queued commands, in order. receiver thread only.
+void runProtocolJobs() {
+  std::function<void()> job;
+  while (gProtocolJobs.pop(job)) job();
+}
 
+
+// queue an event label in QTM without waiting for the response, so trial timing
+// isn't held up by the network. the receiver thread sends it and picks up the
+// response. experiment task only, it is the one reader of gClockSync.latest().
 template<typename E>
-constexpr bool sendEventLabel(CRTProtocol* rtProtocol, E pLabel) 
+void sendEventLabel(CRTProtocol* rtProtocol, E pLabel) 
 {
-  const char label = toUnderlyingType(pLabel);
-  const char* labelPtr = &label;
-  const bool result = rtProtocol->SetQTMEvent(labelPtr);
-  if (!result) {
-    const char* errorStr = rtProtocol->GetErrorString();
-    printf("Error sending event label (%c): %s\n", label, errorStr);
-  }
-  return result;
+  const char label[2] = { static_cast<char>(toUnderlyingType(pLabel)), '\0' };
+  // where in the audio the label was issued, for lining labels up in analysis
+  const unsigned long long audioFrame = gAudioFramesElapsed.load(std::memory_order_relaxed);
+  // and where that is on the QTM clock, once there's a stream to tell
+  char qtmTime[40] = "";
+  const ClockMap &clock = gClockSync.latest();
+  if (clock.valid) snprintf(qtmTime, sizeof(qtmTime), " (QTM time %.6f s)", clock.toCaptureUs((double)audioFrame) * 1e-6);
+  printf("Event label (%c) issued at audio frame %llu%s\n", label[0], audioFrame, qtmTime);
+  const char code = label[0];
+  postToReceiver([rtProtocol, code, audioFrame] {
+    const char label[2] = { code, '\0' };
+    rtProtocol->SetQTMEventAsync(label, [code, audioFrame](const CRTProtocol::SCommandResult& result) {
+      if (!result.bSuccess) {
+        printf("Error sending event label (%c): %s\n", code, result.response.c_str());
+        return;
+      }
+      const double roundTripMs = std::chrono::duration<double, std::milli>(result.responseTime - result.issueTime).count();
+      printf("Event label (%c) set, issued at audio frame %llu, round trip %.2f ms\n", code, audioFrame, roundTripMs);
+    });
+  });
 }
 
+// look the subject markers up in the label index built by Read3DSettings.
+// gSubjMarker only changes when all of them are found.
 bool reindexMarkers(CRTProtocol* rtProtocol) {
+  std::array<unsigned int, NUM_SUBJECTS> markers{};
   unsigned int markersFound = 0;
-  // number of labelled markers
-  const unsigned int nLabels = rtProtocol->Get3DLabeledMarkerCount();
-  // printf("Found labels: \n");
-  // loop through labels to find ones we are interested in.
-  for (unsigned int i = 0; i < nLabels; i++) {
-    const char *cLabelName = rtProtocol->Get3DLabelName(i);
-    // printf("- %s\n", cLabelName);
-    for (unsigned int j = 0; j < NUM_SUBJECTS; j++) {
-      // if the label is one of our specified markers, keep the ID.
-      if (cLabelName == gSubjMarkerLabels[j]) {
-        printf("Found marker: %s id: %d\n", cLabelName, i);
-        gSubjMarker[j] = i;
-        markersFound++;
-      }
+  for (unsigned int j = 0; j < NUM_SUBJECTS; j++) {
+    // if the label is one of our specified markers, keep the ID.
+    if (rtProtocol->Get3DLabelIndex(gSubjMarkerLabels[j], markers[j])) {
+      printf("Found marker: %s id: %u\n", gSubjMarkerLabels[j].c_str(), markers[j]);
+      markersFound++;
     }
   }
   // if we didn't find all the markers, return false.
@@ -47,9 +97,26 @@ bool reindexMarkers(CRTProtocol* rtProtocol) {
     printf("Error: not all markers found.\n");
     return false;
   }
+  gSubjMarker = markers;
   return true;
 }
 
+// marker IDs only change with QTM's settings, e.g. when labels are edited or
+// RT playback switches files. re-read the labels once QTM reports a change.
+// receiver thread only, like every command (see runOnReceiver), so the read
+// can't interleave with the experiment's own settings reads and stream
+// commands. frames wait for the round trip, it only happens on a change.
+void refreshMarkerIndices(CRTProtocol* rtProtocol) {
+  const unsigned int changes = rtProtocol->GetCameraSettingsChangeCount();
+  if (changes == gCameraSettingsChanges) return;
+  gCameraSettingsChanges = changes;
+  printf("QTM settings changed, reindexing markers.\n");
+  bool dataAvailable;
+  if (!rtProtocol->Read3DSettings(dataAvailable) || !reindexMarkers(rtProtocol)) {
+    printf("Reindexing failed, keeping the previous marker IDs.\n");
+  }
+}
+
 // wrapper to retrieve latest QTM 3d packet
 bool get3DPacket(CRTProtocol* rtProtocol, CRTPacket*& rtPacket, CRTPacket::EPacketType& packetType) {
   // if stream is not open, or we're silenced, don't do anything
@@ -57,7 +124,10 @@ bool get3DPacket(CRTProtocol* rtProtocol, CRTPacket*& rtPacket, CRTPacket::EPack
     return false;
   }
   // Ask QTM for latest packet.
-  if (rtProtocol->Receive(packetType, true, gPacketTimeoutMicroSec) != CNetwork::ResponseType::success) {
+  const CNetwork::ResponseType response = (gStreamUDP && gCoalesceUDPFrames)
+    ? rtProtocol->ReceiveLatest(packetType, true, gPacketTimeoutMicroSec)
+    : rtProtocol->Receive(packetType, true, gPacketTimeoutMicroSec);
+  if (response != CNetwork::ResponseType::success) {
     printf("Problem reading data...\n");
     // print error
     const char* errorStr = rtProtocol->GetErrorString();
@@ -74,12 +144,26 @@ bool get3DPacket(CRTProtocol* rtProtocol, CRTPacket*& rtPacket, CRTPacket::EPack
   }
 }
 
-bool startCapture(CRTProtocol* rtProtocol) {
-  return rtProtocol->StartCapture();
+void printCaptureResult(const char* action, const CRTProtocol::SCommandResult& result) {
+  if (!result.bSuccess) {
+    printf("Error: QTM capture %s failed: %s\n", action, result.response.c_str());
+  }
+}
+
+void startCapture(CRTProtocol* rtProtocol) {
+  postToReceiver([rtProtocol] {
+    rtProtocol->StartCaptureAsync([](const CRTProtocol::SCommandResult& result) {
+      printCaptureResult("start", result);
+    });
+  });
 }
 
-bool stopCapture(CRTProtocol* rtProtocol) {
-  return rtProtocol->StopCapture();
+void stopCapture(CRTProtocol* rtProtocol) {
+  postToReceiver([rtProtocol] {
+    rtProtocol->StopCaptureAsync([](const CRTProtocol::SCommandResult& result) {
+      printCaptureResult("stop", result);
+    });
+  });
 }
 
 #endif
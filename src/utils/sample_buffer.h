@@ -0,0 +1,64 @@
+#ifndef SAMPLE_BUFFER_UTILS_H
+#define SAMPLE_BUFFER_UTILS_H
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// fastest playback rate the readers take, faster rates are clamped to it
+const float kWarpMaxRate = 4.0f;
+
+// count floats in storage starting at a 64 byte boundary, for the vector code
+inline float *aligned_floats(std::vector<float> &storage, const size_t count) {
+  const size_t alignFloats = 16;
+  storage.assign(count + alignFloats, 0.0f);
+  const uintptr_t address = (uintptr_t)storage.data();
+  const uintptr_t alignBytes = alignFloats * sizeof(float);
+  return storage.data() + ((alignBytes - address % alignBytes) % alignBytes) / sizeof(float);
+}
+
+// a looped sample in memory for the readers in warp_reader.h and
+// sinc_resampler.h. the end of the sample is copied before its start and the
+// start again after its end (the guard), so a reader can run past the end for
+// a whole block without wrapping, and the samples around the read position
+// are always there to interpolate with. the data is 64 byte aligned. fill it
+// in setup(), nothing is allocated after that.
+class SampleBuffer {
+public:
+  // the widest interpolation reads kMaxTaps samples around the read position,
+  // kMaxTaps / 2 - 1 of them before it
+  static const unsigned int kMaxTaps = 32;
+  // before the start, a multiple of 16 to keep the start aligned
+  static const unsigned int kLeadFrames = kMaxTaps / 2;
+
+  SampleBuffer() = default;
+  SampleBuffer(const SampleBuffer &) = delete;
+  SampleBuffer &operator=(const SampleBuffer &) = delete;
+
+  // copies samples, with a guard for reads of up to blockFrames at a time
+  void load(const std::vector<float> &samples, unsigned int blockFrames) {
+    mLength = (unsigned int)samples.size();
+    mGuard = (unsigned int)ceilf(blockFrames * kWarpMaxRate) + kMaxTaps / 2 + 1;
+    mData = aligned_floats(mStorage, kLeadFrames + mLength + mGuard) + kLeadFrames;
+    if (mLength == 0) return;
+    for (unsigned int i = 0; i < mLength; i++) mData[i] = samples[i];
+    // the loop carries on either side, however short the sample
+    for (unsigned int i = 1; i <= kLeadFrames; i++) mData[-(int)i] = samples[mLength - 1 - (i - 1) % mLength];
+    for (unsigned int i = 0; i < mGuard; i++) mData[mLength + i] = samples[i % mLength];
+  }
+
+  const float *data() const { return mData; }
+  // frames of the sample itself, without the guard
+  unsigned int length() const { return mLength; }
+  // frames a reader can go at kWarpMaxRate before it has to wrap
+  unsigned int maxReadFrames() const { return empty() ? 0 : (unsigned int)((mGuard - kMaxTaps / 2 - 1) / kWarpMaxRate); }
+  bool empty() const { return mLength == 0; }
+
+private:
+  std::vector<float> mStorage;
+  float *mData = nullptr;
+  unsigned int mLength = 0;
+  unsigned int mGuard = 0;
+};
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef SINC_RESAMPLER_UTILS_H
+#define SINC_RESAMPLER_UTILS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "./sample_buffer.h"
+#include "./warp_reader.h"
+
+// band-limited variable rate reader for a SampleBuffer: windowed sinc
+// interpolation from polyphase tables, for pitch shifts that don't alias like
+// the linear interpolation of warp_read_block does when the sample is played
+// faster. the same positions and loop point fade as warp_read_block.
+//
+// the filter cutoff has to come down with the playback rate. the tables are
+// built in setup() for bands of rates a quarter octave apart up to
+// kWarpMaxRate, and every block takes the band of its fastest rate, so the
+// cutoff is within a quarter octave below the output's nyquist frequency.
+// each table has kPhases + 1 rows of taps coefficients for the positions
+// between two samples, the rows for positions in between are interpolated.
+// taps is the quality level: 8, 16 or 32 taps.
+class SincResampler {
+public:
+  static const unsigned int kPhaseBits = 7;
+  static const unsigned int kPhases = 1 << kPhaseBits;
+  // bands of rates up to 1, 2^(1/4), 2^(2/4) ... kWarpMaxRate
+  static const unsigned int kBandsPerOctave = 4;
+  static const unsigned int kBands = 2 * kBandsPerOctave + 1;
+
+  // builds the tables, false if there is no quality level for taps
+  bool setup(const unsigned int taps) {
+    float beta, rolloff;
+    switch (taps) {
+      // kaiser window shape and the cutoff as a fraction of the band's nyquist
+      // frequency, the shorter filters need the room for their transition
+      case 8: beta = 3.5f; rolloff = 0.65f; break;
+      case 16: beta = 5.0f; rolloff = 0.80f; break;
+      case 32: beta = 9.0f; rolloff = 0.85f; break;
+      default: return false;
+    }
+    static_assert(32 <= SampleBuffer::kMaxTaps, "the sample guard doesn't cover 32 taps");
+    mTaps = taps;
+    mRowSize = 2 * taps;
+    mTables = aligned_floats(mStorage, (size_t)kBands * (kPhases + 1) * mRowSize);
+
+    const double half = taps / 2.0;
+    std::vector<double> row(taps);
+    for (unsigned int b = 0; b < kBands; b++) {
+      mBandRates[b] = (float)bandRate(b);
+      // cutoff in cycles per input sample
+      const double cutoff = 0.5 * rolloff / bandRate(b);
+      for (unsigned int p = 0; p <= kPhases; p++) {
+        const double frac = (double)p / kPhases;
+        double sum = 0.0;
+        for (unsigned int k = 0; k < taps; k++) {
+          // tap k is sample i - taps / 2 + 1 + k for position i + frac
+          const double t = (double)k - (half - 1.0) - frac;
+          const double x = 2.0 * cutoff * t;
+          const double sinc = x == 0.0 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+          const double u = t / half;
+          const double window = fabs(u) >= 1.0 ? 0.0 : besselI0(beta * sqrt(1.0 - u * u)) / besselI0(beta);
+          row[k] = sinc * window;
+          sum += row[k];
+        }
+        // unity gain at dc for every position
+        float *coefficients = mTables + ((size_t)b * (kPhases + 1) + p) * mRowSize;
+        for (unsigned int k = 0; k < taps; k++) coefficients[k] = (float)(row[k] / sum);
+      }
+      // the step to the next row, to interpolate between them
+      for (unsigned int p = 0; p <= kPhases; p++) {
+        float *coefficients = mTables + ((size_t)b * (kPhases + 1) + p) * mRowSize;
+        for (unsigned int k = 0; k < taps; k++) {
+          coefficients[taps + k] = p < kPhases ? coefficients[mRowSize + k] - coefficients[k] : 0.0f;
+        }
+      }
+    }
+    return true;
+  }
+
+  unsigned int taps() const { return mTaps; }
+
+  // the quarter octave band for playback rates up to rate
+  unsigned int band(const float rate) const {
+    unsigned int b = 0;
+    while (b + 1 < kBands && mBandRates[b] < rate) b++;
+    return b;
+  }
+
+  // reads frames samples from buffer at phase, at the playback rate of each
+  // output sample in rates, into out, and moves phase on. the rates are
+  // expected to be a ramp (or constant), the first and last give the band.
+  void read(const SampleBuffer &buffer, WarpPhase &phase, const float *rates, float *out,
+            const unsigned int frames) const {
+    if (frames == 0) return;
+    const unsigned int kChunk = 64;
+    const float *sample = buffer.data();
+    const unsigned int length = buffer.length();
+    const unsigned int segment = buffer.maxReadFrames();
+    const WarpPhase end = (WarpPhase)length << 32;
+    const float *table = mTables + (size_t)band(std::max(rates[0], rates[frames - 1])) * (kPhases + 1) * mRowSize;
+    const int32_t lead = (int32_t)mTaps / 2 - 1;
+    const int32_t phaseShift = 24 - kPhaseBits;
+    const float phaseFracScale = 1.0f / (float)(1 << phaseShift);
+    int32_t is[kChunk];
+    int32_t fracBits[kChunk];
+    unsigned int n = 0;
+    while (n < frames) {
+      if (n % segment == 0) warp_wrap(phase, end);
+      const unsigned int chunk = std::min(std::min(kChunk, frames - n), segment - n % segment);
+      warp_positions(phase, rates + n, is, fracBits, chunk);
+      for (unsigned int m = 0; m < chunk; m++) {
+        const float *row = table + (size_t)(fracBits[m] >> phaseShift) * mRowSize;
+        const float rowFrac = (float)(fracBits[m] & ((1 << phaseShift) - 1)) * phaseFracScale;
+        const float value = dot(sample + is[m] - lead, row, rowFrac);
+        const float x = warp_position(is[m], (float)fracBits[m] * kWarpFracScale, length);
+        out[n + m] = value * warp_fade(x, length, rates[n + m]);
+      }
+      n += chunk;
+    }
+  }
+
+private:
+  static double bandRate(const unsigned int b) { return pow(2.0, (double)b / kBandsPerOctave); }
+
+  // zeroth order modified bessel function of the first kind, for the kaiser window
+  static double besselI0(const double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50 && term > 1e-12 * sum; k++) {
+      term *= (x / (2.0 * k)) * (x / (2.0 * k));
+      sum += term;
+    }
+    return sum;
+  }
+
+  // the taps samples from s weighted with the row's coefficients, moved
+  // rowFrac of the way to the next row's
+  float dot(const float *s, const float *row, const float rowFrac) const {
+    const float *steps = row + mTaps;
+#if defined(WARP_READER_NEON)
+    float32x4_t sum = vdupq_n_f32(0.0f);
+    for (unsigned int k = 0; k < mTaps; k += 4) {
+      const float32x4_t coefficients = vmlaq_n_f32(vld1q_f32(row + k), vld1q_f32(steps + k), rowFrac);
+      sum = vmlaq_f32(sum, vld1q_f32(s + k), coefficients);
+    }
+    const float32x2_t halves = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+    return vget_lane_f32(vpadd_f32(halves, halves), 0);
+#elif defined(WARP_READER_SSE2) || defined(WARP_READER_AVX2)
+    const __m128 frac = _mm_set1_ps(rowFrac);
+    __m128 sum = _mm_setzero_ps();
+    for (unsigned int k = 0; k < mTaps; k += 4) {
+      const __m128 coefficients = _mm_add_ps(_mm_load_ps(row + k), _mm_mul_ps(_mm_load_ps(steps + k), frac));
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(s + k), coefficients));
+    }
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+#else
+    float sum = 0.0f;
+    for (unsigned int k = 0; k < mTaps; k++) sum += s[k] * (row[k] + steps[k] * rowFrac);
+    return sum;
+#endif
+  }
+
+  std::vector<float> mStorage;
+  float *mTables = nullptr;
+  unsigned int mTaps = 0;
+  unsigned int mRowSize = 0;
+  float mBandRates[kBands] = {};
+};
+
+#endif
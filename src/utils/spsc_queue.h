@@ -0,0 +1,42 @@
+#ifndef SPSC_QUEUE_UTILS_H
+#define SPSC_QUEUE_UTILS_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// bounded lock-free single-producer / single-consumer queue in fixed memory.
+// push() never blocks or allocates, so it is safe to call from render();
+// when the queue is full the new value is refused and push() returns false.
+template<typename T, size_t N>
+class SpscQueue {
+  static_assert(N && !(N & (N - 1)), "SpscQueue size must be a power of two");
+public:
+  SpscQueue() : mHead(0), mTail(0) {}
+
+  // producer
+  bool push(const T& value) {
+    const size_t tail = mTail.load(std::memory_order_relaxed);
+    if (tail - mHead.load(std::memory_order_acquire) == N) return false;
+    mItems[tail & (N - 1)] = value;
+    mTail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer
+  bool pop(T& value) {
+    const size_t head = mHead.load(std::memory_order_relaxed);
+    if (head == mTail.load(std::memory_order_acquire)) return false;
+    value = mItems[head & (N - 1)];
+    mHead.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  std::array<T, N> mItems;
+  // read and written by different threads, keep them on separate cache lines
+  alignas(64) std::atomic<size_t> mHead;
+  alignas(64) std::atomic<size_t> mTail;
+};
+
+#endif
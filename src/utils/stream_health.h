@@ -0,0 +1,163 @@
+#ifndef STREAM_HEALTH_UTILS_H
+#define STREAM_HEALTH_UTILS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+// sequence check of the mocap stream by QTM frame number, fed by the receiver
+// thread with every data frame. each frame is one of
+// - in order: the next frame (QTM steps by its frequency divisor, taken as the
+//   smallest step seen)
+// - gap: frames are missing that the receiver didn't skip itself, i.e. they
+//   were lost on the network (or QTM didn't send them)
+// - duplicate: the same frame number again
+// - reorder: a frame older than the newest one, by at most kReorderWindow steps.
+//   it was counted as lost when the frame after it came in first.
+// - restart: further back than that, or kRestartAfter older frames in a row,
+//   e.g. looping RT playback
+// stale frames the receiver skipped to catch up (see ReceiveLatest) are counted
+// apart from the lost ones: those come from our own scheduling, lost ones from
+// the network, and QTM's drop rates from the cameras.
+// after restart() the sequence only starts with the first frame that arrived
+// once we were reading again, as the socket drops what doesn't fit in it while
+// nobody is reading.
+// the counters only ever go up and can be read from any thread, the rates per
+// second over the last completed window of stream time as well.
+class StreamHealth {
+public:
+  enum class FrameClass { kInOrder, kGap, kDuplicate, kReorder, kRestart };
+  enum Counter { kFrames, kGaps, kLost, kDuplicates, kReorders, kRestarts, kSkipped, kCounterCount };
+  static constexpr int kReorderWindow = 64;
+  static constexpr unsigned int kRestartAfter = 3;
+
+  explicit StreamHealth(float windowSec) : mWindowUs((unsigned long long)(windowSec * 1e6f)) {
+    for (auto &count : mCounts) count.store(0, std::memory_order_relaxed);
+    for (auto &rate : mRates) rate.store(0.0f, std::memory_order_relaxed);
+    restart(0);
+  }
+
+  // a new stream or reading again after a pause at resumeNs (wall clock),
+  // forget the sequence but keep the counters
+  void restart(long long resumeNs) {
+    mResumeNs = resumeNs;
+    mResync = true;
+    mOlderInRow = 0;
+    mStep = 0;
+    mWindowStartUs = 0;
+  }
+
+  // receiver thread: one data frame, captured at timeUs and received at arrivalNs
+  // (0 if unknown). discarded is the protocol's running count of skipped stale
+  // frames, the rates are the ones QTM puts in the 3D component.
+  FrameClass record(unsigned int frame, unsigned long long timeUs, long long arrivalNs, unsigned long long discarded,
+                    unsigned short qtmDropRate, unsigned short qtmOutOfSyncRate) {
+    mQtmDropRate.store(qtmDropRate, std::memory_order_relaxed);
+    mQtmOutOfSyncRate.store(qtmOutOfSyncRate, std::memory_order_relaxed);
+    const unsigned int skipped = (unsigned int)(discarded - mLastDiscarded);
+    mLastDiscarded = discarded;
+    add(kFrames, 1);
+    add(kSkipped, skipped);
+
+    if (mResync) {
+      mLastFrame = frame;
+      // without an arrival time, a frame read without skipping any is a fresh one
+      mResync = arrivalNs > 0 ? arrivalNs < mResumeNs : skipped > 0;
+      startWindow(timeUs);
+      return FrameClass::kInOrder;
+    }
+
+    FrameClass frameClass = FrameClass::kInOrder;
+    const int delta = (int)(frame - mLastFrame);
+    if (delta == 0) {
+      frameClass = FrameClass::kDuplicate;
+    } else if (delta < 0 && delta >= -kReorderWindow * (int)(mStep ? mStep : 1) && ++mOlderInRow < kRestartAfter) {
+      frameClass = FrameClass::kReorder;
+    } else if (delta < 0) {
+      frameClass = FrameClass::kRestart;
+      mStep = 0;
+      mWindowStartUs = 0;
+    } else {
+      if (mStep == 0 || (unsigned int)delta < mStep) mStep = (unsigned int)delta;
+      const unsigned int missing = (unsigned int)delta / mStep - 1;
+      if (missing > skipped) {
+        frameClass = FrameClass::kGap;
+        add(kGaps, 1);
+        add(kLost, missing - skipped);
+      }
+    }
+    if (frameClass != FrameClass::kReorder) mOlderInRow = 0;
+    if (frameClass == FrameClass::kDuplicate) add(kDuplicates, 1);
+    if (frameClass == FrameClass::kReorder) add(kReorders, 1);
+    if (frameClass == FrameClass::kRestart) add(kRestarts, 1);
+    // late frames don't move the sequence on
+    if (frameClass != FrameClass::kDuplicate && frameClass != FrameClass::kReorder) {
+      mLastFrame = frame;
+      updateWindow(timeUs);
+    }
+    return frameClass;
+  }
+
+  // any thread
+  uint32_t count(Counter counter) const { return mCounts[counter].load(std::memory_order_relaxed); }
+  // per second over the last completed window, any thread
+  float rate(Counter counter) const { return mRates[counter].load(std::memory_order_relaxed); }
+  unsigned short qtmDropRate() const { return mQtmDropRate.load(std::memory_order_relaxed); }
+  unsigned short qtmOutOfSyncRate() const { return mQtmOutOfSyncRate.load(std::memory_order_relaxed); }
+
+  void printTotals() const {
+    printf("Stream health so far: %u frames, %u lost in %u gaps, %u duplicates, %u out of order, %u restarts\n",
+           count(kFrames), count(kLost), count(kGaps), count(kDuplicates), count(kReorders), count(kRestarts));
+  }
+
+private:
+  void add(Counter counter, uint32_t n) {
+    // single writer, a plain load and store is enough
+    mCounts[counter].store(mCounts[counter].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  void updateWindow(unsigned long long timeUs) {
+    if (mWindowStartUs == 0 || timeUs < mWindowStartUs) {
+      startWindow(timeUs);
+      return;
+    }
+    if (mWindowUs == 0 || timeUs - mWindowStartUs < mWindowUs) return;
+    const float windowSec = (timeUs - mWindowStartUs) * 1e-6f;
+    std::array<uint32_t, kCounterCount> inWindow;
+    for (int i = 0; i < kCounterCount; i++) {
+      inWindow[i] = count((Counter)i) - mWindowCounts[i];
+      mRates[i].store(inWindow[i] / windowSec, std::memory_order_relaxed);
+    }
+    // only say something when frames went missing on the way or the cameras dropped some
+    if (inWindow[kLost] || inWindow[kDuplicates] || inWindow[kReorders] || qtmDropRate() || qtmOutOfSyncRate()) {
+      printf("Stream health over %.1f s: %u frames, %u lost in %u gaps, %u duplicates, %u out of order, "
+             "%u skipped as stale, QTM drop rate %u, out of sync rate %u\n",
+             windowSec, inWindow[kFrames], inWindow[kLost], inWindow[kGaps], inWindow[kDuplicates],
+             inWindow[kReorders], inWindow[kSkipped], qtmDropRate(), qtmOutOfSyncRate());
+    }
+    startWindow(timeUs);
+  }
+
+  void startWindow(unsigned long long timeUs) {
+    mWindowStartUs = timeUs;
+    for (int i = 0; i < kCounterCount; i++) mWindowCounts[i] = count((Counter)i);
+  }
+
+  const unsigned long long mWindowUs;
+  long long mResumeNs;
+  bool mResync;
+  unsigned int mLastFrame = 0;
+  unsigned int mStep;
+  unsigned int mOlderInRow = 0;
+  unsigned long long mLastDiscarded = 0;
+  unsigned long long mWindowStartUs;
+  std::array<uint32_t, kCounterCount> mWindowCounts{};
+  // uint32_t and float so they stay lock-free on 32-bit ARM
+  std::array<std::atomic<uint32_t>, kCounterCount> mCounts;
+  std::array<std::atomic<float>, kCounterCount> mRates;
+  std::atomic<unsigned short> mQtmDropRate{0};
+  std::atomic<unsigned short> mQtmOutOfSyncRate{0};
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef TRIPLE_BUFFER_UTILS_H
+#define TRIPLE_BUFFER_UTILS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// lock-free single-producer / single-consumer triple buffer.
+// the writer always has a private buffer to fill, the reader always has a
+// private buffer to read, and the third one is swapped between them with a
+// single atomic exchange, so neither side ever waits or sees a torn value.
+template<typename T>
+class TripleBuffer {
+public:
+  TripleBuffer() : mBuffers{}, mMiddle(1), mWrite(0), mRead(2) {}
+
+  // writer: the buffer to fill before calling publish()
+  T& write() { return mBuffers[mWrite]; }
+
+  // writer: hand the filled buffer over to the reader
+  void publish() {
+    mWrite = mMiddle.exchange(mWrite | kDirty, std::memory_order_acq_rel) & kIndexMask;
+  }
+
+  // reader: grab the most recently published buffer (if there is a new one).
+  // returns true if read() now points at newer data.
+  bool update() {
+    if (!(mMiddle.load(std::memory_order_relaxed) & kDirty)) return false;
+    mRead = mMiddle.exchange(mRead, std::memory_order_acq_rel) & kIndexMask;
+    return true;
+  }
+
+  // reader: the buffer claimed by the last update(), stable until the next one
+  const T& read() const { return mBuffers[mRead]; }
+
+private:
+  static constexpr uint8_t kDirty = 0x4;
+  static constexpr uint8_t kIndexMask = 0x3;
+
+  std::array<T, 3> mBuffers;
+  // index of the shared buffer, with kDirty set when it holds unread data
+  std::atomic<uint8_t> mMiddle;
+  uint8_t mWrite;
+  uint8_t mRead;
+};
+
+#endif
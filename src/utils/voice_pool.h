@@ -0,0 +1,171 @@
+#ifndef VOICE_POOL_UTILS_H
+#define VOICE_POOL_UTILS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "./control_ramp.h"
+#include "./sample_buffer.h"
+#include "./warp_reader.h"
+
+// reads a block of buffer at phase and the playback rates into out, like
+// warp_read_block or SincResampler::read
+typedef void (*VoiceReader)(const SampleBuffer &buffer, WarpPhase &phase, const float *rates, float *out,
+                            unsigned int frames);
+
+// the sample voices of the sonification and the mixer they play into. every
+// voice plays a SampleBuffer at its own ramped playback rate and level, and is
+// routed to one or all of the output channels. each channel mixes its voices
+// at 1 / the number of them, so adding subjects doesn't clip.
+//
+// everything is allocated in setup(), voices are added there too. the voice
+// state is kept as arrays (structure of arrays), and process() goes through
+// the routed voices kBatch at a time: the rates of the batch, then the reads,
+// then the mix onto the channel buses, so a batch's blocks stay in the cache
+// however many voices there are. render thread only, apart from setup().
+class VoicePool {
+public:
+  static const unsigned int kBatch = 4;
+  // routes are a bit mask of channels
+  static const unsigned int kMaxChannels = 32;
+  static const int kAllChannels = -1;
+
+  // room for capacity voices mixed onto channels, blockFrames at a time
+  bool setup(const unsigned int capacity, const unsigned int channels, const unsigned int blockFrames) {
+    if (capacity == 0 || channels == 0 || channels > kMaxChannels || blockFrames == 0) return false;
+    mCapacity = capacity;
+    mChannels = channels;
+    mFrames = blockFrames;
+    mBuffers.assign(capacity, nullptr);
+    mPhases.assign(capacity, 0);
+    mRoutes.assign(capacity, 0);
+    mRateRamps.clear();
+    mGainRamps.clear();
+    mRateRamps.reserve(capacity);
+    mGainRamps.reserve(capacity);
+    mActive.assign(capacity, 0);
+    mChannelGains.assign(channels, 0.0f);
+    // one block per voice of a batch, the rates and the samples, then the buses
+    const size_t stride = (blockFrames + 15) / 16 * 16;
+    mStride = (unsigned int)stride;
+    float *rates = aligned_floats(mStorage, (2 * kBatch + channels) * stride);
+    mRates = rates;
+    mBlocks = rates + kBatch * stride;
+    mBuses = rates + 2 * kBatch * stride;
+    mSize = 0;
+    return true;
+  }
+
+  // a new voice playing buffer, muted until it's routed. -1 when the pool is full.
+  int add(const SampleBuffer *buffer) {
+    if (mSize == mCapacity) return -1;
+    mBuffers[mSize] = buffer;
+    mRateRamps.emplace_back(ControlRamp::Shape::kExponential, 1.0f);
+    mGainRamps.emplace_back(ControlRamp::Shape::kLinear, 1.0f);
+    return (int)mSize++;
+  }
+
+  unsigned int size() const { return mSize; }
+  unsigned int channels() const { return mChannels; }
+  unsigned int frames() const { return mFrames; }
+
+  // the sample voice plays, picked up at its phase
+  void setBuffer(const unsigned int voice, const SampleBuffer *buffer) { mBuffers[voice] = buffer; }
+  // voice plays on channel, or on every channel with kAllChannels
+  void route(const unsigned int voice, const int channel) {
+    mRoutes[voice] = channel == kAllChannels ? allChannels() : (uint32_t)1 << channel;
+  }
+  // voice stops playing, and isn't read until it's routed again
+  void mute(const unsigned int voice) { mRoutes[voice] = 0; }
+  bool routed(const unsigned int voice) const { return mRoutes[voice] != 0; }
+
+  // playback rate (1 is the sample's own pitch) and level, ramped per sample
+  ControlRamp &rate(const unsigned int voice) { return mRateRamps[voice]; }
+  ControlRamp &gain(const unsigned int voice) { return mGainRamps[voice]; }
+
+  // every voice back to the start of its sample
+  void resetPhases() { std::fill(mPhases.begin(), mPhases.end(), (WarpPhase)0); }
+
+  // reads frames (up to the block size) samples of every routed voice with
+  // read and mixes them onto the channel buses
+  void process(const VoiceReader read, const unsigned int frames) {
+    // the routed voices, and the gain of each channel's mix
+    unsigned int active = 0;
+    for (unsigned int v = 0; v < mSize; v++) {
+      if (mRoutes[v] != 0 && mBuffers[v] != nullptr) mActive[active++] = v;
+    }
+    for (unsigned int c = 0; c < mChannels; c++) {
+      unsigned int count = 0;
+      for (unsigned int a = 0; a < active; a++) count += (mRoutes[mActive[a]] >> c) & 1;
+      mChannelGains[c] = count > 0 ? 1.0f / count : 0.0f;
+      std::fill(bus(c), bus(c) + frames, 0.0f);
+    }
+
+    for (unsigned int first = 0; first < active; first += kBatch) {
+      const unsigned int batch = std::min(active - first, (unsigned int)kBatch);
+      // the rates of the batch, then the reads
+      for (unsigned int b = 0; b < batch; b++) {
+        ControlRamp &ramp = mRateRamps[mActive[first + b]];
+        float *rates = mRates + b * mStride;
+        for (unsigned int n = 0; n < frames; n++) rates[n] = ramp.next();
+      }
+      for (unsigned int b = 0; b < batch; b++) {
+        const unsigned int v = mActive[first + b];
+        read(*mBuffers[v], mPhases[v], mRates + b * mStride, mBlocks + b * mStride, frames);
+      }
+      // levels that are moving go sample by sample, steady ones into the mix gain
+      float levels[kBatch];
+      for (unsigned int b = 0; b < batch; b++) {
+        ControlRamp &ramp = mGainRamps[mActive[first + b]];
+        if (ramp.value() == ramp.target()) {
+          levels[b] = ramp.value();
+          continue;
+        }
+        levels[b] = 1.0f;
+        float *block = mBlocks + b * mStride;
+        for (unsigned int n = 0; n < frames; n++) block[n] *= ramp.next();
+      }
+      for (unsigned int b = 0; b < batch; b++) {
+        const uint32_t routes = mRoutes[mActive[first + b]];
+        const float *block = mBlocks + b * mStride;
+        for (unsigned int c = 0; c < mChannels; c++) {
+          if (((routes >> c) & 1) == 0) continue;
+          const float g = levels[b] * mChannelGains[c];
+          float *out = bus(c);
+          for (unsigned int n = 0; n < frames; n++) out[n] += g * block[n];
+        }
+      }
+    }
+  }
+
+  // the mix of channel from the last process()
+  float *bus(const unsigned int channel) { return mBuses + channel * mStride; }
+  const float *bus(const unsigned int channel) const { return mBuses + channel * mStride; }
+
+private:
+  uint32_t allChannels() const { return mChannels == 32 ? 0xffffffffu : ((uint32_t)1 << mChannels) - 1; }
+
+  unsigned int mCapacity = 0;
+  unsigned int mSize = 0;
+  unsigned int mChannels = 0;
+  unsigned int mFrames = 0;
+  unsigned int mStride = 0;
+  // per voice
+  std::vector<const SampleBuffer *> mBuffers;
+  std::vector<WarpPhase> mPhases;
+  std::vector<uint32_t> mRoutes;
+  std::vector<ControlRamp> mRateRamps;
+  std::vector<ControlRamp> mGainRamps;
+  // indices of the routed voices in this block
+  std::vector<unsigned int> mActive;
+  // per channel
+  std::vector<float> mChannelGains;
+  // rates and samples of a batch, and the buses
+  std::vector<float> mStorage;
+  float *mRates = nullptr;
+  float *mBlocks = nullptr;
+  float *mBuses = nullptr;
+};
+
+#endif
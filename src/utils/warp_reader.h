@@ -0,0 +1,209 @@
+#ifndef WARP_READER_UTILS_H
+#define WARP_READER_UTILS_H
+
+#include <algorithm>
+#include <cstdint>
+
+#include "./sample_buffer.h"
+
+// the vector path: neon on the bela, avx2 or sse2 on x86 hosts. define
+// WARP_READER_SCALAR to build without it.
+#if !defined(WARP_READER_SCALAR)
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define WARP_READER_NEON
+#define WARP_READER_LANES 4
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define WARP_READER_AVX2
+#define WARP_READER_LANES 8
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define WARP_READER_SSE2
+#define WARP_READER_LANES 4
+#endif
+#endif
+
+// the sample start and end fade in and out over this many output samples
+const float kWarpFadeFrames = 110.0f;
+
+// read position in 32.32 fixed point, whole samples in the top 32 bits. the
+// steps add up exactly, a float position loses the fraction as it grows.
+typedef uint64_t WarpPhase;
+
+// the interpolation takes the top 24 bits of the phase fraction, they convert
+// to float exactly
+const int kWarpFracShift = 8;
+const float kWarpFracScale = 1.0f / 16777216.0f;
+
+// the phase step for a playback rate, in steps of 2^-24 (exact for rates from
+// 0.5 up) and within 0..kWarpMaxRate
+inline WarpPhase warp_phase_step(const float rate) {
+  // not fminf/fmaxf, they are calls without -ffast-math. nan goes to 0.
+  const float clamped = rate > 0.0f ? (rate < kWarpMaxRate ? rate : kWarpMaxRate) : 0.0f;
+  return (WarpPhase)(uint32_t)(clamped * 16777216.0f) << kWarpFracShift;
+}
+
+// the phase back in the sample, once per block. with the guard the reader
+// never gets further than one sample length past it.
+inline void warp_wrap(WarpPhase &phase, const WarpPhase end) {
+  if (phase >= end) {
+    phase -= end;
+    if (phase >= end) phase %= end;
+  }
+}
+
+// gain of the fade at the loop point, at position x within the sample: the
+// sample fades in from its start and out to its end over kWarpFadeFrames
+// output samples
+inline float warp_fade(const float x, const unsigned int length, const float rate) {
+  const float fade = kWarpFadeFrames * rate;
+  if (x < fade) return x / fade;
+  if (x > (float)length - fade) return ((float)length - x) / fade;
+  return 1.0f;
+}
+
+// the position within the sample of sample index i plus frac, the guard is the
+// start of the sample again
+inline float warp_position(const int32_t i, const float frac, const unsigned int length) {
+  return (float)(i >= (int32_t)length ? i - (int32_t)length : i) + frac;
+}
+
+// the sample indices and fractions (top 24 bits) of count read positions from
+// phase on, moving phase on by the rate of each
+inline void warp_positions(WarpPhase &phase, const float *rates, int32_t *is, int32_t *fracBits,
+                           const unsigned int count) {
+  for (unsigned int m = 0; m < count; m++) {
+    is[m] = (int32_t)(phase >> 32);
+    fracBits[m] = (int32_t)((uint32_t)phase >> kWarpFracShift);
+    phase += warp_phase_step(rates[m]);
+  }
+}
+
+// one sample at sample index i plus fracBits / 2^24 (i < length + guard),
+// linearly interpolated with the next sample and faded at the loop point
+inline float warp_sample_at(const float *sample, const unsigned int length, const int32_t i,
+                            const int32_t fracBits, const float rate) {
+  const float frac = (float)fracBits * kWarpFracScale;
+  const float s0 = sample[i];
+  const float out = s0 + (sample[i + 1] - s0) * frac;
+  return out * warp_fade(warp_position(i, frac, length), length, rate);
+}
+
+// scalar reference of warp_read_block
+inline void warp_read_block_scalar(const SampleBuffer &buffer, WarpPhase &phase, const float *rates, float *out,
+                                   const unsigned int frames) {
+  const float *sample = buffer.data();
+  const unsigned int length = buffer.length();
+  const unsigned int segment = buffer.maxReadFrames();
+  const WarpPhase end = (WarpPhase)length << 32;
+  for (unsigned int n = 0; n < frames; n++) {
+    if (n % segment == 0) warp_wrap(phase, end);
+    out[n] = warp_sample_at(sample, length, (int32_t)(phase >> 32), (int32_t)((uint32_t)phase >> kWarpFracShift), rates[n]);
+    phase += warp_phase_step(rates[n]);
+  }
+}
+
+#ifdef WARP_READER_LANES
+// WARP_READER_LANES samples at the sample indices is plus fracBits / 2^24. the
+// same operations as warp_sample_at lane by lane, so the results are
+// identical. groups that touch a fade go through warp_sample_at: that's a few
+// hundred samples per pass through the sample, and neon has no divide.
+inline void warp_read_lanes(const float *sample, const unsigned int length, const int32_t *is,
+                            const int32_t *fracBits, const float *rates, float *out) {
+#if defined(WARP_READER_NEON)
+  const int32x4_t i = vld1q_s32(is);
+  const float32x4_t frac = vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(fracBits)), kWarpFracScale);
+  const int32x4_t vlength = vdupq_n_s32((int32_t)length);
+  const int32x4_t wrapped = vsubq_s32(i, vandq_s32(vreinterpretq_s32_u32(vcgeq_s32(i, vlength)), vlength));
+  const float32x4_t x = vaddq_f32(vcvtq_f32_s32(wrapped), frac);
+  const float32x4_t fade = vmulq_f32(vdupq_n_f32(kWarpFadeFrames), vld1q_f32(rates));
+  const uint32x4_t fading = vorrq_u32(vcltq_f32(x, fade), vcgtq_f32(x, vsubq_f32(vdupq_n_f32((float)length), fade)));
+  const uint32x2_t fadingHalves = vorr_u32(vget_low_u32(fading), vget_high_u32(fading));
+  if (vget_lane_u32(vpmax_u32(fadingHalves, fadingHalves), 0) != 0) {
+    for (int l = 0; l < WARP_READER_LANES; l++) out[l] = warp_sample_at(sample, length, is[l], fracBits[l], rates[l]);
+    return;
+  }
+  const float s0Lanes[4] = {sample[is[0]], sample[is[1]], sample[is[2]], sample[is[3]]};
+  const float s1Lanes[4] = {sample[is[0] + 1], sample[is[1] + 1], sample[is[2] + 1], sample[is[3] + 1]};
+  const float32x4_t s0 = vld1q_f32(s0Lanes);
+  vst1q_f32(out, vaddq_f32(s0, vmulq_f32(vsubq_f32(vld1q_f32(s1Lanes), s0), frac)));
+#elif defined(WARP_READER_AVX2)
+  const __m256i i = _mm256_loadu_si256((const __m256i *)is);
+  const __m256 frac = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i *)fracBits)),
+                                    _mm256_set1_ps(kWarpFracScale));
+  // i >= length as i > length - 1
+  const __m256i vlength = _mm256_set1_epi32((int32_t)length);
+  const __m256i beyond = _mm256_cmpgt_epi32(i, _mm256_set1_epi32((int32_t)length - 1));
+  const __m256 x = _mm256_add_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(i, _mm256_and_si256(beyond, vlength))), frac);
+  const __m256 fade = _mm256_mul_ps(_mm256_set1_ps(kWarpFadeFrames), _mm256_loadu_ps(rates));
+  const __m256 fading = _mm256_or_ps(_mm256_cmp_ps(x, fade, _CMP_LT_OQ),
+                                     _mm256_cmp_ps(x, _mm256_sub_ps(_mm256_set1_ps((float)length), fade), _CMP_GT_OQ));
+  if (_mm256_movemask_ps(fading) != 0) {
+    for (int l = 0; l < WARP_READER_LANES; l++) out[l] = warp_sample_at(sample, length, is[l], fracBits[l], rates[l]);
+    return;
+  }
+  const __m256 s0 = _mm256_i32gather_ps(sample, i, 4);
+  const __m256 s1 = _mm256_i32gather_ps(sample + 1, i, 4);
+  _mm256_storeu_ps(out, _mm256_add_ps(s0, _mm256_mul_ps(_mm256_sub_ps(s1, s0), frac)));
+#elif defined(WARP_READER_SSE2)
+  const __m128i i = _mm_loadu_si128((const __m128i *)is);
+  const __m128 frac = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)fracBits)), _mm_set1_ps(kWarpFracScale));
+  // i >= length as i > length - 1
+  const __m128i vlength = _mm_set1_epi32((int32_t)length);
+  const __m128i beyond = _mm_cmpgt_epi32(i, _mm_set1_epi32((int32_t)length - 1));
+  const __m128 x = _mm_add_ps(_mm_cvtepi32_ps(_mm_sub_epi32(i, _mm_and_si128(beyond, vlength))), frac);
+  const __m128 fade = _mm_mul_ps(_mm_set1_ps(kWarpFadeFrames), _mm_loadu_ps(rates));
+  const __m128 fading = _mm_or_ps(_mm_cmplt_ps(x, fade), _mm_cmpgt_ps(x, _mm_sub_ps(_mm_set1_ps((float)length), fade)));
+  if (_mm_movemask_ps(fading) != 0) {
+    for (int l = 0; l < WARP_READER_LANES; l++) out[l] = warp_sample_at(sample, length, is[l], fracBits[l], rates[l]);
+    return;
+  }
+  const __m128 s0 = _mm_setr_ps(sample[is[0]], sample[is[1]], sample[is[2]], sample[is[3]]);
+  const __m128 s1 = _mm_setr_ps(sample[is[0] + 1], sample[is[1] + 1], sample[is[2] + 1], sample[is[3] + 1]);
+  _mm_storeu_ps(out, _mm_add_ps(s0, _mm_mul_ps(_mm_sub_ps(s1, s0), frac)));
+#endif
+}
+#endif
+
+// reads frames samples from buffer at phase, at the playback rate of each
+// output sample in rates, into out, and moves phase on, interpolating
+// linearly. the phase is stepped first, integer adds one after the other,
+// then the reads and the interpolation go WARP_READER_LANES samples at a
+// time. the phase wraps once per buffer.maxReadFrames(), that is at the
+// block start when the buffer was loaded for the block size. bit for bit the
+// same as warp_read_block_scalar.
+inline void warp_read_block(const SampleBuffer &buffer, WarpPhase &phase, const float *rates, float *out,
+                            const unsigned int frames) {
+#ifdef WARP_READER_LANES
+  const unsigned int kChunk = 64;
+  const float *sample = buffer.data();
+  const unsigned int length = buffer.length();
+  const unsigned int segment = buffer.maxReadFrames();
+  const WarpPhase end = (WarpPhase)length << 32;
+  alignas(32) int32_t is[kChunk];
+  alignas(32) int32_t fracBits[kChunk];
+  unsigned int n = 0;
+  while (n < frames) {
+    if (n % segment == 0) warp_wrap(phase, end);
+    // up to the next wrap, in whole lane groups until the last few frames
+    unsigned int chunk = std::min(std::min(kChunk, frames - n), segment - n % segment);
+    if (chunk >= WARP_READER_LANES) chunk -= chunk % WARP_READER_LANES;
+    warp_positions(phase, rates + n, is, fracBits, chunk);
+    if (chunk >= WARP_READER_LANES) {
+      for (unsigned int m = 0; m < chunk; m += WARP_READER_LANES) {
+        warp_read_lanes(sample, length, is + m, fracBits + m, rates + n + m, out + n + m);
+      }
+    } else {
+      for (unsigned int m = 0; m < chunk; m++) {
+        out[n + m] = warp_sample_at(sample, length, is[m], fracBits[m], rates[n + m]);
+      }
+    }
+    n += chunk;
+  }
+#else
+  warp_read_block_scalar(buffer, phase, rates, out, frames);
+#endif
+}
+
+#endif
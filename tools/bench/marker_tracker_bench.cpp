@@ -0,0 +1,136 @@
+// benchmark of the marker gap filler (src/utils/marker_tracker.h): how long a
+// frame of updates takes for many markers at mocap rates, and how far the filled
+// positions are from the real ones. see the README for how to build and use it.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <unistd.h>
+
+#include "../../src/utils/histogram.h"
+#include "../../src/utils/marker_tracker.h"
+
+// markers sliding back and forth along y like the sleds, each at its own pace,
+// with measurement noise and dropouts of random length.
+struct SimulatedMarker {
+  double cycleSec;
+  double phase;
+  unsigned int gapFramesLeft;
+};
+
+static void usage(const char *program) {
+  fprintf(stderr, "usage: %s [-n markers] [-r rate_hz] [-s seconds] [-d dropouts_per_sec] [-g max_gap_ms]\n"
+                  "  -n  number of markers, default 100\n"
+                  "  -r  frame rate in Hz, default 1000\n"
+                  "  -s  seconds of frames to simulate, default 60\n"
+                  "  -d  dropouts per marker and second, default 2\n"
+                  "  -g  longest simulated dropout in ms, default 150\n", program);
+}
+
+int main(int argc, char *argv[]) {
+  unsigned int markers = 100;
+  double rate = 1000.0, seconds = 60.0, dropoutsPerSec = 2.0, maxGapMs = 150.0;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:r:s:d:g:h")) != -1) {
+    switch (opt) {
+      case 'n': markers = (unsigned int)atoi(optarg); break;
+      case 'r': rate = atof(optarg); break;
+      case 's': seconds = atof(optarg); break;
+      case 'd': dropoutsPerSec = atof(optarg); break;
+      case 'g': maxGapMs = atof(optarg); break;
+      default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (markers == 0 || rate <= 0.0 || seconds <= 0.0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // same settings as the Bela program
+  const float alpha = 0.85f, beta = 0.3f, maxGapSec = 0.1f;
+  const float trackCenter = 325.0f, trackHalfLength = 575.0f, noiseMm = 0.3f;
+
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::normal_distribution<float> noise(0.0f, noiseMm);
+  std::vector<SimulatedMarker> sim(markers);
+  std::vector<MarkerTracker> trackers(markers);
+  for (unsigned int i = 0; i < markers; i++) {
+    sim[i] = {1.0 + 4.0 * uniform(rng), 2.0 * M_PI * uniform(rng), 0};
+    trackers[i].setup(alpha, beta, maxGapSec);
+  }
+  std::vector<float> xyz(markers * 3), truthY(markers);
+  std::vector<unsigned char> valid(markers);
+
+  const unsigned long long frames = (unsigned long long)(seconds * rate);
+  const double dropoutChance = dropoutsPerSec / rate;
+  const unsigned int maxGapFrames = (unsigned int)(maxGapMs * 1e-3 * rate) + 1;
+  LogLinearHistogram frameNs, predictNs, filledErrorUm;
+  double filledSquaredError = 0.0;
+  unsigned long long filled = 0, lost = 0, dropped = 0;
+
+  for (unsigned long long f = 0; f < frames; f++) {
+    const double t = f / rate;
+    const unsigned long long timeUs = 1000 + (unsigned long long)(t * 1e6);
+    for (unsigned int i = 0; i < markers; i++) {
+      SimulatedMarker &m = sim[i];
+      truthY[i] = trackCenter + trackHalfLength * (float)sin(2.0 * M_PI * t / m.cycleSec + m.phase);
+      if (m.gapFramesLeft == 0 && uniform(rng) < dropoutChance) {
+        m.gapFramesLeft = 1 + (unsigned int)(uniform(rng) * maxGapFrames);
+      }
+      valid[i] = m.gapFramesLeft == 0;
+      if (m.gapFramesLeft > 0) m.gapFramesLeft--;
+      xyz[i * 3] = 100.0f * i + noise(rng);
+      xyz[i * 3 + 1] = truthY[i] + noise(rng);
+      xyz[i * 3 + 2] = 50.0f + noise(rng);
+    }
+
+    // what fillBuffer does with every frame
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < markers; i++) {
+      trackers[i].update(timeUs, &xyz[i * 3], valid[i] != 0);
+    }
+    const auto end = std::chrono::steady_clock::now();
+    frameNs.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+
+    // a look ahead of 5 ms, as if for the audio output
+    float pos[3], vel[3];
+    const auto predictStart = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < markers; i++) trackers[i].predict(timeUs + 5000, pos, vel);
+    const auto predictEnd = std::chrono::steady_clock::now();
+    predictNs.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(predictEnd - predictStart).count());
+
+    for (unsigned int i = 0; i < markers; i++) {
+      if (valid[i]) continue;
+      dropped++;
+      const MarkerTracker::State state = trackers[i].state();
+      if (state == MarkerTracker::State::kFilling) {
+        const double error = trackers[i].position()[1] - truthY[i];
+        filledSquaredError += error * error;
+        filledErrorUm.record((uint64_t)(fabs(error) * 1000.0));
+        filled++;
+      } else if (state == MarkerTracker::State::kLost) {
+        lost++;
+      }
+    }
+  }
+
+  const double periodNs = 1e9 / rate;
+  printf("%u markers at %.0f Hz for %.0f s (%llu frames), %.1f dropouts per marker and second up to %.0f ms\n",
+         markers, rate, seconds, frames, dropoutsPerSec, maxGapMs);
+  printf("update per frame: p50 %.2f / p99 %.2f / max %.2f us, %.1f ns per marker, p99 is %.3f%% of the frame period\n",
+         frameNs.percentile(50.0) * 1e-3, frameNs.percentile(99.0) * 1e-3, frameNs.max() * 1e-3,
+         (double)frameNs.percentile(50.0) / markers, 100.0 * frameNs.percentile(99.0) / periodNs);
+  printf("predict per frame: p50 %.2f / p99 %.2f us\n", predictNs.percentile(50.0) * 1e-3,
+         predictNs.percentile(99.0) * 1e-3);
+  printf("dropped marker frames: %llu, filled %llu, lost (gap over %.0f ms) %llu\n", dropped, filled,
+         maxGapSec * 1e3, lost);
+  if (filled > 0) {
+    printf("filled position error: rms %.2f / p50 %.2f / p99 %.2f / max %.2f mm\n", sqrt(filledSquaredError / filled),
+           filledErrorUm.percentile(50.0) * 1e-3, filledErrorUm.percentile(99.0) * 1e-3, filledErrorUm.max() * 1e-3);
+  }
+  return 0;
+}
@@ -0,0 +1,147 @@
+// benchmark of the sample readers at each quality level: linear interpolation
+// (src/utils/warp_reader.h) and the windowed sinc resampler at 8, 16 and 32
+// taps (src/utils/sinc_resampler.h). it reports the samples per second per
+// voice at pitch glides like the sonification's, how much of a tone that
+// should be filtered out aliases back, and the level of a tone that should
+// pass. see the README for how to build and use it.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <unistd.h>
+
+#include "../../src/utils/control_ramp.h"
+#include "../../src/utils/histogram.h"
+#include "../../src/utils/sinc_resampler.h"
+#include "../../src/utils/warp_reader.h"
+
+static void usage(const char *program) {
+  fprintf(stderr, "usage: %s [-v voices] [-b block_frames] [-s seconds] [-r max_rate]\n"
+                  "  -v  number of voices, default 4\n"
+                  "  -b  audio block size in frames, default 32\n"
+                  "  -s  seconds of audio at 44.1 kHz to render per quality level, default 20\n"
+                  "  -r  highest playback rate, default 1.587 (gUndertoneFreqMax / gUndertoneFreqMin)\n", program);
+}
+
+// reads with the resampler, or linearly without one
+static void readBlock(const SincResampler *resampler, const SampleBuffer &buffer, WarpPhase &phase,
+                      const float *rates, float *out, unsigned int frames) {
+  if (resampler != nullptr) {
+    resampler->read(buffer, phase, rates, out, frames);
+  } else {
+    warp_read_block(buffer, phase, rates, out, frames);
+  }
+}
+
+// level in dB of a tone of frequency cycles per sample played at rate, relative
+// to the tone itself
+static double toneLevelDb(const SincResampler *resampler, double frequency, float rate, unsigned int blockFrames) {
+  const unsigned int length = 1 << 18;
+  std::vector<float> tone(length);
+  for (unsigned int i = 0; i < length; i++) tone[i] = (float)sin(2.0 * M_PI * frequency * i);
+  SampleBuffer buffer;
+  buffer.load(tone, blockFrames);
+
+  // a second of output, clear of the fade at the loop point
+  const unsigned int frames = 44100;
+  std::vector<float> rates(blockFrames, rate), out(blockFrames);
+  WarpPhase phase = (WarpPhase)1000 << 32;
+  double squares = 0.0;
+  for (unsigned int n = 0; n + blockFrames <= frames; n += blockFrames) {
+    readBlock(resampler, buffer, phase, rates.data(), out.data(), blockFrames);
+    for (float value : out) squares += (double)value * value;
+  }
+  const double rms = sqrt(squares / (frames / blockFrames * blockFrames));
+  return 20.0 * log10(rms / sqrt(0.5) + 1e-12);
+}
+
+int main(int argc, char *argv[]) {
+  unsigned int voices = 4, blockFrames = 32;
+  double seconds = 20.0;
+  float maxRate = 1.587f;
+  int opt;
+  while ((opt = getopt(argc, argv, "v:b:s:r:h")) != -1) {
+    switch (opt) {
+      case 'v': voices = (unsigned int)atoi(optarg); break;
+      case 'b': blockFrames = (unsigned int)atoi(optarg); break;
+      case 's': seconds = atof(optarg); break;
+      case 'r': maxRate = (float)atof(optarg); break;
+      default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (voices == 0 || blockFrames == 0 || seconds <= 0.0 || maxRate < 1.0f || maxRate > kWarpMaxRate) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const float sampleRate = 44100.0f;
+  const unsigned long long blocks = (unsigned long long)(seconds * sampleRate / blockFrames);
+  const double blockNs = 1e9 * blockFrames / sampleRate;
+
+  // a harmonic tone with a little noise, like the undertone file
+  const unsigned int length = 113145;
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::vector<float> samples(length);
+  for (unsigned int i = 0; i < length; i++) {
+    const float phase = 2.0f * (float)M_PI * 116.4f * i / sampleRate;
+    samples[i] = 0.5f * sinf(phase) + 0.25f * sinf(2.0f * phase) + 0.1f * sinf(3.0f * phase) + 0.05f * (uniform(rng) - 0.5f);
+  }
+  SampleBuffer buffer;
+  buffer.load(samples, blockFrames);
+
+  // tones at 70% and 90% of the sample's nyquist frequency land above the
+  // output's nyquist frequency at rates from 1/0.7 and 1/0.9, they should be
+  // filtered out; one at 20% should pass
+  const double aliasFrequencies[] = {0.35, 0.45}, passFrequency = 0.1;
+
+  printf("%u voices, %u frame blocks, %.0f s of audio (%llu blocks) per quality level, rates 1 to %.3f\n",
+         voices, blockFrames, seconds, blocks, maxRate);
+  printf("%-8s %12s %8s %8s %8s %12s %12s %10s\n", "quality", "M samples/s", "p50 ns", "p99 ns", "voices",
+         "alias70 dB", "alias90 dB", "pass dB");
+
+  const unsigned int qualities[] = {0, 8, 16, 32};
+  for (unsigned int taps : qualities) {
+    SincResampler resampler;
+    if (taps > 0 && !resampler.setup(taps)) return 1;
+    const SincResampler *reader = taps > 0 ? &resampler : nullptr;
+
+    std::vector<ControlRamp> ramps(voices, ControlRamp(ControlRamp::Shape::kExponential, 1.0f));
+    std::vector<WarpPhase> phases(voices);
+    for (unsigned int v = 0; v < voices; v++) phases[v] = (WarpPhase)(uniform(rng) * length) << 32;
+    std::vector<float> rates(blockFrames), out(blockFrames);
+    LogLinearHistogram voiceNs;
+    double totalNs = 0.0;
+
+    for (unsigned long long b = 0; b < blocks; b++) {
+      for (unsigned int v = 0; v < voices; v++) {
+        // glide to a new rate each block, at most a semitone away
+        const float step = powf(2.0f, (2.0f * uniform(rng) - 1.0f) / 12.0f);
+        ramps[v].rampTo(fminf(fmaxf(ramps[v].target() * step, 1.0f), maxRate), blockFrames);
+        for (unsigned int n = 0; n < blockFrames; n++) rates[n] = ramps[v].next();
+
+        const auto start = std::chrono::steady_clock::now();
+        readBlock(reader, buffer, phases[v], rates.data(), out.data(), blockFrames);
+        const auto end = std::chrono::steady_clock::now();
+        const uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        voiceNs.record(ns);
+        totalNs += ns;
+      }
+    }
+
+    char name[16] = "linear";
+    if (taps > 0) snprintf(name, sizeof(name), "sinc %u", taps);
+    printf("%-8s %12.1f %8.0f %8.0f %8.0f %12.1f %12.1f %10.2f\n", name,
+           (double)blocks * blockFrames * voices / totalNs * 1e3, (double)voiceNs.percentile(50.0),
+           (double)voiceNs.percentile(99.0), blockNs / (double)voiceNs.percentile(50.0),
+           toneLevelDb(reader, aliasFrequencies[0], maxRate, blockFrames),
+           toneLevelDb(reader, aliasFrequencies[1], maxRate, blockFrames),
+           toneLevelDb(reader, passFrequency, maxRate, blockFrames));
+  }
+  printf("voices: how many fit in one block period at the p50 time. alias70/alias90/pass: tones at 70%%, 90%% and\n"
+         "%.0f%% of the sample's nyquist frequency played at %.3f, relative to the tone\n", passFrequency * 200.0, maxRate);
+  return 0;
+}
@@ -0,0 +1,122 @@
+// benchmark of the voice pool (src/utils/voice_pool.h): the time render()
+// spends on the sample voices per block as the group grows, from one voice to
+// two per subject for 16 subjects, each gliding through the undertone's range
+// of playback rates and mixed onto the output channels. it reports the time
+// per block, the cost of each voice and how much of the block period the
+// voices take. see the README for how to build and use it.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <unistd.h>
+
+#include "../../src/utils/histogram.h"
+#include "../../src/utils/sinc_resampler.h"
+#include "../../src/utils/voice_pool.h"
+#include "../../src/utils/warp_reader.h"
+
+static void usage(const char *program) {
+  fprintf(stderr, "usage: %s [-t taps] [-c channels] [-b block_frames] [-s seconds] [-m max_voices]\n"
+                  "  -t  resampler taps: 8, 16 or 32, or 0 for linear interpolation, default 16 (gResampleTaps)\n"
+                  "  -c  output channels, default 2\n"
+                  "  -b  audio block size in frames, default 32\n"
+                  "  -s  seconds of audio at 44.1 kHz to render per voice count, default 10\n"
+                  "  -m  most voices, default 32 (two per subject for 16 subjects)\n", program);
+}
+
+static SincResampler gResampler;
+
+static void readSinc(const SampleBuffer &buffer, WarpPhase &phase, const float *rates, float *out, unsigned int frames) {
+  gResampler.read(buffer, phase, rates, out, frames);
+}
+
+int main(int argc, char *argv[]) {
+  unsigned int taps = 16, channels = 2, blockFrames = 32, maxVoices = 32;
+  double seconds = 10.0;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:c:b:s:m:h")) != -1) {
+    switch (opt) {
+      case 't': taps = (unsigned int)atoi(optarg); break;
+      case 'c': channels = (unsigned int)atoi(optarg); break;
+      case 'b': blockFrames = (unsigned int)atoi(optarg); break;
+      case 's': seconds = atof(optarg); break;
+      case 'm': maxVoices = (unsigned int)atoi(optarg); break;
+      default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if ((taps > 0 && !gResampler.setup(taps)) || channels == 0 || channels > VoicePool::kMaxChannels ||
+      blockFrames == 0 || seconds <= 0.0 || maxVoices == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  const VoiceReader read = taps > 0 ? readSinc : warp_read_block;
+
+  const float sampleRate = 44100.0f;
+  const unsigned long long blocks = (unsigned long long)(seconds * sampleRate / blockFrames);
+  const double blockNs = 1e9 * blockFrames / sampleRate;
+
+  // the two tones, harmonic with a little noise like the sample files
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  const unsigned int lengths[2] = {113145, 75426};
+  const float freqs[2] = {116.4f, 174.6f};
+  SampleBuffer buffers[2];
+  for (int t = 0; t < 2; t++) {
+    std::vector<float> samples(lengths[t]);
+    for (unsigned int i = 0; i < lengths[t]; i++) {
+      const float phase = 2.0f * (float)M_PI * freqs[t] * i / sampleRate;
+      samples[i] = 0.5f * sinf(phase) + 0.25f * sinf(2.0f * phase) + 0.1f * sinf(3.0f * phase) + 0.05f * (uniform(rng) - 0.5f);
+    }
+    buffers[t].load(samples, blockFrames);
+  }
+
+  printf("%s, %u channels, %u frame blocks, %.0f s of audio (%llu blocks) per voice count\n",
+         taps > 0 ? "sinc resampler" : "linear interpolation", channels, blockFrames, seconds, blocks);
+  if (taps > 0) printf("%u taps\n", taps);
+  printf("%8s %10s %10s %12s %10s\n", "voices", "p50 ns", "p99 ns", "ns/voice", "% block");
+
+  // 1, 2, 4, 8, then every 8 up to maxVoices
+  std::vector<unsigned int> counts;
+  for (unsigned int voices = 1; voices < maxVoices; voices = voices < 8 ? voices * 2 : voices + 8) counts.push_back(voices);
+  counts.push_back(maxVoices);
+
+  for (unsigned int voices : counts) {
+    // every subject on a channel of its own, a level that moves on every other voice
+    VoicePool pool;
+    if (!pool.setup(voices, channels, blockFrames)) return 1;
+    for (unsigned int v = 0; v < voices; v++) {
+      pool.add(&buffers[v % 2]);
+      pool.route(v, v % 2 == 0 ? (int)(v / 2 % channels) : VoicePool::kAllChannels);
+    }
+
+    LogLinearHistogram poolNs;
+    double totalNs = 0.0;
+    float sink = 0.0f;
+    for (unsigned long long b = 0; b < blocks; b++) {
+      for (unsigned int v = 0; v < voices; v++) {
+        // glide to a new rate each block, at most a semitone away
+        const float step = powf(2.0f, (2.0f * uniform(rng) - 1.0f) / 12.0f);
+        pool.rate(v).rampTo(fminf(fmaxf(pool.rate(v).target() * step, 1.0f), 1.587f), blockFrames);
+        if (v % 2 == 1) pool.gain(v).rampTo(uniform(rng), blockFrames);
+      }
+      const auto start = std::chrono::steady_clock::now();
+      pool.process(read, blockFrames);
+      const auto end = std::chrono::steady_clock::now();
+      const uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+      poolNs.record(ns);
+      totalNs += ns;
+      sink += pool.bus(0)[blockFrames - 1];
+    }
+
+    const double p50 = (double)poolNs.percentile(50.0);
+    printf("%8u %10.0f %10.0f %12.0f %10.1f\n", voices, p50, (double)poolNs.percentile(99.0),
+           totalNs / blocks / voices, 100.0 * p50 / blockNs);
+    // keep the mix from being optimised away
+    if (std::isnan(sink)) printf("nan in the mix\n");
+  }
+  printf("ns/voice: mean time per voice per block. %% block: p50 time of the block period (%.0f ns)\n", blockNs);
+  return 0;
+}
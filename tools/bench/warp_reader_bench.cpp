@@ -0,0 +1,145 @@
+// benchmark of the variable rate sample reader (src/utils/warp_reader.h): how
+// many samples per second a voice reads with the vector path and with the
+// scalar reference, at pitch glides like the sonification's, and that both give
+// the same samples. see the README for how to build and use it.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <unistd.h>
+
+#include "../../src/utils/control_ramp.h"
+#include "../../src/utils/histogram.h"
+#include "../../src/utils/warp_reader.h"
+
+static void usage(const char *program) {
+  fprintf(stderr, "usage: %s [-v voices] [-b block_frames] [-s seconds] [-l sample_length] [-r max_rate]\n"
+                  "  -v  number of voices, default 4\n"
+                  "  -b  audio block size in frames, default 32\n"
+                  "  -s  seconds of audio at 44.1 kHz to render, default 60\n"
+                  "  -l  length of the sample in frames, default 113145 (the undertone file)\n"
+                  "  -r  highest playback rate, default 1.587 (gUndertoneFreqMax / gUndertoneFreqMin)\n", program);
+}
+
+static const char *vectorPath() {
+#if defined(WARP_READER_NEON)
+  return "neon";
+#elif defined(WARP_READER_AVX2)
+  return "avx2";
+#elif defined(WARP_READER_SSE2)
+  return "sse2";
+#else
+  return "none (scalar)";
+#endif
+}
+
+int main(int argc, char *argv[]) {
+  unsigned int voices = 4, blockFrames = 32, length = 113145;
+  double seconds = 60.0;
+  float maxRate = 1.587f;
+  int opt;
+  while ((opt = getopt(argc, argv, "v:b:s:l:r:h")) != -1) {
+    switch (opt) {
+      case 'v': voices = (unsigned int)atoi(optarg); break;
+      case 'b': blockFrames = (unsigned int)atoi(optarg); break;
+      case 's': seconds = atof(optarg); break;
+      case 'l': length = (unsigned int)atoi(optarg); break;
+      case 'r': maxRate = (float)atof(optarg); break;
+      default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (voices == 0 || blockFrames == 0 || seconds <= 0.0 || length < 2 || maxRate < 1.0f) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const float sampleRate = 44100.0f;
+  const unsigned long long blocks = (unsigned long long)(seconds * sampleRate / blockFrames);
+
+  // a harmonic tone with a little noise, the values don't change the timing
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::vector<float> samples(length);
+  for (unsigned int i = 0; i < length; i++) {
+    const float phase = 2.0f * (float)M_PI * 110.0f * i / sampleRate;
+    samples[i] = 0.5f * sinf(phase) + 0.25f * sinf(2.0f * phase) + 0.1f * sinf(3.0f * phase) + 0.05f * (uniform(rng) - 0.5f);
+  }
+  SampleBuffer buffer;
+  buffer.load(samples, blockFrames);
+
+  // every voice glides to a new rate each block, at most a semitone away
+  std::vector<ControlRamp> ramps(voices, ControlRamp(ControlRamp::Shape::kExponential, 1.0f));
+  std::vector<float> rates(voices * blockFrames);
+  std::vector<WarpPhase> phaseVector(voices), phaseScalar(voices);
+  for (unsigned int v = 0; v < voices; v++) phaseVector[v] = phaseScalar[v] = (WarpPhase)(uniform(rng) * length) << 32;
+  std::vector<float> outVector(blockFrames), outScalar(blockFrames);
+
+  LogLinearHistogram vectorNs, scalarNs;
+  double vectorTotalNs = 0.0, scalarTotalNs = 0.0;
+  unsigned long long mismatches = 0;
+
+  for (unsigned long long b = 0; b < blocks; b++) {
+    for (unsigned int v = 0; v < voices; v++) {
+      const float step = powf(2.0f, (2.0f * uniform(rng) - 1.0f) / 12.0f);
+      const float target = fminf(fmaxf(ramps[v].target() * step, 1.0f), maxRate);
+      ramps[v].rampTo(target, blockFrames);
+      for (unsigned int n = 0; n < blockFrames; n++) rates[v * blockFrames + n] = ramps[v].next();
+    }
+
+    // one voice after the other, as render() would
+    for (unsigned int v = 0; v < voices; v++) {
+      const float *voiceRates = &rates[v * blockFrames];
+      auto start = std::chrono::steady_clock::now();
+      warp_read_block(buffer, phaseVector[v], voiceRates, outVector.data(), blockFrames);
+      auto end = std::chrono::steady_clock::now();
+      const uint64_t vectorBlockNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+      vectorNs.record(vectorBlockNs);
+      vectorTotalNs += vectorBlockNs;
+
+      start = std::chrono::steady_clock::now();
+      warp_read_block_scalar(buffer, phaseScalar[v], voiceRates, outScalar.data(), blockFrames);
+      end = std::chrono::steady_clock::now();
+      const uint64_t scalarBlockNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+      scalarNs.record(scalarBlockNs);
+      scalarTotalNs += scalarBlockNs;
+
+      if (memcmp(outVector.data(), outScalar.data(), blockFrames * sizeof(float)) != 0 ||
+          phaseVector[v] != phaseScalar[v]) {
+        for (unsigned int n = 0; n < blockFrames; n++) {
+          if (memcmp(&outVector[n], &outScalar[n], sizeof(float)) != 0) mismatches++;
+        }
+        // carry on from the same place
+        phaseVector[v] = phaseScalar[v];
+      }
+    }
+  }
+
+  const double samplesPerVoice = (double)blocks * blockFrames;
+  const double blockNs = 1e9 * blockFrames / sampleRate;
+  printf("%u voices, %u frame blocks, %.0f s of audio (%llu blocks), %u frame sample, rates 1 to %.3f\n",
+         voices, blockFrames, seconds, blocks, length, maxRate);
+  printf("vector path: %s, %d samples at a time\n", vectorPath(),
+#ifdef WARP_READER_LANES
+         WARP_READER_LANES
+#else
+         1
+#endif
+  );
+  printf("vector: %.1f M samples/s per voice, block p50 %.0f / p99 %.0f / max %.0f ns, %.0f voices fit in real time\n",
+         samplesPerVoice * voices / vectorTotalNs * 1e3, (double)vectorNs.percentile(50.0),
+         (double)vectorNs.percentile(99.0), (double)vectorNs.max(), blockNs / (double)vectorNs.percentile(50.0));
+  printf("scalar: %.1f M samples/s per voice, block p50 %.0f / p99 %.0f / max %.0f ns, %.0f voices fit in real time\n",
+         samplesPerVoice * voices / scalarTotalNs * 1e3, (double)scalarNs.percentile(50.0),
+         (double)scalarNs.percentile(99.0), (double)scalarNs.max(), blockNs / (double)scalarNs.percentile(50.0));
+  printf("speedup %.2fx\n", scalarTotalNs / vectorTotalNs);
+  if (mismatches > 0) {
+    printf("MISMATCH: %llu samples differ between the vector path and the scalar reference\n", mismatches);
+    return 1;
+  }
+  printf("vector path and scalar reference agree on every sample\n");
+  return 0;
+}
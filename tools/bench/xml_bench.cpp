@@ -0,0 +1,473 @@
+// benchmark of the settings XML handling in the Qualisys SDK: parsing and
+// walking QTM parameter documents with CMarkup and with CXmlReader, and building
+// the 6DOF settings with CMarkup and with CXmlWriter. documents can be saved
+// `GetParameters All` replies, otherwise one shaped like it is generated. see
+// the README for how to build and use it.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "../../src/qsdk/Markup.h"
+#include "../../src/qsdk/XmlReader.h"
+#include "../../src/qsdk/XmlWriter.h"
+#include "../../src/utils/histogram.h"
+
+// the attributes QTM puts on elements, looked up on every element like the
+// settings readers do
+static const char *const kAttribs[] = {"X", "Y", "Z", "Name", "Value"};
+
+static std::string gScratch;
+
+static size_t textSize(const std::string &text) { return text.size(); }
+// copied out like the settings readers do, so both sides decode entities
+static size_t textSize(const CXmlSpan &text) {
+  text.AssignTo(gScratch);
+  return gScratch.size();
+}
+
+// visits every element below the main position: tag name, data and attributes.
+// the sum of the text sizes tells whether both readers saw the same.
+template <typename Xml> static size_t walk(Xml &xml) {
+  size_t sum = 0;
+  while (xml.FindChildElem()) {
+    sum += 1 + textSize(xml.GetChildTagName()) + textSize(xml.GetChildData());
+    for (const char *attrib : kAttribs) sum += textSize(xml.GetChildAttrib(attrib));
+    xml.IntoElem();
+    sum += walk(xml);
+    xml.OutOfElem();
+  }
+  return sum;
+}
+
+template <typename Xml> static size_t walkDoc(Xml &xml) {
+  size_t sum = 0;
+  while (xml.FindElem()) sum += 1 + textSize(xml.GetTagName()) + walk(xml);
+  return sum;
+}
+
+static void addFov(CXmlWriter &xml, const char *name, unsigned int width, unsigned int height) {
+  xml.AddElem(name);
+  xml.IntoElem();
+  xml.AddElem("Left", 0u);
+  xml.AddElem("Top", 0u);
+  xml.AddElem("Right", width - 1);
+  xml.AddElem("Bottom", height - 1);
+  xml.OutOfElem();
+}
+
+static void addRange(CXmlWriter &xml, const char *name, unsigned int current, unsigned int min, unsigned int max) {
+  xml.AddElem(name);
+  xml.IntoElem();
+  xml.AddElem("Current", current);
+  xml.AddElem("Min", min);
+  xml.AddElem("Max", max);
+  xml.OutOfElem();
+}
+
+// a `GetParameters All` reply with the given number of cameras, 3D labels and
+// 6DOF bodies, laid out like QTM's
+static std::string generateParameters(unsigned int cameras, unsigned int labels, unsigned int bodies) {
+  CXmlWriter xml(1 << 20);
+  char name[32];
+  xml.AddElem("QTM_Parameters_Ver_1.25");
+  xml.IntoElem();
+
+  xml.AddElem("General");
+  xml.IntoElem();
+  xml.AddElem("Frequency", 300u);
+  xml.AddElem("Capture_Time", 10.0f, 3);
+  xml.AddElem("Start_On_External_Trigger", "False");
+  xml.AddElem("External_Time_Base");
+  xml.IntoElem();
+  xml.AddElem("Enabled", "False");
+  xml.AddElem("Signal_Source", "Control port");
+  xml.AddElem("Signal_Mode", "Periodic");
+  xml.AddElem("Frequency_Multiplier", 1u);
+  xml.AddElem("Frequency_Divisor", 1u);
+  xml.AddElem("Frequency_Tolerance", 1000u);
+  xml.AddElem("Nominal_Frequency", "None");
+  xml.AddElem("Signal_Edge", "Negative");
+  xml.AddElem("Signal_Shutter_Delay", 0u);
+  xml.AddElem("Non_Periodic_Timeout", 1.0f, 3);
+  xml.OutOfElem();
+  xml.AddElem("Processing_Actions");
+  xml.IntoElem();
+  const char *const actions[] = {"PreProcessing2D", "TwinSystemMerge", "SplineFill", "AIM", "Track6DOF", "ForceData",
+                                 "GazeVector", "ExportTSV", "ExportC3D", "ExportMatlabFile", "ExportAviFile"};
+  xml.AddElem("Tracking", "3D");
+  for (const char *action : actions) xml.AddElem(action, "False");
+  xml.OutOfElem();
+  for (unsigned int c = 0; c < cameras; c++) {
+    xml.AddElem("Camera");
+    xml.IntoElem();
+    xml.AddElem("ID", c + 1);
+    xml.AddElem("Model", "Miqus M3");
+    xml.AddElem("Underwater", "False");
+    xml.AddElem("Supports_HW_Sync", "True");
+    xml.AddElem("Serial", 28000u + c);
+    xml.AddElem("Mode", "Marker");
+    xml.AddElem("Video_Frequency", 25u);
+    xml.AddElem("Video_Resolution", "1080p");
+    xml.AddElem("Video_Aspect_Ratio", "16x9");
+    addRange(xml, "Video_Exposure", 2000, 5, 39940);
+    addRange(xml, "Video_Flash_Time", 0, 0, 1000);
+    addRange(xml, "Marker_Exposure", 300, 5, 1000);
+    addRange(xml, "Marker_Threshold", 170, 50, 900);
+    xml.AddElem("Position");
+    xml.IntoElem();
+    xml.AddElem("X", 1000.0f * c);
+    xml.AddElem("Y", -2000.0f);
+    xml.AddElem("Z", 2500.0f);
+    for (unsigned int i = 0; i < 9; i++) {
+      snprintf(name, sizeof(name), "Rot_%u_%u", i / 3 + 1, i % 3 + 1);
+      xml.AddElem(name, i % 4 == 0 ? 1.0f : 0.0f);
+    }
+    xml.OutOfElem();
+    xml.AddElem("Orientation", 0u);
+    xml.AddElem("Marker_Res");
+    xml.IntoElem();
+    xml.AddElem("Width", 28672u);
+    xml.AddElem("Height", 14336u);
+    xml.OutOfElem();
+    xml.AddElem("Video_Res");
+    xml.IntoElem();
+    xml.AddElem("Width", 1920u);
+    xml.AddElem("Height", 1080u);
+    xml.OutOfElem();
+    addFov(xml, "Marker_FOV", 1824, 1088);
+    addFov(xml, "Video_FOV", 1920, 1080);
+    xml.AddElem("Sync_Out");
+    xml.IntoElem();
+    xml.AddElem("Mode", "Shutter out");
+    xml.AddElem("Signal_Polarity", "Negative");
+    xml.OutOfElem();
+    xml.AddElem("LensControl");
+    xml.IntoElem();
+    xml.AddElem("Focus");
+    xml.AddAttrib("Value", 2.5f);
+    xml.AddAttrib("Min", 0.5f);
+    xml.AddAttrib("Max", 100.0f);
+    xml.AddElem("Aperture");
+    xml.AddAttrib("Value", 4.0f);
+    xml.AddAttrib("Min", 1.4f);
+    xml.AddAttrib("Max", 16.0f);
+    xml.OutOfElem();
+    xml.AddElem("AutoExposure");
+    xml.AddAttrib("Enabled", "false");
+    xml.AddAttrib("Compensation", 0.0f);
+    xml.OutOfElem();
+  }
+  xml.OutOfElem();
+
+  xml.AddElem("The_3D");
+  xml.IntoElem();
+  xml.AddElem("AxisUpwards", "+Z");
+  xml.AddElem("CalibrationTime", "2024-05-02 10:46:11");
+  xml.AddElem("Labels", labels);
+  xml.AddElem("AIM_Models");
+  xml.IntoElem();
+  xml.AddElem("Model", "sled.qam");
+  xml.OutOfElem();
+  for (unsigned int l = 0; l < labels; l++) {
+    xml.AddElem("Label");
+    xml.IntoElem();
+    snprintf(name, sizeof(name), "M%u", l + 1);
+    xml.AddElem("Name", l == 0 ? "CAR_W" : l == 1 ? "CAR_D" : name);
+    xml.AddElem("RGBColor", 0xff00ffu - l);
+    xml.AddElem("Trajectory_Type", "Measured");
+    xml.OutOfElem();
+  }
+  xml.AddElem("Bones");
+  xml.IntoElem();
+  for (unsigned int l = 1; l < labels; l += 2) {
+    xml.AddElem("Bone");
+    snprintf(name, sizeof(name), "M%u", l);
+    xml.AddAttrib("From", name);
+    snprintf(name, sizeof(name), "M%u", l + 1);
+    xml.AddAttrib("To", name);
+    xml.AddAttrib("Color", 0xffffffu);
+  }
+  xml.OutOfElem();
+  xml.OutOfElem();
+
+  xml.AddElem("The_6D");
+  xml.IntoElem();
+  xml.AddElem("Bodies", bodies);
+  for (unsigned int b = 0; b < bodies; b++) {
+    xml.AddElem("Body");
+    xml.IntoElem();
+    snprintf(name, sizeof(name), "Body %u", b + 1);
+    xml.AddElem("Name", name);
+    xml.AddElem("Color");
+    xml.AddAttrib("R", 255u);
+    xml.AddAttrib("G", b * 20 % 256);
+    xml.AddAttrib("B", 0u);
+    xml.AddElem("MaximumResidual", 10.0f);
+    xml.AddElem("MinimumMarkersInBody", 3u);
+    xml.AddElem("BoneLengthTolerance", 5.0f);
+    xml.AddElem("Filter");
+    xml.AddAttrib("Preset", "Multi-purpose");
+    xml.AddElem("Points");
+    xml.IntoElem();
+    for (unsigned int p = 0; p < 8; p++) {
+      xml.AddElem("Point");
+      xml.AddAttrib("X", 10.0f * p);
+      xml.AddAttrib("Y", -5.0f * p);
+      xml.AddAttrib("Z", 2.5f);
+      xml.AddAttrib("Virtual", "0");
+      xml.AddAttrib("PhysicalId", p);
+      snprintf(name, sizeof(name), "B%uP%u", b + 1, p + 1);
+      xml.AddAttrib("Name", name);
+    }
+    xml.OutOfElem();
+    xml.OutOfElem();
+  }
+  xml.OutOfElem();
+
+  xml.AddElem("Analog");
+  xml.IntoElem();
+  for (unsigned int d = 0; d < 2; d++) {
+    xml.AddElem("Device");
+    xml.IntoElem();
+    xml.AddElem("Device_ID", d + 1);
+    xml.AddElem("Device_Name", "USB-2533");
+    xml.AddElem("Channels", 64u);
+    xml.AddElem("Frequency", 1200u);
+    for (unsigned int ch = 0; ch < 64; ch++) {
+      xml.AddElem("Channel");
+      xml.IntoElem();
+      snprintf(name, sizeof(name), "Analog %u", ch + 1);
+      xml.AddElem("Label", name);
+      xml.AddElem("Unit", "V");
+      xml.OutOfElem();
+    }
+    xml.OutOfElem();
+  }
+  xml.OutOfElem();
+
+  return xml.GetDoc();
+}
+
+// what CRTProtocol::Set6DOFBodySettings sends, with CMarkup or CXmlWriter
+template <typename Xml> static void build6DOF(Xml &xml, unsigned int bodies) {
+  char name[32];
+  xml.AddElem("QTM_Settings");
+  xml.IntoElem();
+  xml.AddElem("The_6D");
+  xml.IntoElem();
+  for (unsigned int b = 0; b < bodies; b++) {
+    xml.AddElem("Body");
+    xml.IntoElem();
+    snprintf(name, sizeof(name), "Body %u", b + 1);
+    xml.AddElem("Name", name);
+    xml.AddElem("Color");
+    xml.AddAttrib("R", std::to_string(255).c_str());
+    xml.AddAttrib("G", std::to_string(b * 20 % 256).c_str());
+    xml.AddAttrib("B", std::to_string(0).c_str());
+    xml.AddElem("MaximumResidual", std::to_string(10.0f).c_str());
+    xml.AddElem("MinimumMarkersInBody", std::to_string(3).c_str());
+    xml.AddElem("BoneLengthTolerance", std::to_string(5.0f).c_str());
+    xml.AddElem("Filter");
+    xml.AddAttrib("Preset", "Multi-purpose");
+    xml.AddElem("Points");
+    xml.IntoElem();
+    for (unsigned int p = 0; p < 8; p++) {
+      xml.AddElem("Point");
+      xml.AddAttrib("X", std::to_string(10.0f * p).c_str());
+      xml.AddAttrib("Y", std::to_string(-5.0f * p).c_str());
+      xml.AddAttrib("Z", std::to_string(2.5f).c_str());
+      xml.AddAttrib("Virtual", "0");
+      xml.AddAttrib("PhysicalId", std::to_string(p).c_str());
+      snprintf(name, sizeof(name), "B%uP%u", b + 1, p + 1);
+      xml.AddAttrib("Name", name);
+    }
+    xml.OutOfElem();
+    xml.OutOfElem();
+  }
+  xml.OutOfElem();
+  xml.OutOfElem();
+}
+
+// the same with the writer's number overloads, as the SDK does it
+static void build6DOFNumbers(CXmlWriter &xml, unsigned int bodies) {
+  char name[32];
+  xml.AddElem("QTM_Settings");
+  xml.IntoElem();
+  xml.AddElem("The_6D");
+  xml.IntoElem();
+  for (unsigned int b = 0; b < bodies; b++) {
+    xml.AddElem("Body");
+    xml.IntoElem();
+    snprintf(name, sizeof(name), "Body %u", b + 1);
+    xml.AddElem("Name", name);
+    xml.AddElem("Color");
+    xml.AddAttrib("R", 255);
+    xml.AddAttrib("G", b * 20 % 256);
+    xml.AddAttrib("B", 0);
+    xml.AddElem("MaximumResidual", 10.0f);
+    xml.AddElem("MinimumMarkersInBody", 3);
+    xml.AddElem("BoneLengthTolerance", 5.0f);
+    xml.AddElem("Filter");
+    xml.AddAttrib("Preset", "Multi-purpose");
+    xml.AddElem("Points");
+    xml.IntoElem();
+    for (unsigned int p = 0; p < 8; p++) {
+      xml.AddElem("Point");
+      xml.AddAttrib("X", 10.0f * p);
+      xml.AddAttrib("Y", -5.0f * p);
+      xml.AddAttrib("Z", 2.5f);
+      xml.AddAttrib("Virtual", "0");
+      xml.AddAttrib("PhysicalId", p);
+      snprintf(name, sizeof(name), "B%uP%u", b + 1, p + 1);
+      xml.AddAttrib("Name", name);
+    }
+    xml.OutOfElem();
+    xml.OutOfElem();
+  }
+  xml.OutOfElem();
+  xml.OutOfElem();
+}
+
+static uint64_t elapsedNs(std::chrono::steady_clock::time_point start) {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)
+    .count();
+}
+
+static void printTimes(const char *what, const LogLinearHistogram &ns, const LogLinearHistogram &reference) {
+  printf("  %-34s p50 %9.1f / p99 %9.1f us", what, ns.percentile(50.0) * 1e-3, ns.percentile(99.0) * 1e-3);
+  if (&ns != &reference) printf("  %5.1fx", (double)reference.percentile(50.0) / ns.percentile(50.0));
+  printf("\n");
+}
+
+static bool benchDocument(const char *label, const std::string &doc, unsigned int iterations) {
+  LogLinearHistogram markupParse, markupWalk, readerParse, readerWalk;
+  size_t markupSum = 0, readerSum = 0, elements = 0;
+  CXmlReader reader;
+
+  for (unsigned int i = 0; i < iterations; i++) {
+    // as CRTProtocol::ReadSettings: a new CMarkup for every read, the reader kept
+    auto start = std::chrono::steady_clock::now();
+    CMarkup markup;
+    markup.SetDoc(doc.c_str());
+    markupParse.record(elapsedNs(start));
+    start = std::chrono::steady_clock::now();
+    markupSum = walkDoc(markup);
+    markupWalk.record(elapsedNs(start));
+
+    start = std::chrono::steady_clock::now();
+    if (!reader.SetDoc(doc.c_str(), doc.size())) {
+      printf("%s: not well formed\n", label);
+      return false;
+    }
+    readerParse.record(elapsedNs(start));
+    start = std::chrono::steady_clock::now();
+    readerSum = walkDoc(reader);
+    readerWalk.record(elapsedNs(start));
+    elements = reader.GetElemCount();
+  }
+
+  printf("%s: %.1f kB, %zu elements\n", label, doc.size() / 1024.0, elements);
+  printTimes("CMarkup parse", markupParse, markupParse);
+  printTimes("CXmlReader parse", readerParse, markupParse);
+  printTimes("CMarkup walk", markupWalk, markupWalk);
+  printTimes("CXmlReader walk", readerWalk, markupWalk);
+  if (markupSum != readerSum) {
+    printf("  the readers saw different documents (%zu vs %zu)\n", markupSum, readerSum);
+    return false;
+  }
+  return true;
+}
+
+static bool benchBuild(unsigned int bodies, unsigned int iterations) {
+  LogLinearHistogram markupNs, writerNs, numbersNs;
+  std::string markupDoc, writerDoc, numbersDoc;
+  CXmlWriter writer;
+
+  for (unsigned int i = 0; i < iterations; i++) {
+    // as the SDK did: a new CMarkup for every settings write, the writer kept
+    auto start = std::chrono::steady_clock::now();
+    CMarkup markup;
+    build6DOF(markup, bodies);
+    markupDoc = markup.GetDoc();
+    markupNs.record(elapsedNs(start));
+
+    start = std::chrono::steady_clock::now();
+    writer.Clear();
+    build6DOF(writer, bodies);
+    writer.GetDoc();
+    writerNs.record(elapsedNs(start));
+    writerDoc = writer.GetDoc();
+
+    start = std::chrono::steady_clock::now();
+    writer.Clear();
+    build6DOFNumbers(writer, bodies);
+    writer.GetDoc();
+    numbersNs.record(elapsedNs(start));
+    numbersDoc = writer.GetDoc();
+  }
+
+  printf("6DOF settings for %u bodies: %.1f kB\n", bodies, markupDoc.size() / 1024.0);
+  printTimes("CMarkup build", markupNs, markupNs);
+  printTimes("CXmlWriter build, std::to_string", writerNs, markupNs);
+  printTimes("CXmlWriter build, numbers", numbersNs, markupNs);
+  if (writerDoc != markupDoc || numbersDoc != markupDoc) {
+    printf("  the writers built different documents\n");
+    return false;
+  }
+  return true;
+}
+
+static void usage(const char *program) {
+  fprintf(stderr, "usage: %s [-c cameras] [-n labels] [-b bodies] [-i iterations] [file.xml ...]\n"
+                  "  -c  cameras in the generated document, default 24\n"
+                  "  -n  3D labels in the generated document, default 200\n"
+                  "  -b  6DOF bodies in the generated document and the built settings, default 20\n"
+                  "  -i  iterations, default 200\n"
+                  "  files are QTM parameter documents, e.g. saved GetParameters All replies,\n"
+                  "  and are benchmarked instead of the generated one\n", program);
+}
+
+int main(int argc, char *argv[]) {
+  unsigned int cameras = 24, labels = 200, bodies = 20, iterations = 200;
+  int opt;
+  while ((opt = getopt(argc, argv, "c:n:b:i:h")) != -1) {
+    switch (opt) {
+      case 'c': cameras = (unsigned int)atoi(optarg); break;
+      case 'n': labels = (unsigned int)atoi(optarg); break;
+      case 'b': bodies = (unsigned int)atoi(optarg); break;
+      case 'i': iterations = (unsigned int)atoi(optarg); break;
+      default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (iterations == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  bool same = true;
+  if (optind < argc) {
+    for (int i = optind; i < argc; i++) {
+      std::ifstream file(argv[i], std::ios::binary);
+      if (!file) {
+        fprintf(stderr, "can't read %s\n", argv[i]);
+        return 1;
+      }
+      std::stringstream doc;
+      doc << file.rdbuf();
+      same = benchDocument(argv[i], doc.str(), iterations) && same;
+    }
+  } else {
+    char label[96];
+    snprintf(label, sizeof(label), "generated parameters (%u cameras, %u labels, %u bodies)", cameras, labels, bodies);
+    same = benchDocument(label, generateParameters(cameras, labels, bodies), iterations) && same;
+  }
+  same = benchBuild(bodies, iterations) && same;
+  return same ? 0 : 1;
+}
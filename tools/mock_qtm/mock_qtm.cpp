@@ -0,0 +1,85 @@
+// mock QTM RT server streaming synthetic 3D markers, for running and benchmarking
+// the Bela program without QTM, see the README for how to build and use it.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "./qtm_mock_server.h"
+
+// markers sliding back and forth along y over the length of the track
+// (gTrackStart to gTrackEnd in src/utils/config.h), each at its own pace.
+// the first two are named like the sleds, the rest M3, M4, ...
+class SyntheticSource : public FrameSource {
+public:
+  SyntheticSource(double frequency, unsigned int markerCount) : mFrequency(frequency), mFrame(0) {
+    const char *sleds[] = {"CAR_W", "CAR_D"};
+    for (unsigned int i = 0; i < markerCount; i++) {
+      mLabels.push_back(i < 2 ? sleds[i] : "M" + std::to_string(i + 1));
+    }
+  }
+
+  double frequency() const override { return mFrequency; }
+  const std::vector<std::string> &labels() const override { return mLabels; }
+
+  bool rewind() override {
+    mFrame = 0;
+    return true;
+  }
+
+  bool next(MockFrame &frame) override {
+    const float trackCenter = 325.0f, trackHalfLength = 575.0f;
+    const double t = mFrame / mFrequency;
+    frame.number = ++mFrame;
+    frame.xyz.resize(mLabels.size() * 3);
+    for (size_t i = 0; i < mLabels.size(); i++) {
+      const double cycleSec = 4.0 + i * 0.5;
+      frame.xyz[i * 3] = 100.0f * i;
+      frame.xyz[i * 3 + 1] = trackCenter + trackHalfLength * (float)sin(2.0 * M_PI * t / cycleSec);
+      frame.xyz[i * 3 + 2] = 50.0f;
+    }
+    return true;
+  }
+
+private:
+  const double mFrequency;
+  std::vector<std::string> mLabels;
+  unsigned int mFrame;
+};
+
+static void usage(const char *program) {
+  fprintf(stderr, "usage: %s [-p port] [-r rate_hz] [-n markers] [-s speed]\n"
+                  "  -p  port to listen on, default 22223 (QTM's little endian port)\n"
+                  "  -r  capture rate in Hz, default 300\n"
+                  "  -n  number of markers, default 2 (CAR_W, CAR_D)\n"
+                  "  -s  speed factor for the stream, 0 sends as fast as possible, default 1\n", program);
+}
+
+int main(int argc, char *argv[]) {
+  unsigned short port = 22223;
+  double rate = 300.0, speed = 1.0;
+  unsigned int markers = 2;
+  int opt;
+  while ((opt = getopt(argc, argv, "p:r:n:s:h")) != -1) {
+    switch (opt) {
+      case 'p': port = (unsigned short)atoi(optarg); break;
+      case 'r': rate = atof(optarg); break;
+      case 'n': markers = (unsigned int)atoi(optarg); break;
+      case 's': speed = atof(optarg); break;
+      default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (rate <= 0.0 || markers == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  SyntheticSource source(rate, markers);
+  QtmMockServer server(source, port, speed);
+  if (!server.listen()) return 1;
+  server.run();
+  return 1;
+}
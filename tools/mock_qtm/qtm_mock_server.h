@@ -0,0 +1,416 @@
+#ifndef QTM_MOCK_SERVER_H
+#define QTM_MOCK_SERVER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// minimal QTM RT server (protocol 1.x, little endian port) speaking the subset
+// the Bela program uses: the Version handshake, QTMVersion, GetState, TakeControl,
+// GetParameters 3D, StreamFrames (3D over UDP or TCP), SetQTMEvent and Start/Stop.
+// frames come from a FrameSource, so the same server can synthesise markers or
+// replay a recorded session. one client is served at a time, like a lab setup.
+// packets are built in host byte order, i.e. little endian on x86 and ARM.
+
+// one 3D frame, xyz holds 3 floats per label in the order of FrameSource::labels(),
+// NaN for a marker that isn't visible in this frame. events are labels recorded at
+// this frame, they go out as trigger events just before the frame.
+struct MockFrame {
+  unsigned int number = 0;
+  std::vector<float> xyz;
+  std::vector<std::string> events;
+};
+
+class FrameSource {
+public:
+  virtual ~FrameSource() {}
+  // capture rate of the source in Hz
+  virtual double frequency() const = 0;
+  virtual const std::vector<std::string> &labels() const = 0;
+  // called at every StreamFrames, returns false if the source can't start over
+  virtual bool rewind() = 0;
+  // fills in the next frame, returns false at the end of the source
+  virtual bool next(MockFrame &frame) = 0;
+};
+
+class QtmMockServer {
+public:
+  // speed scales the source frame rate, 0 streams as fast as the socket takes it
+  QtmMockServer(FrameSource &source, unsigned short port, double speed = 1.0)
+    : mSource(source), mPort(port), mSpeed(speed), mListenSocket(-1), mClientSocket(-1),
+      mStreaming(false), mState(kEventConnected) {}
+
+  ~QtmMockServer() {
+    stopStreaming();
+    if (mListenSocket >= 0) ::close(mListenSocket);
+  }
+
+  bool listen() {
+    mListenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (mListenSocket < 0) return fail("socket");
+    int on = 1;
+    setsockopt(mListenSocket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(mPort);
+    if (bind(mListenSocket, (sockaddr *)&addr, sizeof(addr)) < 0) return fail("bind");
+    if (::listen(mListenSocket, 4) < 0) return fail("listen");
+    printf("Mock QTM RT server on port %u: %zu markers at %.1f Hz", mPort, mSource.labels().size(),
+           mSource.frequency());
+    if (mSpeed > 0.0 && mSpeed != 1.0) printf(", %.2fx speed", mSpeed);
+    if (mSpeed <= 0.0) printf(", as fast as possible");
+    printf("\n");
+    return true;
+  }
+
+  // accepts clients one after the other, never returns unless accept fails
+  void run() {
+    while (true) {
+      sockaddr_in peer;
+      socklen_t peerLen = sizeof(peer);
+      const int client = accept(mListenSocket, (sockaddr *)&peer, &peerLen);
+      if (client < 0) {
+        if (errno == EINTR) continue;
+        fail("accept");
+        return;
+      }
+      int on = 1;
+      setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+      mClientSocket = client;
+      mClientAddr = peer.sin_addr;
+      mState = kEventConnected;
+      printf("Client %s connected\n", inet_ntoa(peer.sin_addr));
+      serveClient();
+      stopStreaming();
+      ::close(client);
+      mClientSocket = -1;
+      printf("Client disconnected\n");
+    }
+  }
+
+private:
+  // packet types and events, same numbers as CRTPacket
+  enum { kPacketError = 0, kPacketCommand = 1, kPacketXML = 2, kPacketData = 3, kPacketNoMoreData = 4,
+         kPacketEvent = 6 };
+  enum { kEventConnected = 1, kEventCaptureStarted = 3, kEventCaptureStopped = 4, kEventRTfromFileStopped = 9,
+         kEventTrigger = 16 };
+  static constexpr unsigned int kHeaderSize = 8;
+  static constexpr unsigned int kComponent3d = 1;
+
+  bool fail(const char *what) {
+    fprintf(stderr, "Mock QTM: %s failed: %s\n", what, strerror(errno));
+    return false;
+  }
+
+  // reads commands until the client goes away
+  void serveClient() {
+    sendString(kPacketCommand, "QTM RT Interface connected");
+    std::vector<char> body;
+    while (true) {
+      uint32_t header[2];
+      if (!receiveAll(header, kHeaderSize)) return;
+      if (header[0] < kHeaderSize || header[0] > 65536) {
+        fprintf(stderr, "Mock QTM: bad packet size %u\n", header[0]);
+        return;
+      }
+      body.assign(header[0] - kHeaderSize + 1, 0);
+      if (!receiveAll(body.data(), header[0] - kHeaderSize)) return;
+      if (header[1] == kPacketCommand) handleCommand(std::string(body.data()));
+    }
+  }
+
+  void handleCommand(const std::string &command) {
+    std::istringstream words(command);
+    std::string verb;
+    words >> verb;
+    verb = lower(verb);
+
+    if (verb == "version") {
+      std::string version;
+      words >> version;
+      sendString(kPacketCommand, "Version set to " + version);
+    } else if (verb == "byteorder") {
+      sendString(kPacketCommand, "Byte order is little endian");
+    } else if (verb == "qtmversion") {
+      sendString(kPacketCommand, "QTM Version is mock");
+    } else if (verb == "getstate" || verb == "getlastevent") {
+      sendEvent(mState);
+    } else if (verb == "takecontrol") {
+      sendString(kPacketCommand, "You are now master");
+    } else if (verb == "releasecontrol") {
+      sendString(kPacketCommand, "You are now a regular client");
+    } else if (verb == "getparameters") {
+      sendString(kPacketXML, parametersXml(command));
+    } else if (verb == "setqtmevent" || verb == "event") {
+      std::string label;
+      std::getline(words >> std::ws, label);
+      printf("Event %s at %.6f\n", label.c_str(), now() * 1e-9);
+      fflush(stdout);
+      sendString(kPacketCommand, "Event set");
+    } else if (verb == "start") {
+      sendString(kPacketCommand, "Starting measurement");
+      mState = kEventCaptureStarted;
+      sendEvent(mState);
+    } else if (verb == "stop") {
+      sendString(kPacketCommand, "Stopping measurement");
+      mState = kEventCaptureStopped;
+      sendEvent(mState);
+    } else if (verb == "streamframes") {
+      streamFrames(words);
+    } else {
+      sendString(kPacketError, "Parse error");
+    }
+  }
+
+  // StreamFrames Stop | AllFrames | Frequency:n | FrequencyDivisor:n [UDP[:address]:port] 3D
+  void streamFrames(std::istringstream &words) {
+    stopStreaming();
+    unsigned int divisor = 1;
+    bool udp = false;
+    sockaddr_in udpAddr;
+    memset(&udpAddr, 0, sizeof(udpAddr));
+    udpAddr.sin_family = AF_INET;
+    udpAddr.sin_addr = mClientAddr;
+    bool has3d = false;
+
+    std::string word;
+    while (words >> word) {
+      const std::string key = lower(word.substr(0, word.find(':')));
+      const std::string value = word.find(':') == std::string::npos ? "" : word.substr(word.find(':') + 1);
+      if (key == "stop") {
+        return;
+      } else if (key == "allframes") {
+        divisor = 1;
+      } else if (key == "frequency") {
+        const double rate = atof(value.c_str());
+        divisor = rate > 0.0 ? std::max(1u, (unsigned int)std::lround(mSource.frequency() / rate)) : 1;
+      } else if (key == "frequencydivisor") {
+        divisor = std::max(1, atoi(value.c_str()));
+      } else if (key == "udp") {
+        udp = true;
+        const size_t lastColon = value.rfind(':');
+        if (lastColon != std::string::npos) {
+          inet_aton(value.substr(0, lastColon).c_str(), &udpAddr.sin_addr);
+        }
+        udpAddr.sin_port = htons((unsigned short)atoi(value.substr(lastColon + 1).c_str()));
+      } else if (key == "3d") {
+        has3d = true;
+      }
+    }
+    if (!has3d) {
+      sendString(kPacketError, "Mock only streams 3D");
+      return;
+    }
+    if (!mSource.rewind()) {
+      sendString(kPacketError, "No more data");
+      return;
+    }
+    mStreaming = true;
+    mStreamThread = std::thread(&QtmMockServer::stream, this, divisor, udp, udpAddr);
+  }
+
+  void stopStreaming() {
+    mStreaming = false;
+    if (mStreamThread.joinable()) mStreamThread.join();
+  }
+
+  // runs on its own thread between StreamFrames and StreamFrames Stop
+  void stream(unsigned int divisor, bool udp, sockaddr_in udpAddr) {
+    const int udpSocket = udp ? socket(AF_INET, SOCK_DGRAM, 0) : -1;
+    const double periodNs = mSpeed > 0.0 ? 1e9 * divisor / (mSource.frequency() * mSpeed) : 0.0;
+    const long long startNs = now();
+    unsigned long long frames = 0, sendErrors = 0, late = 0;
+    long long maxLateNs = 0;
+    MockFrame frame;
+    std::vector<char> packet;
+    bool more = true;
+
+    while (mStreaming.load(std::memory_order_relaxed)) {
+      for (unsigned int i = 0; i < divisor && more; i++) more = mSource.next(frame);
+      if (!more) break;
+
+      // capture time is the scheduled send time, so the client sees only the network jitter
+      long long dueNs = startNs + (long long)(frames * periodNs);
+      if (periodNs > 0.0) {
+        sleepUntil(dueNs);
+        const long long lateNs = now() - dueNs;
+        if (lateNs > maxLateNs) maxLateNs = lateNs;
+        if (lateNs > periodNs) late++;
+      } else {
+        dueNs = now();
+      }
+      // the RT protocol has no packet for a label, the closest QTM sends is a trigger event
+      for (const std::string &label : frame.events) {
+        printf("Replayed event %s at frame %u\n", label.c_str(), frame.number);
+        sendEvent(kEventTrigger);
+      }
+      build3dPacket(packet, frame, (unsigned long long)((dueNs - startNs) / 1000));
+
+      const bool sent = udp
+        ? sendto(udpSocket, packet.data(), packet.size(), 0, (sockaddr *)&udpAddr, sizeof(udpAddr)) == (ssize_t)packet.size()
+        : sendPacket(packet.data(), packet.size());
+      if (!sent) {
+        sendErrors++;
+        if (!udp) break; // the client went away
+      }
+      frames++;
+    }
+    if (!more) {
+      // end of a recording, like QTM at the end of RT from file
+      std::vector<char> noMoreData(kHeaderSize);
+      writeHeader(noMoreData, kPacketNoMoreData);
+      sendPacket(noMoreData.data(), noMoreData.size());
+      sendEvent(kEventRTfromFileStopped);
+    }
+    if (udpSocket >= 0) ::close(udpSocket);
+
+    const double elapsedSec = (now() - startNs) * 1e-9;
+    printf("Streamed %llu frames over %s in %.1f s (%.1f Hz), %llu send errors, %llu late by more than a period, "
+           "max lateness %.3f ms\n", frames, udp ? "UDP" : "TCP", elapsedSec,
+           elapsedSec > 0.0 ? frames / elapsedSec : 0.0, sendErrors, late, maxLateNs * 1e-6);
+    fflush(stdout);
+  }
+
+  // data packet: header, timestamp, frame number, component count, 3D component
+  void build3dPacket(std::vector<char> &packet, const MockFrame &frame, unsigned long long timestampUs) {
+    const uint32_t markerCount = (uint32_t)(frame.xyz.size() / 3);
+    const uint32_t componentSize = 16 + markerCount * 12;
+    packet.resize(kHeaderSize + 16 + componentSize);
+    writeHeader(packet, kPacketData);
+    char *p = packet.data() + kHeaderSize;
+    const uint64_t timestamp = timestampUs;
+    const uint32_t number = frame.number, componentCount = 1, componentType = kComponent3d;
+    const uint16_t dropRate = 0, outOfSyncRate = 0;
+    p = put(p, timestamp);
+    p = put(p, number);
+    p = put(p, componentCount);
+    p = put(p, componentSize);
+    p = put(p, componentType);
+    p = put(p, markerCount);
+    p = put(p, dropRate);
+    p = put(p, outOfSyncRate);
+    memcpy(p, frame.xyz.data(), markerCount * 12);
+  }
+
+  std::string parametersXml(const std::string &command) {
+    std::ostringstream xml;
+    xml << "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\" ?>\n<QTM_Parameters_Ver_1.23>\n";
+    const std::string wanted = lower(command);
+    if (wanted.find(" 3d") != std::string::npos || wanted.find(" all") != std::string::npos) {
+      xml << "<The_3D>\n<AxisUpwards>+Z</AxisUpwards>\n<CalibrationTime>2023-01-01 00:00:00</CalibrationTime>\n"
+          << "<Labels>" << mSource.labels().size() << "</Labels>\n";
+      for (const std::string &label : mSource.labels()) {
+        xml << "<Label>\n<Name>" << label << "</Name>\n<RGBColor>255</RGBColor>\n"
+            << "<Trajectory_Type>Measured</Trajectory_Type>\n</Label>\n";
+      }
+      xml << "<Bones></Bones>\n</The_3D>\n";
+    }
+    xml << "</QTM_Parameters_Ver_1.23>";
+    return xml.str();
+  }
+
+  template<typename T>
+  static char *put(char *p, const T &value) {
+    memcpy(p, &value, sizeof(T));
+    return p + sizeof(T);
+  }
+
+  static void writeHeader(std::vector<char> &packet, uint32_t type) {
+    const uint32_t size = (uint32_t)packet.size();
+    put(put(packet.data(), size), type);
+  }
+
+  // strings go out NUL terminated, like QTM sends them
+  bool sendString(uint32_t type, const std::string &text) {
+    std::vector<char> packet(kHeaderSize + text.size() + 1, 0);
+    writeHeader(packet, type);
+    memcpy(packet.data() + kHeaderSize, text.data(), text.size());
+    return sendPacket(packet.data(), packet.size());
+  }
+
+  bool sendEvent(uint32_t event) {
+    std::vector<char> packet(kHeaderSize + 1);
+    writeHeader(packet, kPacketEvent);
+    packet[kHeaderSize] = (char)event;
+    return sendPacket(packet.data(), packet.size());
+  }
+
+  // the command and stream threads share the TCP socket
+  bool sendPacket(const char *data, size_t size) {
+    std::lock_guard<std::mutex> lock(mSendMutex);
+    while (size > 0) {
+      const ssize_t sent = send(mClientSocket, data, size, MSG_NOSIGNAL);
+      if (sent < 0 && errno == EINTR) continue;
+      if (sent <= 0) return false;
+      data += sent;
+      size -= sent;
+    }
+    return true;
+  }
+
+  bool receiveAll(void *buffer, size_t size) {
+    char *p = (char *)buffer;
+    while (size > 0) {
+      const ssize_t got = recv(mClientSocket, p, size, 0);
+      if (got < 0 && errno == EINTR) continue;
+      if (got <= 0) return false;
+      p += got;
+      size -= got;
+    }
+    return true;
+  }
+
+  static std::string lower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)tolower(c); });
+    return text;
+  }
+
+  static long long now() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+  }
+
+  static void sleepUntil(long long ns) {
+    timespec t;
+    t.tv_sec = ns / 1000000000LL;
+    t.tv_nsec = ns % 1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, nullptr) == EINTR) {}
+  }
+
+  FrameSource &mSource;
+  const unsigned short mPort;
+  const double mSpeed;
+  int mListenSocket;
+  int mClientSocket;
+  in_addr mClientAddr;
+  std::mutex mSendMutex;
+  std::atomic<bool> mStreaming;
+  std::thread mStreamThread;
+  uint32_t mState;
+};
+
+constexpr unsigned int QtmMockServer::kHeaderSize;
+constexpr unsigned int QtmMockServer::kComponent3d;
+
+#endif
@@ -0,0 +1,229 @@
+// mock QTM RT server replaying a recorded session from data/, e.g.
+//   replay_qtm data/data_FO22J_YKHLV.tsv.bz2
+// frames are decompressed while streaming, the events and metadata files
+// next to the data file provide the recorded event labels and frame rate.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "./qtm_mock_server.h"
+
+// reads a .tsv or .tsv.bz2 file line by line, bz2 files through bzip2 -dc
+// so a session never has to fit in memory
+class TsvReader {
+public:
+  TsvReader() : mFile(nullptr), mPiped(false), mLine(nullptr), mLineCapacity(0) {}
+  ~TsvReader() {
+    close();
+    free(mLine);
+  }
+
+  bool open(const std::string &path) {
+    close();
+    mPiped = path.size() > 4 && path.compare(path.size() - 4, 4, ".bz2") == 0;
+    if (mPiped) {
+      // single quote the path for the shell
+      std::string quoted = "'";
+      for (char c : path) quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+      quoted += "'";
+      mFile = popen(("bzip2 -dc " + quoted).c_str(), "r");
+    } else {
+      mFile = fopen(path.c_str(), "r");
+    }
+    return mFile != nullptr;
+  }
+
+  void close() {
+    if (!mFile) return;
+    if (mPiped) pclose(mFile);
+    else fclose(mFile);
+    mFile = nullptr;
+  }
+
+  // next line split on tabs, false at the end of the file
+  bool next(std::vector<std::string> &fields) {
+    ssize_t length;
+    do {
+      if (!mFile || (length = getline(&mLine, &mLineCapacity, mFile)) < 0) return false;
+      while (length > 0 && (mLine[length - 1] == '\n' || mLine[length - 1] == '\r')) mLine[--length] = 0;
+    } while (length == 0);
+    fields.clear();
+    const char *start = mLine;
+    for (const char *p = mLine;; p++) {
+      if (*p == '\t' || *p == 0) {
+        fields.emplace_back(start, p - start);
+        if (*p == 0) break;
+        start = p + 1;
+      }
+    }
+    return true;
+  }
+
+private:
+  FILE *mFile;
+  bool mPiped;
+  char *mLine;
+  size_t mLineCapacity;
+};
+
+// EVENT rows of an events_*.tsv.bz2 file: type, event_label, index, elapsed_time
+struct RecordedEvent {
+  unsigned int index;
+  std::string label;
+};
+
+class ReplaySource : public FrameSource {
+public:
+  ReplaySource(const std::string &dataPath, double frequency, std::vector<RecordedEvent> events, bool loop)
+    : mDataPath(dataPath), mFrequency(frequency), mEvents(std::move(events)), mLoop(loop), mFrame(0),
+      mNextEvent(0) {}
+
+  // reads the header for the marker names: index, elapsed_time, {name}_x, {name}_y, {name}_z, ..., subj_w, subj_d
+  bool open() {
+    if (!mReader.open(mDataPath) || !mReader.next(mFields)) {
+      fprintf(stderr, "Could not read %s\n", mDataPath.c_str());
+      return false;
+    }
+    mLabels.clear();
+    for (size_t i = 2; i + 2 < mFields.size(); i += 3) {
+      const std::string &column = mFields[i];
+      if (column.size() < 2 || column.compare(column.size() - 2, 2, "_x") != 0) break;
+      mLabels.push_back(column.substr(0, column.size() - 2));
+    }
+    mColumnCount = 2 + mLabels.size() * 3;
+    mNextEvent = 0;
+    if (mLabels.empty()) {
+      fprintf(stderr, "No markers in the header of %s\n", mDataPath.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  double frequency() const override { return mFrequency; }
+  const std::vector<std::string> &labels() const override { return mLabels; }
+
+  // every StreamFrames replays the session from the start
+  bool rewind() override {
+    mFrame = 0;
+    return open();
+  }
+
+  bool next(MockFrame &frame) override {
+    do {
+      if (!mReader.next(mFields) && (!mLoop || !open() || !mReader.next(mFields))) return false;
+    } while (mFields.size() < mColumnCount); // skip truncated rows
+    frame.number = ++mFrame;
+    frame.xyz.resize(mLabels.size() * 3);
+    for (size_t i = 0; i < frame.xyz.size(); i++) {
+      // QTM leaves the columns of a marker it lost empty
+      const std::string &value = mFields[i + 2];
+      frame.xyz[i] = value.empty() ? NAN : strtof(value.c_str(), nullptr);
+    }
+    const unsigned int index = (unsigned int)strtoul(mFields[0].c_str(), nullptr, 10);
+    frame.events.clear();
+    while (mNextEvent < mEvents.size() && mEvents[mNextEvent].index <= index) {
+      frame.events.push_back(mEvents[mNextEvent++].label);
+    }
+    return true;
+  }
+
+private:
+  const std::string mDataPath;
+  const double mFrequency;
+  const std::vector<RecordedEvent> mEvents;
+  const bool mLoop;
+  TsvReader mReader;
+  std::vector<std::string> mFields;
+  std::vector<std::string> mLabels;
+  size_t mColumnCount;
+  unsigned int mFrame;
+  size_t mNextEvent;
+};
+
+// data_X.tsv.bz2 -> events_X.tsv.bz2 / metadata_X.tsv.bz2, empty if the name doesn't follow the pattern
+static std::string siblingPath(const std::string &dataPath, const std::string &prefix) {
+  const size_t slash = dataPath.rfind('/');
+  const size_t nameStart = slash == std::string::npos ? 0 : slash + 1;
+  if (dataPath.compare(nameStart, 5, "data_") != 0) return "";
+  return dataPath.substr(0, nameStart) + prefix + dataPath.substr(nameStart + 5);
+}
+
+// FREQUENCY row of a metadata file, 0 if missing
+static double readFrequency(const std::string &path) {
+  TsvReader reader;
+  std::vector<std::string> fields;
+  if (path.empty() || !reader.open(path)) return 0.0;
+  while (reader.next(fields)) {
+    if (fields.size() >= 2 && fields[0] == "FREQUENCY") return atof(fields[1].c_str());
+  }
+  return 0.0;
+}
+
+static std::vector<RecordedEvent> readEvents(const std::string &path) {
+  std::vector<RecordedEvent> events;
+  TsvReader reader;
+  std::vector<std::string> fields;
+  if (path.empty() || !reader.open(path)) return events;
+  while (reader.next(fields)) {
+    if (fields.size() >= 3 && fields[0] == "EVENT") {
+      events.push_back({(unsigned int)strtoul(fields[2].c_str(), nullptr, 10), fields[1]});
+    }
+  }
+  std::stable_sort(events.begin(), events.end(),
+                   [](const RecordedEvent &a, const RecordedEvent &b) { return a.index < b.index; });
+  return events;
+}
+
+static void usage(const char *program) {
+  fprintf(stderr, "usage: %s [-p port] [-s speed] [-r rate_hz] [-e events_file] [-l] data_file\n"
+                  "  -p  port to listen on, default 22223 (QTM's little endian port)\n"
+                  "  -s  replay speed, 2 is twice the recorded rate, 0 as fast as possible, default 1\n"
+                  "  -r  recorded frame rate, default FREQUENCY from the metadata file\n"
+                  "  -e  events file, default the events file next to the data file\n"
+                  "  -l  loop the session instead of ending the stream\n", program);
+}
+
+int main(int argc, char *argv[]) {
+  unsigned short port = 22223;
+  double speed = 1.0, rate = 0.0;
+  std::string eventsPath;
+  bool loop = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "p:s:r:e:lh")) != -1) {
+    switch (opt) {
+      case 'p': port = (unsigned short)atoi(optarg); break;
+      case 's': speed = atof(optarg); break;
+      case 'r': rate = atof(optarg); break;
+      case 'e': eventsPath = optarg; break;
+      case 'l': loop = true; break;
+      default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1) {
+    usage(argv[0]);
+    return 1;
+  }
+  const std::string dataPath = argv[optind];
+
+  if (rate <= 0.0) rate = readFrequency(siblingPath(dataPath, "metadata_"));
+  if (rate <= 0.0) {
+    fprintf(stderr, "No FREQUENCY in the metadata file, set the recorded rate with -r\n");
+    return 1;
+  }
+  if (eventsPath.empty()) eventsPath = siblingPath(dataPath, "events_");
+  std::vector<RecordedEvent> events = readEvents(eventsPath);
+  printf("Replaying %s at %.1f Hz with %zu events\n", dataPath.c_str(), rate, events.size());
+
+  ReplaySource source(dataPath, rate, std::move(events), loop);
+  if (!source.open()) return 1;
+  QtmMockServer server(source, port, speed);
+  if (!server.listen()) return 1;
+  server.run();
+  return 1;
+}